@@ -3,9 +3,37 @@
 #include "xml_listener.h"
 #include "cute_runner.h"
 
+#include "bounded_queue.h"
+#include "chunk_stream.h"
 #include "collection.h"
+#include "collection_view.h"
+#include "culling.h"
 #include "config.h"
+#include "instrument.h"
+#include "kd_tree.h"
+#include "mapped_collection.h"
+#include "multi_pose.h"
+#include "pipeline.h"
+#include "projection.h"
 #include "transform.hpp"
+#include "triple_buffer.h"
+#include "voxel_grid.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
 using namespace fc;
 
@@ -18,6 +46,46 @@ struct tag {
 };
 using tagged_vec3d = geom::object<geom::Vector3d,tag>;
 
+struct stamp {
+	long t = 0;
+	long x = 0;
+	long y = 0;
+
+	bool operator==(stamp o) const {
+		return t == o.t && x == o.x && y == o.y;
+	}
+};
+
+namespace fc
+{
+namespace geom
+{
+template<>
+struct annotation_fields<stamp>
+		: columns<GEOM_FIELD(stamp, t), GEOM_FIELD(stamp, x), GEOM_FIELD(stamp, y)> {
+};
+} // namespace geom
+} // namespace fc
+
+using stamped_vec3d = geom::object<geom::Vector3d, stamp>;
+
+/// annotation whose copy fails for negative values
+struct fragile {
+	int t = 0;
+
+	fragile() = default;
+	explicit fragile(int v) :
+			t { v } {
+	}
+	fragile(const fragile&) = default;
+	fragile& operator=(const fragile& o) {
+		if (o.t < 0)
+			throw std::runtime_error { "fragile copy" };
+		t = o.t;
+		return *this;
+	}
+};
+
 void geom_initialize() {
 
 	geom::collection<tagged_vec3d> empty_col { };
@@ -75,12 +143,1339 @@ void test_transforms(){
 	ASSERT(result == test_val);
 }
 
+void test_collection_transform() {
+	geom::collection<tagged_vec3d> col {
+		tagged_vec3d { { 0, 0, 0 }, tag { 1 } },
+		tagged_vec3d { { 1, 2, 3 }, tag { 2 } },
+		tagged_vec3d { { -1, 0, 5 }, tag { 3 } } };
+
+	geom::Transformd m { };
+	m = Eigen::AngleAxisd(0.5, geom::Vector3d::UnitZ())
+	  * Eigen::Translation3d(1., -2., 3.);
+
+	std::vector<tagged_vec3d> expected { };
+	for (tagged_vec3d x : col) {
+		x.point = m * x.point;
+		expected.push_back(x);
+	}
+
+	col.transform(m);
+
+	ASSERT(col.size() == expected.size());
+	auto it = expected.begin();
+	for (tagged_vec3d x : col) {
+		ASSERT(x.point.isApprox(it->point));
+		ASSERT(x.t == it->t);
+		++it;
+	}
+}
+
+void test_soa_layout() {
+	using soa_collection = geom::collection<tagged_vec3d, geom::soa_layout>;
+
+	soa_collection col {
+		tagged_vec3d { { 0, 0, 0 }, tag { 1 } },
+		tagged_vec3d { { 1, 2, 3 }, tag { 2 } },
+		tagged_vec3d { { -1, 0, 5 }, tag { 3 } } };
+
+	ASSERT(col.size() == 3);
+	ASSERT(col.points()[1] == geom::Vector3d(1, 2, 3));
+
+	geom::Transformd m { };
+	m = Eigen::AngleAxisd(0.5, geom::Vector3d::UnitZ())
+	  * Eigen::Translation3d(1., -2., 3.);
+
+	geom::collection<tagged_vec3d> reference {
+		tagged_vec3d { { 0, 0, 0 }, tag { 1 } },
+		tagged_vec3d { { 1, 2, 3 }, tag { 2 } },
+		tagged_vec3d { { -1, 0, 5 }, tag { 3 } } };
+	reference.transform(m);
+	col.transform(m);
+
+	auto it = reference.begin();
+	for (tagged_vec3d x : col) {
+		tagged_vec3d expected = *it;
+		ASSERT(x.point.isApprox(expected.point));
+		ASSERT(x.t == expected.t);
+		++it;
+	}
+
+	for (auto&& x : col.points())
+		x = m.inverse() * x;
+	ASSERT(col.points()[1].isApprox(geom::Vector3d(1, 2, 3)));
+
+	auto first = *col.begin();
+	auto last = *(col.begin() + 2);
+	swap(first, last);
+	ASSERT(col.points()[0].isApprox(geom::Vector3d(-1, 0, 5)));
+	ASSERT((*col.begin()) == tagged_vec3d(col.points()[0], tag { 3 }));
+}
+
+void test_parallel_transform() {
+	geom::thread_pool pool { 4 };
+	const std::size_t size = 100000;
+
+	geom::collection<tagged_vec3d> sequential(size);
+	geom::collection<tagged_vec3d, geom::soa_layout> parallel(size);
+	for (std::size_t i = 0; i < size; ++i) {
+		const tagged_vec3d value { geom::Vector3d(i, 2. * i, -1. * i), tag { int(i) } };
+		*(sequential.begin() + i) = value;
+		*(parallel.begin() + i) = value;
+	}
+
+	geom::Transformd m { };
+	m = Eigen::AngleAxisd(0.5, geom::Vector3d::UnitZ())
+	  * Eigen::Translation3d(1., -2., 3.);
+
+	sequential.transform(m);
+	parallel.transform(m, geom::parallel.on(pool).with_grain(1000));
+	for (std::size_t i = 0; i < size; ++i)
+		ASSERT(sequential.points()[i].isApprox(parallel.points()[i]));
+
+	std::vector<std::atomic<int>> visits(size);
+	geom::parallel_for_each_block(parallel, [&](std::size_t first, std::size_t last) {
+		for (auto i = first; i < last; ++i)
+			++visits[i];
+	}, geom::parallel.on(pool).with_grain(777));
+	ASSERT(std::all_of(visits.begin(), visits.end(), [](auto& v) { return v == 1; }));
+
+	bool thrown = false;
+	try {
+		geom::parallel_for_each_block(size, 10, [](std::size_t first, std::size_t) {
+			if (first == 500)
+				throw std::runtime_error { "block failed" };
+		}, geom::parallel.on(pool));
+	} catch (const std::runtime_error&) {
+		thrown = true;
+	}
+	ASSERT(thrown);
+}
+
+void test_padded_layout() {
+	using tagged_vec3f = geom::object<geom::Vector3f, tag>;
+	geom::collection<tagged_vec3f, geom::padded_layout> col {
+		tagged_vec3f { { 0, 0, 0 }, tag { 1 } },
+		tagged_vec3f { { 1, 2, 3 }, tag { 2 } } };
+
+	ASSERT(reinterpret_cast<std::uintptr_t>(col.points()[1].data()) % 16 == 0);
+	ASSERT(col.points()[1] == geom::Vector3f(1, 2, 3));
+	ASSERT(col.points()[1].data()[3] == 1.f);
+
+	geom::Transformf m { };
+	m = Eigen::AngleAxisf(0.5f, geom::Vector3f::UnitZ())
+	  * Eigen::Translation3f(1.f, -2.f, 3.f);
+	col.transform(m);
+
+	ASSERT(col.points()[1].isApprox(m * geom::Vector3f(1, 2, 3)));
+	ASSERT(col.points()[1].data()[3] == 1.f);
+	tagged_vec3f second = *(col.begin() + 1);
+	ASSERT(second.t == 2);
+}
+
+void test_columnar_annotations() {
+	geom::collection<stamped_vec3d> col {
+		stamped_vec3d { { 0, 0, 0 }, stamp { 10, 1, 2 } },
+		stamped_vec3d { { 1, 2, 3 }, stamp { 20, 3, 4 } },
+		stamped_vec3d { { 4, 5, 6 }, stamp { 30, 5, 6 } } };
+
+	const auto& stamps = col.column<0>();
+	ASSERT(stamps.size() == 3);
+	ASSERT(std::count_if(stamps.begin(), stamps.end(), [](long t) { return t > 15; }) == 2);
+	ASSERT(col.column<2>()[1] == 4);
+
+	stamped_vec3d second = *(col.begin() + 1);
+	ASSERT(second == stamped_vec3d({ 1, 2, 3 }, stamp { 20, 3, 4 }));
+
+	*(col.begin() + 1) = stamped_vec3d { { 7, 8, 9 }, stamp { 40, 7, 8 } };
+	ASSERT(col.column<0>()[1] == 40);
+	ASSERT(col.column<1>()[1] == 7);
+
+	auto first = *col.begin();
+	auto last = *(col.begin() + 2);
+	swap(first, last);
+	ASSERT(*col.begin() == stamped_vec3d({ 4, 5, 6 }, stamp { 30, 5, 6 }));
+	ASSERT(col.column<0>()[2] == 10);
+}
+
+void test_transform_composition() {
+	geom::Transformd sensor { };
+	sensor = Eigen::AngleAxisd(0.5, geom::Vector3d::UnitZ()) * Eigen::Translation3d(1., 0., 0.);
+	geom::Transformd vehicle { };
+	vehicle = Eigen::Translation3d(0., 2., 0.) * Eigen::AngleAxisd(-0.3, geom::Vector3d::UnitX());
+	geom::Transformd world { };
+	world = Eigen::Translation3d(0., 0., 3.);
+
+	auto chain = geom::transform(sensor) | geom::transform(vehicle) | geom::transform(world);
+	const geom::Vector3d p { 1., 2., 3. };
+	ASSERT(chain(p).isApprox(world * (vehicle * (sensor * p))));
+
+	int evaluations = 0;
+	auto dynamic = geom::transform(sensor)
+		| geom::transformf([&]() { ++evaluations; return vehicle; })
+		| geom::transform(world);
+
+	geom::collection<tagged_vec3d> col(1000);
+	for (auto&& x : col.points())
+		x = p;
+	col = dynamic(std::move(col));
+
+	ASSERT(evaluations == 1);
+	ASSERT(col.points()[999].isApprox(world * (vehicle * (sensor * p))));
+
+	//products of plain matrices are folded to a matrix, not to an expression referring to the operands
+	const Eigen::Matrix3d a = Eigen::AngleAxisd(0.5, geom::Vector3d::UnitZ()).toRotationMatrix();
+	const Eigen::Matrix3d b = 2. * Eigen::Matrix3d::Identity();
+	auto linear = geom::transform(a) | geom::transform(b);
+	static_assert(std::is_same<std::decay_t<decltype(linear.m())>, Eigen::Matrix3d>::value, "");
+	auto linear_dynamic = geom::transformf([&]() { return a; }) | geom::transformf([&]() { return b; });
+	static_assert(std::is_same<decltype(linear_dynamic.m()), Eigen::Matrix3d>::value, "");
+	ASSERT(linear(p).isApprox(b * (a * p)));
+	ASSERT(linear_dynamic(p).isApprox(b * (a * p)));
+
+	tagged_vec3d obj { p, tag { 4 } };
+	auto moved = chain(obj);
+	ASSERT(moved.point.isApprox(world * (vehicle * (sensor * p))));
+	ASSERT(moved.t == 4);
+}
+
+void test_transform_kinds() {
+	using translation = geom::translation<double, 3>;
+	using rotation = geom::rotation<double, 3>;
+	using rigid = geom::rigid<double, 3>;
+	using scale = geom::uniform_scale<double, 3>;
+
+	const translation t { { 1., 2., 3. } };
+	const rotation r { Eigen::AngleAxisd(0.7, geom::Vector3d::UnitY()).toRotationMatrix() };
+	const scale s { 2. };
+
+	static_assert(std::is_same<decltype(t * t), translation>::value, "");
+	static_assert(std::is_same<decltype(r * r), rotation>::value, "");
+	static_assert(std::is_same<decltype(r * t), rigid>::value, "");
+	static_assert(std::is_same<decltype(t * r * t), rigid>::value, "");
+	static_assert(std::is_same<decltype(s * s), scale>::value, "");
+	static_assert(std::is_same<decltype(s * r), geom::affine<double, 3>>::value, "");
+
+	//Eigen types map to the most specific kind
+	static_assert(std::is_same<decltype(geom::as_transform_kind(Eigen::Translation3d())), translation>::value, "");
+	static_assert(std::is_same<decltype(geom::as_transform_kind(Eigen::AngleAxisd())), rotation>::value, "");
+	static_assert(std::is_same<decltype(geom::as_transform_kind(Eigen::Quaterniond())), rotation>::value, "");
+	static_assert(std::is_same<decltype(geom::as_transform_kind(Eigen::Isometry3d())), rigid>::value, "");
+	static_assert(std::is_same<decltype(geom::as_transform_kind(Eigen::Affine3d())), geom::affine<double, 3>>::value, "");
+	static_assert(std::is_same<decltype(geom::as_transform_kind(Eigen::AffineCompact3d())), geom::affine<double, 3>>::value, "");
+	static_assert(std::is_same<decltype(geom::as_transform_kind<3>(Eigen::UniformScaling<double>(2.))), scale>::value, "");
+	static_assert(std::is_same<decltype(geom::as_transform_kind<3>(Eigen::Translation3d())), translation>::value, "");
+	static_assert(std::is_same<decltype(geom::as_transform_kind(r.matrix())), rigid>::value, "");
+
+	const geom::Vector3d p { 1., -1., 0.5 };
+	const Eigen::Isometry3d iso { Eigen::Translation3d(1., 2., 3.) * Eigen::AngleAxisd(0.7, geom::Vector3d::UnitY()) };
+	ASSERT((geom::as_transform_kind(iso) * p).isApprox(iso * p));
+	ASSERT((geom::as_transform_kind(iso).inverse() * p).isApprox(iso.inverse() * p));
+	ASSERT((geom::as_transform_kind<3>(Eigen::Scaling(2.)) * p).isApprox(2. * p));
+	ASSERT((t * r * t * p).isApprox(t.matrix() * r.matrix() * t.matrix() * p));
+	ASSERT((s * (r * t) * p).isApprox(s.matrix() * r.matrix() * t.matrix() * p));
+	ASSERT(((r * t).inverse() * (r * t * p)).isApprox(p));
+
+	geom::collection<tagged_vec3d> packed(5);
+	geom::collection<tagged_vec3d, geom::soa_layout> soa(5);
+	for (std::size_t i = 0; i < 5; ++i) {
+		packed.points()[i] = p * double(i);
+		soa.points()[i] = p * double(i);
+	}
+
+	const auto m = s * (r * t);
+	packed.transform(t);
+	packed.transform(r);
+	packed.transform(s);
+	soa.transform(m.matrix());
+	for (std::size_t i = 0; i < 5; ++i)
+		ASSERT(packed.points()[i].isApprox(soa.points()[i]));
+
+	soa.transform(Eigen::Translation3d(1., 1., 1.));
+	ASSERT(soa.points()[0].isApprox(m * geom::Vector3d::Zero() + geom::Vector3d::Ones()));
+	soa.transform(Eigen::Scaling(0.5));
+	ASSERT(soa.points()[0].isApprox(0.5 * (m * geom::Vector3d::Zero() + geom::Vector3d::Ones())));
+	packed.transform(iso);
+	ASSERT(packed.points()[1].isApprox(iso * (m * p)));
+}
+
+void test_kd_tree() {
+	std::mt19937 gen { 42 };
+	std::uniform_real_distribution<> d(-10, 10);
+	geom::collection<tagged_vec3d> col(2000);
+	for (auto&& x : col.points())
+		x = geom::Vector3d { d(gen), d(gen), d(gen) };
+
+	geom::thread_pool pool { 3 };
+	const geom::kd_tree<geom::collection<tagged_vec3d>> tree { col, 8, geom::parallel.on(pool) };
+	ASSERT(tree.size() == col.size());
+
+	std::vector<geom::Vector3d> queries { };
+	for (int i = 0; i < 50; ++i)
+		queries.emplace_back(d(gen), d(gen), d(gen));
+
+	const std::size_t k = 5;
+	const auto batched = tree.knn(queries, k, geom::parallel.on(pool));
+	for (std::size_t q = 0; q < queries.size(); ++q) {
+		std::vector<std::size_t> brute(col.size());
+		std::iota(brute.begin(), brute.end(), std::size_t { 0 });
+		std::partial_sort(brute.begin(), brute.begin() + k, brute.end(),
+				[&](std::size_t l, std::size_t r) {
+					return (col.points()[l] - queries[q]).squaredNorm()
+							< (col.points()[r] - queries[q]).squaredNorm();
+				});
+		brute.resize(k);
+		ASSERT(tree.knn(queries[q], k) == brute);
+		ASSERT(std::equal(brute.begin(), brute.end(), batched.begin() + q * k));
+
+		auto in_radius = tree.radius(queries[q], 3.);
+		std::sort(in_radius.begin(), in_radius.end());
+		std::vector<std::size_t> expected { };
+		for (std::size_t i = 0; i < col.size(); ++i)
+			if ((col.points()[i] - queries[q]).norm() <= 3.)
+				expected.push_back(i);
+		ASSERT(in_radius == expected);
+	}
+
+	const auto all_in_radius = tree.radius(queries, 3., geom::sequential);
+	ASSERT(all_in_radius.size() == queries.size());
+	ASSERT(tree.knn(queries[0], col.size() + 10).size() == col.size());
+}
+
+void test_reductions() {
+	std::mt19937 gen { 7 };
+	std::uniform_real_distribution<> d(-5, 5);
+	geom::collection<tagged_vec3d, geom::soa_layout> col(10000);
+	for (auto&& x : col.points())
+		x = geom::Vector3d { d(gen), d(gen), d(gen) } + geom::Vector3d(1e6, -2e6, 3e6);
+
+	geom::Vector3d lower = col.points()[0], upper = lower, sum = geom::Vector3d::Zero();
+	for (geom::Vector3d p : col.points()) {
+		lower = lower.cwiseMin(p);
+		upper = upper.cwiseMax(p);
+		sum += p;
+	}
+	const geom::Vector3d mean = sum / col.size();
+	Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+	for (geom::Vector3d p : col.points())
+		covariance += (p - mean) * (p - mean).transpose();
+	covariance /= col.size();
+
+	geom::thread_pool pool { 4 };
+	const auto seq = col.statistics();
+	const auto par = col.statistics(geom::parallel.on(pool).with_grain(999));
+	for (const auto& s : { seq, par }) {
+		ASSERT(s.count == col.size());
+		ASSERT(s.bounds.min() == lower);
+		ASSERT(s.bounds.max() == upper);
+		ASSERT(s.centroid().isApprox(mean));
+		ASSERT((s.covariance() - covariance).norm() < 1e-6);
+	}
+
+	ASSERT(col.bounds(geom::parallel.on(pool)).max() == upper);
+	ASSERT(col.centroid().isApprox(mean));
+	ASSERT((col.covariance(geom::parallel.on(pool)) - covariance).norm() < 1e-6);
+
+	geom::collection<tagged_vec3d> empty { };
+	ASSERT(empty.bounds().isEmpty());
+	ASSERT(empty.statistics().count == 0);
+}
+
+template<class layout>
+void check_erase_if() {
+	geom::collection<tagged_vec3d, layout> col(1000);
+	for (int i = 0; i < 1000; ++i)
+		col.begin()[i] = tagged_vec3d { geom::Vector3d(i, -i, 2 * i), tag { i } };
+
+	//filter and erase_if agree over several tiles, the first of which is kept completely
+	const auto sparse = [](const tag& t) { return t.t >= 300 && t.t % 7 != 0; };
+	const auto kept = col.filter(geom::by_annotation([&sparse](const tag& t) { return !sparse(t); }));
+	auto erased = col;
+	ASSERT_EQUAL(col.size() - kept.size(), erased.erase_if(geom::by_annotation(sparse)));
+	ASSERT_EQUAL(kept.size(), erased.size());
+	ASSERT_EQUAL(300 + 100, kept.size());
+	const auto& compacted = erased;
+	for (std::size_t i = 0; i < kept.size(); ++i) {
+		const int t = compacted.meta().load(i).t;
+		ASSERT_EQUAL(kept.meta().load(i).t, t);
+		const geom::Vector3d p = compacted.points()[i];
+		ASSERT(geom::Vector3d(kept.points()[i]) == p);
+		ASSERT((p - geom::Vector3d(t, -t, 2 * t)).cwiseAbs().maxCoeff() < 1e-6);
+	}
+
+	ASSERT_EQUAL(750, col.erase_if(geom::by_point([](const auto& p) { return p.x() >= 250; })));
+	ASSERT_EQUAL(250, col.size());
+	ASSERT_EQUAL(125, col.erase_if(geom::by_annotation([](const tag& t) { return t.t % 2 == 1; })));
+	ASSERT_EQUAL(50, col.erase_if([](const tagged_vec3d& o) { return o.t < 100; }));
+	ASSERT_EQUAL(75, col.size());
+	for (int i = 0; i < 75; ++i) {
+		const tagged_vec3d o = col.begin()[i];
+		ASSERT_EQUAL(100 + 2 * i, o.t);
+		ASSERT((o.point - geom::Vector3d(o.t, -o.t, 2 * o.t)).cwiseAbs().maxCoeff() < 1e-6);
+	}
+}
+
+void test_erase_filter() {
+	check_erase_if<geom::packed_layout>();
+	check_erase_if<geom::soa_layout>();
+	check_erase_if<geom::padded_layout>();
+	check_erase_if<geom::quantized_layout<>>();
+
+	geom::collection<stamped_vec3d> col(100);
+	for (int i = 0; i < 100; ++i)
+		col.begin()[i] = stamped_vec3d { geom::Vector3d(i, 0, 0), stamp { i, 2 * i, 3 * i } };
+	const auto odd = col.filter(geom::by_annotation([](const stamp& s) { return s.t % 2 == 1; }));
+	ASSERT_EQUAL(100, col.size());
+	ASSERT_EQUAL(50, odd.size());
+	for (std::size_t i = 0; i < odd.size(); ++i) {
+		ASSERT_EQUAL(long(2 * i + 1), odd.column<0>()[i]);
+		ASSERT_EQUAL(long(6 * i + 3), odd.column<2>()[i]);
+		ASSERT_EQUAL(double(2 * i + 1), odd.points()[i].x());
+	}
+	ASSERT(col.filter([](const stamped_vec3d&) { return false; }).empty());
+
+	const std::vector<stamped_vec3d> copy(col.begin(), col.end());
+	ASSERT_EQUAL(100, std::distance(col.cbegin(), col.cend()));
+	ASSERT(copy.back() == stamped_vec3d(geom::Vector3d(99, 0, 0), stamp { 99, 198, 297 }));
+}
+
+void test_reorder_spatially() {
+	ASSERT_EQUAL(1, geom::morton_code<3>({ 1, 0, 0 }));
+	ASSERT_EQUAL(2, geom::morton_code<3>({ 0, 1, 0 }));
+	ASSERT_EQUAL(4, geom::morton_code<3>({ 0, 0, 1 }));
+	ASSERT_EQUAL(63, geom::morton_code<3>({ 3, 3, 3 }));
+	ASSERT_EQUAL(0x7fffffffffffffffull, geom::morton_code<3>({ 0x1fffff, 0x1fffff, 0x1fffff }));
+	ASSERT_EQUAL(0xffffffffffffffffull, geom::morton_code<2>({ 0xffffffff, 0xffffffff }));
+
+	std::mt19937_64 gen { 11 };
+	std::vector<std::uint64_t> keys(5000);
+	for (std::size_t i = 0; i < keys.size(); ++i)
+		keys[i] = gen() >> (i % 3 * 20);
+	std::vector<std::size_t> values(keys.size());
+	std::iota(values.begin(), values.end(), std::size_t { 0 });
+	auto expected = keys;
+	std::sort(expected.begin(), expected.end());
+	const auto original = keys;
+	geom::radix_sort_by_key(keys, values);
+	ASSERT(keys == expected);
+	for (std::size_t i = 0; i < keys.size(); ++i)
+		ASSERT_EQUAL(original[values[i]], keys[i]);
+
+	std::uniform_real_distribution<> d(-100, 100);
+	geom::collection<tagged_vec3d, geom::soa_layout> col(4096);
+	for (int i = 0; i < 4096; ++i)
+		col.begin()[i] = tagged_vec3d { geom::Vector3d(d(gen), d(gen), d(gen)), tag { i } };
+	const std::vector<tagged_vec3d> before(col.begin(), col.end());
+	const auto walk = [](const auto& c) {
+		double length = 0;
+		for (std::size_t i = 1; i < c.size(); ++i)
+			length += (c.points()[i] - c.points()[i - 1]).norm();
+		return length;
+	};
+	const auto unordered = walk(col);
+
+	geom::thread_pool pool { 3 };
+	const auto order = col.reorder_spatially(geom::parallel.on(pool).with_grain(500));
+	ASSERT_EQUAL(before.size(), order.size());
+	ASSERT_EQUAL(before.size(), col.size());
+	for (std::size_t i = 0; i < order.size(); ++i)
+		ASSERT(col.begin()[i] == before[order[i]]);
+	ASSERT(walk(col) < unordered / 4);
+
+	geom::collection<tagged_vec3d> empty;
+	ASSERT(empty.reorder_spatially(geom::sequential).empty());
+}
+
+void test_frame_arena() {
+	geom::frame_arena arena { 1 << 20 };
+	using arena_vec3d = geom::arena_allocator<stamped_vec3d>;
+	using arena_collection = geom::collection<stamped_vec3d, geom::soa_layout, arena_vec3d>;
+
+	std::size_t capacity = 0;
+	for (int frame = 0; frame < 3; ++frame) {
+		arena_collection col(3000, geom::uninitialized, arena);
+		for (int i = 0; i < 3000; ++i)
+			col.begin()[i] = stamped_vec3d { geom::Vector3d(i, frame, 0), stamp { i, frame, 0 } };
+		const auto evens = col.filter(geom::by_annotation([](const stamp& s) { return s.t % 2 == 0; }));
+		ASSERT_EQUAL(1500, evens.size());
+		ASSERT(evens.get_allocator() == arena_vec3d(arena));
+		ASSERT_EQUAL(frame, evens.column<1>()[1499]);
+		ASSERT_EQUAL(2998.0, evens.points()[1499].x());
+		ASSERT_EQUAL(0u, reinterpret_cast<std::uintptr_t>(&col.points()[0].x()) % EIGEN_MAX_ALIGN_BYTES);
+
+		if (frame == 0)
+			capacity = arena.capacity();
+		//memory of the previous frame is recycled, the arena does not grow
+		ASSERT_EQUAL(capacity, arena.capacity());
+		arena.reset();
+	}
+
+	geom::collection<tagged_vec3d, geom::soa_layout> zeroed(100);
+	zeroed.points().resize(200);
+	for (geom::Vector3d p : zeroed.points())
+		ASSERT(p.isZero());
+	geom::collection<tagged_vec3d, geom::padded_layout> padded(10, geom::uninitialized);
+	ASSERT_EQUAL(10, padded.size());
+}
+
+void test_mapped_collection() {
+	const std::string path = "geom_test_mapped.bin";
+
+	geom::collection<tagged_vec3d, geom::soa_layout> soa(1000);
+	for (int i = 0; i < 1000; ++i)
+		soa.begin()[i] = tagged_vec3d { geom::Vector3d(i, 2 * i, 3 * i), tag { -i } };
+	geom::write_collection(soa, path);
+	{
+		geom::mapped_collection<tagged_vec3d, geom::soa_layout> mapped { path };
+		ASSERT_EQUAL(1000, mapped.size());
+		ASSERT(mapped.points()[999] == geom::Vector3d(999, 1998, 2997));
+		ASSERT_EQUAL(-999, mapped.annotations()[999].t);
+		ASSERT(std::equal(mapped.begin(), mapped.end(), soa.begin(),
+				[](const tagged_vec3d& l, const tagged_vec3d& r) { return l == r; }));
+		ASSERT(mapped.points().block(10, 990) == soa.points().block(10, 990));
+
+		const geom::collection<tagged_vec3d> copy(mapped.begin(), mapped.end());
+		ASSERT_EQUAL(1000, copy.size());
+		ASSERT(copy.points()[5] == geom::Vector3d(5, 10, 15));
+
+		const auto moved = std::move(mapped);
+		ASSERT_EQUAL(1000, moved.size());
+		ASSERT(mapped.empty());
+	}
+	ASSERT_THROWS((geom::mapped_collection<tagged_vec3d, geom::packed_layout> { path }), std::runtime_error);
+	ASSERT_THROWS((geom::mapped_collection<stamped_vec3d, geom::soa_layout> { path }), std::runtime_error);
+
+	geom::collection<stamped_vec3d> columns(77);
+	for (int i = 0; i < 77; ++i)
+		columns.begin()[i] = stamped_vec3d { geom::Vector3d(i, 0, 1), stamp { i, i * i, 7 } };
+	geom::write_collection(columns, path);
+	{
+		geom::mapped_collection<stamped_vec3d> mapped { path };
+		ASSERT_EQUAL(77, mapped.size());
+		ASSERT_EQUAL(76 * 76, mapped.column<1>()[76]);
+		ASSERT(mapped[40] == stamped_vec3d(geom::Vector3d(40, 0, 1), stamp { 40, 1600, 7 }));
+	}
+
+	geom::write_collection(geom::collection<stamped_vec3d> { }, path);
+	ASSERT(geom::mapped_collection<stamped_vec3d> { path }.empty());
+
+	//unused capacity of the coordinate arrays isn't written, files of equal collections are equal
+	geom::collection<tagged_vec3d, geom::soa_layout> grown;
+	grown.reserve(100000);
+	for (int i = 0; i < 1000; ++i)
+		grown.push_back(tagged_vec3d { geom::Vector3d(i, 2 * i, 3 * i), tag { -i } });
+	grown.erase_if(geom::by_annotation([](const tag& t) { return t.t % 10 != 0; }));
+	geom::collection<tagged_vec3d, geom::soa_layout> exact(grown.size());
+	for (std::size_t i = 0; i < grown.size(); ++i) {
+		exact.points()[i] = grown.points()[i];
+		exact.meta()[i] = grown.meta()[i];
+	}
+	const auto contents = [](const std::string& file) {
+		std::ifstream in { file, std::ios::binary };
+		return std::string { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+	};
+	geom::write_collection(exact, path);
+	const auto expected = contents(path);
+	geom::write_collection(grown, path);
+	ASSERT(expected == contents(path));
+	ASSERT(expected.size() < 100 * (sizeof(geom::Vector3d) + sizeof(tag)) + 1024);
+	{
+		const geom::mapped_collection<tagged_vec3d, geom::soa_layout> cropped { path };
+		ASSERT(cropped.points()[99] == geom::Vector3d(990, 1980, 2970));
+	}
+
+	//corrupt headers, block sizes of 2^62 + 1 objects overflow to a few bytes, zero strides read one point
+	const auto patch = [&path](std::size_t offset, std::uint64_t value) {
+		std::fstream file { path, std::ios::in | std::ios::out | std::ios::binary };
+		file.seekp(std::streamoff(offset));
+		file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+	};
+	const geom::collection<tagged_vec3d> packed(soa.begin(), soa.end());
+	for (const auto field : { offsetof(geom::file_header, count), offsetof(geom::file_header, point_stride),
+			offsetof(geom::file_header, coordinate_stride) }) {
+		geom::write_collection(packed, path);
+		patch(field, field == offsetof(geom::file_header, count) ? (std::uint64_t { 1 } << 62) + 1 : 0);
+		ASSERT_THROWS((geom::mapped_collection<tagged_vec3d> { path }), std::runtime_error);
+		ASSERT_THROWS((geom::chunk_reader<tagged_vec3d> { path }), std::runtime_error);
+	}
+	geom::write_collection(soa, path);
+	patch(offsetof(geom::file_header, coordinate_stride), 999);
+	ASSERT_THROWS((geom::mapped_collection<tagged_vec3d, geom::soa_layout> { path }), std::runtime_error);
+
+	std::ofstream { path } << "not a collection file, but long enough for a header......................";
+	ASSERT_THROWS(geom::mapped_collection<stamped_vec3d> { path }, std::runtime_error);
+	std::remove(path.c_str());
+	ASSERT_THROWS(geom::mapped_collection<stamped_vec3d> { path }, std::runtime_error);
+}
+
+void test_chunk_stream() {
+	const std::string in = "geom_test_chunks_in.bin";
+	const std::string out = "geom_test_chunks_out.bin";
+
+	geom::collection<tagged_vec3d, geom::soa_layout> source(1000);
+	for (int i = 0; i < 1000; ++i)
+		source.begin()[i] = tagged_vec3d { geom::Vector3d(i, 0, -i), tag { i } };
+	geom::write_collection(source, in);
+
+	const Eigen::Translation3d shift { 0, 1, 0 };
+	{
+		geom::chunk_reader<tagged_vec3d, geom::soa_layout> reader { in };
+		ASSERT_EQUAL(1000, reader.size());
+		geom::chunk_writer<tagged_vec3d, geom::soa_layout> writer { out, reader.size() };
+		std::size_t chunks = 0;
+		geom::for_each_chunk(reader, 300, [&](auto& chunk) {
+			ASSERT_EQUAL(chunks < 3 ? 300 : 100, chunk.size());
+			ASSERT_EQUAL(int(chunks * 300), chunk.points()[0].x());
+			++chunks;
+			chunk.transform(shift);
+			chunk.erase_if(geom::by_annotation([](tag t) { return t.t % 2 != 0; }));
+			writer.write(chunk);
+		});
+		ASSERT_EQUAL(4, chunks);
+		ASSERT_EQUAL(500, writer.size());
+	}
+	{
+		geom::mapped_collection<tagged_vec3d, geom::soa_layout> mapped { out };
+		ASSERT_EQUAL(500, mapped.size());
+		for (int i = 0; i < 500; ++i)
+			ASSERT(mapped[i] == tagged_vec3d(geom::Vector3d(2 * i, 1, -2 * i), tag { 2 * i }));
+	}
+	{
+		//a single chunk is processed without a reader thread, errors stop the stream
+		geom::chunk_reader<tagged_vec3d, geom::soa_layout> reader { in };
+		std::size_t chunks = 0;
+		geom::for_each_chunk(reader, 5000, [&](auto& chunk) {
+			ASSERT_EQUAL(1000, chunk.size());
+			++chunks;
+		});
+		ASSERT_EQUAL(1, chunks);
+		chunks = 0;
+		ASSERT_THROWS(geom::for_each_chunk(reader, 100, [&](auto&) {
+			if (++chunks == 3)
+				throw std::runtime_error { "stop" };
+		}), std::runtime_error);
+		ASSERT_EQUAL(3, chunks);
+	}
+
+	geom::collection<stamped_vec3d, geom::packed_layout> columns(50);
+	for (int i = 0; i < 50; ++i)
+		columns.begin()[i] = stamped_vec3d { geom::Vector3d(i, i, i), stamp { i, 2 * i, 3 * i } };
+	geom::write_collection(columns, in);
+	geom::chunk_reader<stamped_vec3d, geom::packed_layout> reader { in };
+	geom::collection<stamped_vec3d, geom::packed_layout> chunk;
+	reader.read(45, 5, chunk);
+	ASSERT_EQUAL(5, chunk.size());
+	ASSERT(chunk.begin()[4] == stamped_vec3d(geom::Vector3d(49, 49, 49), stamp { 49, 98, 147 }));
+	ASSERT_THROWS(reader.read(45, 6, chunk), std::out_of_range);
+	ASSERT_THROWS((geom::chunk_reader<stamped_vec3d, geom::padded_layout> { in }), std::runtime_error);
+
+	geom::chunk_writer<stamped_vec3d, geom::packed_layout> small { out, 10 };
+	ASSERT_THROWS(small.write(columns), std::length_error);
+
+	std::remove(in.c_str());
+	std::remove(out.c_str());
+}
+
+void test_quantized_layout() {
+	using quantized = geom::collection<tagged_vec3d, geom::quantized_layout<std::int16_t>>;
+	using reference = geom::collection<tagged_vec3d, geom::soa_layout>;
+
+	quantized q(1000);
+	const quantized& cq = q;
+	ASSERT(cq.points()[999].isZero());
+	q.points().requantize(geom::quantization<double, 3> { 0.01, geom::Vector3d(100, 0, -100) });
+	ASSERT(q.points().bounds().contains(geom::Vector3d(400, -300, -400)));
+	ASSERT(cq.points()[0].isZero());
+
+	reference exact(1000);
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(-200, 200);
+	for (int i = 0; i < 1000; ++i) {
+		const tagged_vec3d o { geom::Vector3d(100 + d(gen), d(gen), -100 + d(gen)), tag { i } };
+		exact.begin()[i] = o;
+		q.begin()[i] = o;
+	}
+	const double error = cq.points().get_quantization().max_error();
+	for (int i = 0; i < 1000; ++i) {
+		const tagged_vec3d o = q.begin()[i];
+		ASSERT_EQUAL(i, o.t);
+		ASSERT((o.point - exact.points()[i]).cwiseAbs().maxCoeff() <= error * (1 + 1e-9));
+	}
+
+	const Eigen::Translation3d shift { 1.234567, 0, -2.5 };
+	q.transform(shift);
+	exact.transform(shift);
+	for (int i = 0; i < 1000; ++i)
+		ASSERT((cq.points()[i] - exact.points()[i]).cwiseAbs().maxCoeff() <= 2 * error * (1 + 1e-9));
+	ASSERT((q.centroid() - exact.centroid()).cwiseAbs().maxCoeff() <= 2 * error);
+	ASSERT(q.bounds().isApprox(exact.bounds(), 1e-4));
+
+	//coordinates outside the bounds fail an assertion in debug builds and saturate otherwise
+#ifdef NDEBUG
+	const auto first = cq.points()[0];
+	q.begin()[0] = tagged_vec3d { geom::Vector3d(1e6, std::nan(""), -1e6), tag { 0 } };
+	const geom::Vector3d saturated = cq.points()[0];
+	ASSERT_EQUAL_DELTA(q.points().bounds().max().x(), saturated.x(), 1e-9);
+	ASSERT_EQUAL_DELTA(q.points().bounds().max().y(), saturated.y(), 1e-9);
+	ASSERT_EQUAL_DELTA(q.points().bounds().min().z(), saturated.z(), 1e-9);
+	q.points()[0] = first;
+#endif
+	static_assert(std::is_same<geom::quantized_layout<>::code_type, std::int32_t>::value, "");
+	static_assert(geom::detail::highest_code<std::int32_t, float>() == 2147483520.f, "");
+	static_assert(geom::detail::highest_code<std::int16_t, float>() == 32767.f, "");
+	ASSERT_EQUAL_DELTA(100 + 0.01 * 32767, q.points().bounds().max().x(), 1e-9);
+
+	const auto even = q.filter(geom::by_annotation([](tag t) { return t.t % 2 == 0; }));
+	ASSERT_EQUAL(500, even.size());
+	ASSERT_EQUAL(0.01, even.points().get_quantization().step);
+	ASSERT(even.points()[7] == cq.points()[14]);
+	const auto order = q.reorder_spatially(geom::sequential);
+	for (std::size_t i = 0; i < order.size(); ++i)
+		if (order[i] != 0)
+			ASSERT((cq.points()[i] - exact.points()[order[i]]).cwiseAbs().maxCoeff() <= 2 * error * (1 + 1e-9));
+}
+
+template<class layout>
+void check_append() {
+	using collection_t = geom::collection<tagged_vec3d, layout>;
+	collection_t col;
+	col.reserve(10);
+	for (int i = 0; i < 10; ++i)
+		col.emplace_back(geom::Vector3d(i, -i, 2 * i), tag { i });
+	col.push_back(tagged_vec3d { geom::Vector3d(10, -10, 20), tag { 10 } });
+	ASSERT_EQUAL(11, col.size());
+
+	std::vector<geom::Vector3d> points;
+	std::vector<tag> meta;
+	for (int i = 11; i < 300; ++i) {
+		points.emplace_back(i, -i, 2 * i);
+		meta.push_back(tag { i });
+	}
+	col.append(points.data(), meta.data(), points.size());
+	ASSERT_EQUAL(300, col.size());
+
+	collection_t tail(100);
+	for (int i = 0; i < 100; ++i)
+		tail.begin()[i] = tagged_vec3d { geom::Vector3d(300 + i, -300 - i, 600 + 2 * i), tag { 300 + i } };
+	col.append(tail);
+	col.append(col);
+	ASSERT_EQUAL(800, col.size());
+	ASSERT_THROWS(col.append(points.data(), meta.data(), col.points().max_size()), std::length_error);
+	ASSERT_EQUAL(800, col.size());
+	ASSERT_EQUAL(800, col.points().size());
+	for (int i = 0; i < 800; ++i) {
+		const tagged_vec3d o = col.begin()[i];
+		const int v = i % 400;
+		ASSERT_EQUAL(v, o.t);
+		ASSERT(o.point == geom::Vector3d(v, -v, 2 * v));
+	}
+}
+
+void test_append() {
+	check_append<geom::packed_layout>();
+	check_append<geom::soa_layout>();
+	check_append<geom::padded_layout>();
+	check_append<geom::quantized_layout<std::int32_t>>();
+
+	geom::collection<stamped_vec3d> columns;
+	columns.emplace_back(geom::Vector3d(1, 2, 3), stamp { 1, 2, 3 });
+	const stamp more[2] = { stamp { 4, 5, 6 }, stamp { 7, 8, 9 } };
+	const geom::Vector3d more_points[2] = { geom::Vector3d(4, 5, 6), geom::Vector3d(7, 8, 9) };
+	columns.append(more_points, more, 2);
+	columns.append(columns);
+	ASSERT_EQUAL(6, columns.size());
+	ASSERT_EQUAL(8, columns.column<1>()[5]);
+	ASSERT(columns.begin()[3] == stamped_vec3d(geom::Vector3d(1, 2, 3), stamp { 1, 2, 3 }));
+
+	//sizes beyond max_size are rejected before anything is written
+	geom::annotation_storage<tag> meta(3);
+	ASSERT_THROWS(meta.append(meta.data(), meta.max_size() - 2), std::length_error);
+	ASSERT_EQUAL(3, meta.size());
+	auto& stamps = columns.meta();
+	ASSERT_THROWS(stamps.append(more, stamps.max_size()), std::length_error);
+	ASSERT_EQUAL(6, stamps.size());
+
+	//a failed annotation copy removes the points appended before it
+	geom::collection<geom::object<geom::Vector3d, fragile>> guarded(2);
+	const fragile bad[2] = { fragile { 1 }, fragile { -1 } };
+	ASSERT_THROWS(guarded.append(more_points, bad, 2), std::runtime_error);
+	ASSERT_EQUAL(2, guarded.size());
+	ASSERT_EQUAL(2, guarded.points().size());
+	ASSERT_EQUAL(2, guarded.meta().size());
+}
+
+void test_collection_view() {
+	geom::collection<tagged_vec3d, geom::soa_layout> col(1000);
+	for (int i = 0; i < 1000; ++i)
+		col.begin()[i] = tagged_vec3d { geom::Vector3d(i, -i, 2 * i), tag { i } };
+
+	const auto low = geom::view(col).filter(geom::by_point([](const auto& p) { return p.x() < 500; }));
+	const auto even = geom::view(col).filter(geom::by_annotation([](tag t) { return t.t % 2 == 0; }));
+	auto both = low & even;
+	ASSERT_EQUAL(500, low.size());
+	ASSERT_EQUAL(250, both.size());
+	ASSERT_EQUAL(250, low.filter(geom::by_annotation([](tag t) { return t.t % 2 == 0; })).size());
+	ASSERT_EQUAL(498, both.indices().back());
+	ASSERT(both[3] == tagged_vec3d(geom::Vector3d(6, -6, 12), tag { 6 }));
+
+	std::vector<bool> mask(1000);
+	mask[3] = mask[500] = true;
+	const geom::collection_view<decltype(col)> masked { col, mask };
+	ASSERT_EQUAL(2, masked.size());
+	ASSERT(masked.mask() == mask);
+	ASSERT((masked & low).indices() == std::vector<std::size_t> { 3 });
+
+	ASSERT(low.centroid().isApprox(geom::Vector3d(249.5, -249.5, 499)));
+	ASSERT(both.bounds(geom::parallel).max().isApprox(geom::Vector3d(498, 0, 996)));
+	const auto copy = both.to_collection();
+	ASSERT_EQUAL(250, copy.size());
+	ASSERT(copy.covariance().isApprox(both.covariance()));
+
+	auto high = geom::view(col).filter(geom::by_point([](const auto& p) { return p.x() >= 500; }));
+	high.transform(Eigen::Translation3d(0, 0, 1), geom::parallel);
+	both.transform(Eigen::Translation3d(0, 1, 0));
+	ASSERT(col.points()[999] == geom::Vector3d(999, -999, 1999));
+	ASSERT(col.points()[2] == geom::Vector3d(2, -1, 4));
+	ASSERT(col.points()[3] == geom::Vector3d(3, -3, 6));
+
+	for (auto&& o : both)
+		o = tagged_vec3d { geom::Vector3d::Zero(), tag { -1 } };
+	ASSERT_EQUAL(250, std::count_if(col.begin(), col.end(), [](const tagged_vec3d& o) { return o.t == -1; }));
+}
+
+void test_culling() {
+	std::mt19937 gen { 42 };
+	std::uniform_real_distribution<> d(-10, 10);
+	geom::collection<tagged_vec3d, geom::soa_layout> col(5000);
+	for (int i = 0; i < 5000; ++i)
+		col.begin()[i] = tagged_vec3d { geom::Vector3d(d(gen), d(gen), d(gen)), tag { i } };
+
+	//camera at the origin looking down -z, 90 degree field of view, near 1, far 8
+	Eigen::Matrix4d projection = Eigen::Matrix4d::Zero();
+	projection(0, 0) = projection(1, 1) = 1;
+	projection(2, 2) = -9. / 7.;
+	projection(2, 3) = -16. / 7.;
+	projection(3, 2) = -1;
+	const auto frustum = geom::convex_volume<double, 3>::frustum(projection);
+	ASSERT_EQUAL(6, frustum.planes().size());
+	ASSERT(frustum.contains(geom::Vector3d(0.5, -0.5, -2)));
+	ASSERT(!frustum.contains(geom::Vector3d(0, 0, 2)));
+	ASSERT(!frustum.contains(geom::Vector3d(3, 0, -2)));
+
+	const Eigen::Transform<double, 3, Eigen::Affine> pose = Eigen::Translation3d(2, 0, 0)
+			* Eigen::AngleAxisd(0.5, geom::Vector3d::UnitZ()) * Eigen::Scaling(4., 2., 1.);
+	const auto box = geom::convex_volume<double, 3>::oriented_box(pose);
+	const Eigen::AlignedBox3d aligned { geom::Vector3d(-5, -2, 0), geom::Vector3d(3, 4, 6) };
+
+	std::vector<std::size_t> in_frustum, in_box, in_aligned;
+	for (std::size_t i = 0; i < col.size(); ++i) {
+		const geom::Vector3d p = col.points()[i];
+		const auto clip = (projection * p.homogeneous()).eval();
+		if ((clip.head<3>().array().abs() <= clip.w()).all())
+			in_frustum.push_back(i);
+		if (((pose.inverse() * p).array().abs() <= 1 + 1e-12).all())
+			in_box.push_back(i);
+		if (aligned.contains(p))
+			in_aligned.push_back(i);
+	}
+	ASSERT(!in_frustum.empty() && !in_box.empty());
+
+	geom::thread_pool pool { 3 };
+	const auto policy = geom::parallel.on(pool).with_grain(300);
+	ASSERT(geom::cull(col, frustum, policy) == in_frustum);
+	ASSERT(geom::cull(col, box, geom::sequential) == in_box);
+	ASSERT(geom::cull(col, aligned) == in_aligned);
+	ASSERT(geom::cull(col, geom::convex_volume<double, 3> { }).size() == col.size());
+
+	const geom::kd_tree<decltype(col)> tree { col, 8, geom::parallel.on(pool) };
+	ASSERT(geom::cull(tree, frustum) == in_frustum);
+	ASSERT(geom::cull(tree, box) == in_box);
+	ASSERT(geom::cull(tree, aligned) == in_aligned);
+	ASSERT(geom::cull(tree, Eigen::AlignedBox3d { geom::Vector3d::Constant(20), geom::Vector3d::Constant(30) }).empty());
+
+	const auto mask = geom::cull_mask(col, aligned, policy);
+	ASSERT(geom::collection_view<decltype(col)>(col, mask).indices() == in_aligned);
+	const auto bits = geom::cull_bits(col, std::vector<geom::convex_volume<double, 3>> { frustum, box }, policy);
+	for (const auto i : in_box)
+		ASSERT(bits[i] & 2);
+	ASSERT_EQUAL(std::ptrdiff_t(in_frustum.size()), std::count_if(bits.begin(), bits.end(), [](std::uint32_t b) { return b & 1; }));
+
+	ASSERT_EQUAL(col.size() - in_box.size(), geom::cull_in_place(col, box, policy));
+	ASSERT_EQUAL(in_box.size(), col.size());
+	ASSERT_EQUAL(int(in_box[1]), col.meta()[1].t);
+}
+
+void test_instrumentation() {
+	const auto before = geom::instrumentation_snapshot();
+	{
+		const geom::scoped_probe probe { geom::operation::io, 10, 80 };
+	}
+	std::thread { [] { const geom::scoped_probe probe { geom::operation::io, 5, 40 }; } }.join();
+	geom::collection<tagged_vec3d, geom::soa_layout> col(1000);
+	col.transform(Eigen::Translation3d(1, 2, 3), geom::parallel);
+	const auto spent = geom::instrumentation_snapshot() - before;
+
+	ASSERT_EQUAL(2u, spent[geom::operation::io].calls);
+	ASSERT_EQUAL(15u, spent[geom::operation::io].points);
+	ASSERT_EQUAL(120u, spent[geom::operation::io].bytes);
+	ASSERT_EQUAL(geom::instrumentation_enabled ? 1u : 0u, spent[geom::operation::transform].calls);
+	if (geom::instrumentation_enabled) {
+		ASSERT_EQUAL(1000u, spent[geom::operation::transform].points);
+		ASSERT_EQUAL(2u * 1000u * 3u * sizeof(double), spent[geom::operation::transform].bytes);
+		ASSERT(spent[geom::operation::allocation].calls >= 2);
+	}
+	ASSERT_EQUAL(std::string("tree_query"), geom::operation_name(geom::operation::tree_query));
+
+	//counts of finished threads remain after their counters are released
+	const auto running = geom::instrumentation_snapshot();
+	for (int t = 0; t < 4; ++t)
+		std::thread { [] { const geom::scoped_probe probe { geom::operation::io, 1, 8 }; } }.join();
+	ASSERT_EQUAL(4u, (geom::instrumentation_snapshot() - running)[geom::operation::io].calls);
+
+	//pool workers keep their counters until the pool joins them at exit
+	std::atomic<bool> probed { false };
+	geom::default_thread_pool().submit([&probed] {
+		const geom::scoped_probe probe { geom::operation::io, 1, 8 };
+		probed = true;
+	});
+	while (!probed)
+		std::this_thread::yield();
+
+	//probes add the memory visited by queries
+	const geom::kd_tree<decltype(col)> tree { col, 16, geom::sequential };
+	const auto queried = geom::instrumentation_snapshot();
+	tree.knn(geom::Vector3d(1, 2, 3), 4);
+	tree.knn(col.points(), 2, geom::sequential);
+	geom::cull(tree, Eigen::AlignedBox3d(geom::Vector3d::Zero(), geom::Vector3d::Ones()));
+	const auto queries = geom::instrumentation_snapshot() - queried;
+	ASSERT_EQUAL(geom::instrumentation_enabled ? 2u : 0u, queries[geom::operation::tree_query].calls);
+	if (geom::instrumentation_enabled) {
+		ASSERT(queries[geom::operation::tree_query].bytes >= 1001 * sizeof(geom::Vector3d));
+		ASSERT(queries[geom::operation::cull].bytes > 0);
+	}
+}
+
+void test_multi_pose() {
+	std::mt19937 gen { 42 };
+	std::uniform_real_distribution<> d(-10, 10);
+	geom::collection<tagged_vec3d> col(3000);
+	for (auto&& x : col.points())
+		x = geom::Vector3d { d(gen), d(gen), d(gen) };
+
+	std::vector<geom::Transformd, Eigen::aligned_allocator<geom::Transformd>> poses;
+	for (int p = 0; p < 7; ++p)
+		poses.push_back(geom::Transformd(Eigen::Translation3d(p, 0, -p) * Eigen::AngleAxisd(0.3 * p, geom::Vector3d::UnitZ())));
+
+	geom::thread_pool pool { 3 };
+	const auto policy = geom::parallel.on(pool).with_grain(1000);
+	const auto transformed = geom::transform_poses(col, poses.data(), poses.size(), policy);
+	ASSERT_EQUAL(poses.size(), transformed.size());
+	for (std::size_t p = 0; p < poses.size(); ++p)
+		for (std::size_t i = 0; i < col.size(); i += 97)
+			ASSERT(transformed[p].col(i).isApprox(poses[p] * col.points()[i]));
+
+	const auto in_front = [](const auto& block) {
+		return std::size_t((block.row(0).array() > 0).count());
+	};
+	const auto scores = geom::score_poses(col, poses.data(), poses.size(), in_front, policy);
+	ASSERT(scores == geom::score_poses(col, poses.data(), poses.size(), in_front, geom::sequential));
+	for (std::size_t p = 0; p < poses.size(); ++p)
+		ASSERT_EQUAL(std::size_t((transformed[p].row(0).array() > 0).count()), scores[p]);
+	ASSERT(geom::score_poses(col, poses.data(), 0, in_front).empty());
+}
+
+template<class layout>
+void check_transform_into() {
+	using collection_t = geom::collection<tagged_vec3d, layout>;
+	std::mt19937 gen { 42 };
+	std::uniform_real_distribution<> d(-10, 10);
+	collection_t src(2500);
+	for (int i = 0; i < 2500; ++i)
+		src.begin()[i] = tagged_vec3d { geom::Vector3d(d(gen), d(gen), d(gen)), tag { i } };
+	const geom::Transformd m { Eigen::Translation3d(1, -2, 3) * Eigen::AngleAxisd(0.7, geom::Vector3d::UnitY()) };
+	auto expected = src;
+	expected.transform(m);
+	auto before = src;
+
+	geom::transformed_collection<collection_t> dst;
+	geom::transform_into(src, m, dst);
+	const auto equal = [](const tagged_vec3d& l, const tagged_vec3d& r) { return l == r; };
+	ASSERT(std::equal(dst.begin(), dst.end(), expected.begin(), expected.end(), equal));
+	ASSERT(std::equal(src.begin(), src.end(), before.begin(), before.end(), equal));
+	//annotations are shared with the source, not copied
+	ASSERT_EQUAL(&src, dst.source());
+	ASSERT_EQUAL(&src.meta(), &dst.meta());
+	auto copy = dst.to_collection();
+	ASSERT(std::equal(copy.begin(), copy.end(), expected.begin(), expected.end(), equal));
+
+	//reused destination of a different size, parallel and with translation only
+	auto points = expected.points();
+	geom::thread_pool pool { 3 };
+	geom::transform_into(src, Eigen::Translation3d(0, 0, 1), points, geom::parallel.on(pool).with_grain(1000));
+	ASSERT_EQUAL(src.size(), points.size());
+	for (std::size_t i = 0; i < src.size(); i += 13)
+		ASSERT(points[i].isApprox(src.points()[i] + geom::Vector3d::UnitZ()));
+}
+
+void test_transform_into() {
+	check_transform_into<geom::packed_layout>();
+	check_transform_into<geom::soa_layout>();
+	check_transform_into<geom::padded_layout>();
+
+	using quantized = geom::collection<tagged_vec3d, geom::quantized_layout<std::int16_t>>;
+	quantized q(100);
+	q.points().requantize(geom::quantization<double, 3> { 0.01, geom::Vector3d::Zero() });
+	for (int i = 0; i < 100; ++i)
+		q.begin()[i] = tagged_vec3d { geom::Vector3d(i, -i, 0.5 * i), tag { i } };
+	geom::transformed_collection<quantized> coarse;
+	coarse.points().requantize(geom::quantization<double, 3> { 0.25, geom::Vector3d::Zero() });
+	geom::transform_into(q, Eigen::Translation3d(10, 0, 0), coarse);
+	ASSERT_EQUAL(0.25, coarse.points().get_quantization().step);
+	for (int i = 0; i < 100; ++i) {
+		const tagged_vec3d o = coarse[i];
+		ASSERT_EQUAL(i, o.t);
+		ASSERT((o.point - geom::Vector3d(10 + i, -i, 0.5 * i)).cwiseAbs().maxCoeff() <= 0.125 + 1e-9);
+	}
+}
+
+void test_triple_buffer() {
+	using collection_t = geom::collection<tagged_vec3d, geom::soa_layout>;
+	using frame_t = geom::transformed_collection<collection_t>;
+	collection_t zero(1000);
+	for (int i = 0; i < 1000; ++i)
+		zero.begin()[i] = tagged_vec3d { geom::Vector3d::Zero(), tag { } };
+	frame_t initial;
+	geom::transform_into(zero, Eigen::Translation3d::Identity(), initial);
+	geom::triple_buffer<frame_t> frames { initial };
+	{
+		const auto first = frames.acquire();
+		ASSERT(!first.fresh());
+		ASSERT_EQUAL(1000, first->size());
+	}
+
+	//every frame holds its number in all points, a torn frame would mix two numbers
+	constexpr int count = 200;
+	std::thread producer { [&frames, &zero] {
+		for (int f = 1; f <= count; ++f) {
+			geom::transform_into(zero, Eigen::Translation3d(f, f, f), frames.back());
+			frames.publish();
+		}
+	} };
+	int last = 0;
+	while (last < count) {
+		const auto frame = frames.acquire();
+		const auto f = frame->points()[0].x();
+		ASSERT(f >= last);
+		ASSERT(!frame.fresh() || f > last);
+		for (const auto& p : frame->points())
+			ASSERT((p.array() == f).all());
+		last = int(f);
+	}
+	producer.join();
+	const auto held = frames.acquire();
+	ASSERT(!held.fresh());
+
+	//the producer never waits, the frame held by the consumer stays untouched
+	for (int f = count + 1; f <= count + 5; ++f) {
+		geom::transform_into(zero, Eigen::Translation3d(f, f, f), frames.back());
+		frames.publish();
+	}
+	ASSERT_EQUAL(double(count), held->points()[999].z());
+	const auto newest = frames.acquire();
+	ASSERT(newest.fresh());
+	ASSERT_EQUAL(double(count + 5), newest->points()[0].x());
+}
+
+void test_bounded_queues() {
+	geom::spsc_queue<std::vector<int>> spsc { 3 };
+	ASSERT_EQUAL(4, spsc.capacity());
+	ASSERT(spsc.empty());
+	for (int i = 0; i < 4; ++i)
+		ASSERT(spsc.try_push(std::vector<int>(10, i)));
+	std::vector<int> rejected(5, 7);
+	ASSERT(!spsc.try_push(std::move(rejected)));
+	ASSERT_EQUAL(5, rejected.size());
+	ASSERT(spsc.full());
+	std::vector<int> v;
+	for (int i = 0; i < 4; ++i) {
+		ASSERT(spsc.try_pop(v));
+		ASSERT_EQUAL(i, v[9]);
+	}
+	ASSERT(!spsc.try_pop(v));
+
+	//every producer pushes increasing values, consumers check that each producer's values arrive in order
+	constexpr int producers = 3, consumers = 2, count = 20000;
+	geom::mpmc_queue<int> mpmc { 64 };
+	std::atomic<long> sum { 0 };
+	std::atomic<int> popped { 0 };
+	std::atomic<bool> ordered { true };
+	std::vector<std::thread> threads;
+	for (int p = 0; p < producers; ++p)
+		threads.emplace_back([&mpmc, p] {
+			for (int i = 0; i < count; ++i)
+				while (!mpmc.try_push(i * producers + p))
+					std::this_thread::yield();
+		});
+	for (int c = 0; c < consumers; ++c)
+		threads.emplace_back([&] {
+			int last[producers] = { -1, -1, -1 };
+			int value;
+			while (popped < producers * count) {
+				if (!mpmc.try_pop(value)) {
+					std::this_thread::yield();
+					continue;
+				}
+				if (value / producers <= last[value % producers])
+					ordered = false;
+				last[value % producers] = value / producers;
+				sum += value;
+				++popped;
+			}
+		});
+	for (auto& t : threads)
+		t.join();
+	ASSERT(ordered);
+	const long n = long(producers) * count;
+	ASSERT_EQUAL(n * (n - 1) / 2, sum.load());
+	ASSERT(mpmc.empty());
+}
+
+void test_pipeline() {
+	using cloud = geom::collection<tagged_vec3d, geom::soa_layout>;
+	const auto chunk = [](int number) {
+		cloud c(100);
+		for (int i = 0; i < 100; ++i)
+			c.begin()[i] = tagged_vec3d { geom::Vector3d(i, 0, 0), tag { number } };
+		return c;
+	};
+	const auto keep_even = [](cloud c) {
+		c.erase_if(geom::by_point([](const geom::Vector3d& p) { return int(p.x()) % 2 != 0; }));
+		return c;
+	};
+
+	geom::thread_pool pool { 2 };
+	for (int shared = 0; shared < 2; ++shared) {
+		geom::pipeline<cloud> p { 4 };
+		p.then(geom::transform(Eigen::Translation3d(0, 1, 0)) | geom::transform(Eigen::Translation3d(0, 0, 2)))
+		 .then(keep_even);
+		if (shared)
+			p.start(pool);
+		else
+			p.start();
+
+		constexpr int chunks = 50;
+		std::thread producer { [&] {
+			for (int n = 0; n < chunks; ++n)
+				p.push(chunk(n));
+			p.close();
+		} };
+		cloud out;
+		int received = 0;
+		while (p.pop(out)) {
+			ASSERT_EQUAL(50, out.size());
+			ASSERT_EQUAL(received, out.meta()[0].t);
+			ASSERT(out.points()[3] == geom::Vector3d(6, 1, 2));
+			++received;
+		}
+		producer.join();
+		ASSERT_EQUAL(chunks, received);
+
+		const auto stats = p.statistics();
+		ASSERT_EQUAL(chunks, stats.chunks);
+		ASSERT_EQUAL(2, stats.stages.size());
+		ASSERT_EQUAL(chunks, stats.stages[1].chunks);
+		ASSERT(stats.min_latency_nanoseconds <= stats.mean_latency_nanoseconds());
+		ASSERT(stats.mean_latency_nanoseconds() <= stats.max_latency_nanoseconds);
+	}
+
+	geom::pipeline<cloud> failing { 8 };
+	failing.then([](cloud c) {
+		if (c.meta()[0].t == 3)
+			throw std::runtime_error("stage failed");
+		return c;
+	});
+	failing.start(pool);
+	for (int n = 0; n < 6; ++n)
+		failing.push(chunk(n));
+	failing.close();
+	cloud out;
+	int received = 0;
+	ASSERT_THROWS(while (failing.pop(out)) ++received, std::runtime_error);
+	ASSERT_EQUAL(3, received);
+
+	//destroyed without popping, chunks in flight are discarded
+	geom::pipeline<cloud> abandoned { 2 };
+	abandoned.then(keep_even).start();
+	for (int n = 0; n < 3; ++n)
+		abandoned.push(chunk(n));
+}
+
+template<class collection_t>
+void check_projection(const collection_t& c, const geom::pinhole_camera<typename collection_t::scalar_type>& camera) {
+	std::vector<std::size_t> positions;
+	geom::thread_pool pool { 3 };
+	const auto pixels = geom::project(c, camera, geom::parallel.on(pool).with_grain(1000), &positions);
+	const auto sequential = geom::project(c, camera, geom::sequential);
+	ASSERT_EQUAL(pixels.size(), positions.size());
+	ASSERT_EQUAL(pixels.size(), sequential.size());
+
+	std::size_t k = 0;
+	for (std::size_t i = 0; i < c.size(); ++i) {
+		const auto p = c.points()[i];
+		if (!camera.visible(p))
+			continue;
+		ASSERT(k < pixels.size());
+		ASSERT_EQUAL(i, positions[k]);
+		ASSERT(pixels.points()[k].isApprox(camera.project(p)));
+		ASSERT(sequential.points()[k] == pixels.points()[k]);
+		ASSERT(pixels.meta().load(k) == c.meta().load(i));
+		++k;
+	}
+	ASSERT_EQUAL(k, pixels.size());
+}
+
+void test_projection() {
+	std::mt19937 gen { 42 };
+	std::uniform_real_distribution<> d(-20, 20);
+	geom::collection<tagged_vec3d> tagged(5000);
+	geom::collection<stamped_vec3d, geom::soa_layout> stamped(5000);
+	geom::collection<geom::object<geom::Vector3f, tag>> single(5000);
+	for (int i = 0; i < 5000; ++i) {
+		const geom::Vector3d p { d(gen), d(gen), d(gen) };
+		tagged.begin()[i] = tagged_vec3d { p, tag { i } };
+		stamped.begin()[i] = stamped_vec3d { p, stamp { i, 2 * i, -i } };
+		single.begin()[i] = geom::object<geom::Vector3f, tag> { p.cast<float>(), tag { i } };
+	}
+
+	//camera at x = -30 looking along +x, image y pointing down
+	geom::Transformd camera_to_world = geom::Transformd::Identity();
+	camera_to_world.linear() << 0, 0, 1, -1, 0, 0, 0, -1, 0;
+	camera_to_world.translation() = geom::Vector3d(-30, 0, 0);
+	const auto camera = geom::pinhole_camera<double>::from_focal(500, 500, 320, 240, camera_to_world.inverse(), 640, 480, 0.1);
+	ASSERT(camera.visible(geom::Vector3d(0, 0, 0)));
+	ASSERT(camera.project(geom::Vector3d(0, 0, 0)).isApprox(geom::Vector2d(320, 240)));
+	ASSERT(!camera.visible(geom::Vector3d(-40, 0, 0)));
+
+	check_projection(tagged, camera);
+	check_projection(stamped, camera);
+	const auto float_camera = geom::pinhole_camera<float>::from_focal(500, 500, 320, 240,
+			camera_to_world.inverse().cast<float>(), 640, 480, 0.1f);
+	check_projection(single, float_camera);
+
+	const auto all = geom::project(tagged, camera);
+	ASSERT(all.size() > 500 && all.size() < 5000);
+	static_assert(std::is_same<std::decay_t<decltype(all.points()[0])>, geom::Vector2d>::value, "2D points");
+	ASSERT(geom::project(geom::collection<tagged_vec3d> { }, camera).empty());
+}
+
+/// index of the voxel of edge length @p size containing @p p
+std::array<long, 3> voxel_index(const geom::Vector3d& p, double size) {
+	return { { long(std::floor(p.x() / size)), long(std::floor(p.y() / size)), long(std::floor(p.z() / size)) } };
+}
+
+/// voxel of a brute force voxel grid: sum of the points, count, position of the first point, max t and sum of x
+struct voxel_reference {
+	geom::Vector3d sum = geom::Vector3d::Zero();
+	std::size_t count = 0;
+	std::size_t first = 0;
+	long max_t = -1;
+	long sum_x = 0;
+};
+
+void test_voxel_grid() {
+	std::mt19937 gen { 42 };
+	std::uniform_real_distribution<> d(-5, 5);
+	geom::collection<tagged_vec3d> tagged(20000);
+	geom::collection<stamped_vec3d, geom::soa_layout> stamped(20000);
+	std::map<std::array<long, 3>, voxel_reference> voxels;
+	for (int i = 0; i < 20000; ++i) {
+		const geom::Vector3d p { d(gen), d(gen), d(gen) };
+		const int t = (i * 7919) % 20000;
+		tagged.begin()[i] = tagged_vec3d { p, tag { t } };
+		stamped.begin()[i] = stamped_vec3d { p, stamp { t, i, -i } };
+		auto inserted = voxels.emplace(voxel_index(p, 1.5), voxel_reference { });
+		auto& v = inserted.first->second;
+		if (inserted.second)
+			v.first = i;
+		v.sum += p;
+		++v.count;
+		v.max_t = std::max<long>(v.max_t, t);
+		v.sum_x += i;
+	}
+	geom::thread_pool pool { 3 };
+
+	//centroids, latest tag, ordered by the first point of every voxel
+	const auto latest = geom::voxel_downsample(tagged, 1.5, geom::keep_max(&tag::t), geom::parallel.on(pool));
+	ASSERT_EQUAL(voxels.size(), latest.size());
+	for (std::size_t k = 0; k < latest.size(); ++k) {
+		const geom::Vector3d p = latest.points()[k];
+		const auto& v = voxels.at(voxel_index(p, 1.5));
+		ASSERT((v.sum / double(v.count)).isApprox(p));
+		ASSERT(k == 0 || v.first > voxels.at(voxel_index(latest.points()[k - 1], 1.5)).first);
+		ASSERT_EQUAL(v.max_t, latest.meta()[k].t);
+	}
+	const auto first = geom::voxel_downsample(tagged, 1.5, geom::keep_first { }, geom::sequential);
+	ASSERT_EQUAL(latest.size(), first.size());
+	for (std::size_t k = 0; k < first.size(); ++k) {
+		ASSERT(first.points()[k].isApprox(latest.points()[k]));
+		ASSERT_EQUAL(tagged.meta()[voxels.at(voxel_index(first.points()[k], 1.5)).first].t, first.meta()[k].t);
+	}
+
+	//field reductions of columnar annotations, parallel and sequential agree
+	const auto reduction = geom::reduce_fields(geom::max_of(&stamp::t), geom::mean_of(&stamp::x));
+	const auto mixed = geom::voxel_downsample(stamped, 1.5, reduction, geom::parallel.on(pool));
+	const auto mixed_sequential = geom::voxel_downsample(stamped, 1.5, reduction, geom::sequential);
+	ASSERT_EQUAL(voxels.size(), mixed.size());
+	ASSERT_EQUAL(mixed.size(), mixed_sequential.size());
+	for (std::size_t k = 0; k < mixed.size(); ++k) {
+		const auto& v = voxels.at(voxel_index(mixed.points()[k], 1.5));
+		const auto meta = mixed.meta().load(k);
+		ASSERT(mixed_sequential.meta().load(k) == meta);
+		ASSERT(mixed_sequential.points()[k].isApprox(mixed.points()[k]));
+		ASSERT_EQUAL(v.max_t, meta.t);
+		ASSERT_EQUAL(v.sum_x / long(v.count), meta.x);
+		ASSERT_EQUAL(-long(v.first), meta.y);
+	}
+
+	ASSERT(geom::voxel_downsample(geom::collection<tagged_vec3d> { }, 1.0).empty());
+	geom::collection<tagged_vec3d> far(2);
+	far.begin()[1] = tagged_vec3d { geom::Vector3d(0, 1e9, 0), tag { } };
+	ASSERT_THROWS(geom::voxel_downsample(far, 0.1), std::invalid_argument);
+	far.begin()[1] = tagged_vec3d { geom::Vector3d(0, std::nan(""), 0), tag { } };
+	ASSERT_THROWS(geom::voxel_downsample(far, 0.1), std::invalid_argument);
+}
+
 bool runAllTests(int argc, char const *argv[]) {
 	cute::suite s { };
 
 	s.push_back(CUTE(geom_initialize));
 	s.push_back(CUTE(geom_loop));
 	s.push_back(CUTE(test_transforms));
+	s.push_back(CUTE(test_collection_transform));
+	s.push_back(CUTE(test_soa_layout));
+	s.push_back(CUTE(test_parallel_transform));
+	s.push_back(CUTE(test_padded_layout));
+	s.push_back(CUTE(test_columnar_annotations));
+	s.push_back(CUTE(test_transform_composition));
+	s.push_back(CUTE(test_transform_kinds));
+	s.push_back(CUTE(test_kd_tree));
+	s.push_back(CUTE(test_reductions));
+	s.push_back(CUTE(test_erase_filter));
+	s.push_back(CUTE(test_reorder_spatially));
+	s.push_back(CUTE(test_frame_arena));
+	s.push_back(CUTE(test_mapped_collection));
+	s.push_back(CUTE(test_chunk_stream));
+	s.push_back(CUTE(test_quantized_layout));
+	s.push_back(CUTE(test_append));
+	s.push_back(CUTE(test_collection_view));
+	s.push_back(CUTE(test_culling));
+	s.push_back(CUTE(test_instrumentation));
+	s.push_back(CUTE(test_multi_pose));
+	s.push_back(CUTE(test_transform_into));
+	s.push_back(CUTE(test_triple_buffer));
+	s.push_back(CUTE(test_bounded_queues));
+	s.push_back(CUTE(test_pipeline));
+	s.push_back(CUTE(test_projection));
+	s.push_back(CUTE(test_voxel_grid));
 
 	cute::xml_file_opener xmlfile(argc, argv);
 	cute::xml_listener<cute::ide_listener<>> lis(xmlfile.out);
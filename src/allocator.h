@@ -0,0 +1,279 @@
+#ifndef GEOM_SRC_ALLOCATOR_H_
+#define GEOM_SRC_ALLOCATOR_H_
+
+//This header contains the allocation support of geom::collection:
+//the tag for uninitialized construction, the allocator adaptor used by the storages
+//and the frame arena recycling memory between frames.
+
+#include "instrument.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace fc
+{
+namespace geom
+{
+
+/// Tag selecting constructors which leave points and trivial annotations uninitialized.
+struct uninitialized_t {
+};
+constexpr uninitialized_t uninitialized { };
+
+namespace detail
+{
+
+/**
+ * \brief Allocator adaptor default initializing elements constructed without arguments.
+ *
+ * std::vector value initializes new elements, which zeroes scalars and trivial types.
+ * With this adaptor resize(n) leaves them uninitialized,
+ * value initialization is requested explicitly with resize(n, T()).
+ */
+template<class allocator_t>
+class default_init_allocator : public allocator_t {
+	using traits = std::allocator_traits<allocator_t>;
+
+public:
+	template<class U>
+	struct rebind {
+		using other = default_init_allocator<typename traits::template rebind_alloc<U>>;
+	};
+
+	default_init_allocator() = default;
+
+	/// converts from any allocator allocator_t can be constructed from.
+	template<class other_t, class = std::enable_if_t<std::is_constructible<allocator_t, const other_t&>::value>>
+	default_init_allocator(const other_t& o) noexcept :
+			allocator_t(o) {
+	}
+
+	typename traits::pointer allocate(std::size_t n) {
+		GEOM_PROBE(allocation, n, n * sizeof(typename traits::value_type));
+		return traits::allocate(static_cast<allocator_t&>(*this), n);
+	}
+
+	template<class U>
+	void construct(U* p) noexcept(std::is_nothrow_default_constructible<U>::value) {
+		::new (static_cast<void*>(p)) U;
+	}
+	template<class U, class... args_t>
+	void construct(U* p, args_t&&... args) {
+		traits::construct(static_cast<allocator_t&>(*this), p, std::forward<args_t>(args)...);
+	}
+
+	/// the adapted allocator, for allocator aware containers outside of geom.
+	const allocator_t& base() const noexcept {
+		return *this;
+	}
+
+	friend bool operator==(const default_init_allocator& l, const default_init_allocator& r) {
+		return l.base() == r.base();
+	}
+	friend bool operator!=(const default_init_allocator& l, const default_init_allocator& r) {
+		return !(l == r);
+	}
+};
+
+/// vector of @p value_t allocated by @p allocator_t rebound to value_t, see default_init_allocator.
+template<class value_t, class allocator_t>
+using storage_vector = std::vector<value_t,
+		default_init_allocator<typename std::allocator_traits<allocator_t>::template rebind_alloc<value_t>>>;
+
+/// @p size + @p count, throws std::length_error if that exceeds @p max_size.
+inline std::size_t grown_size(std::size_t size, std::size_t count, std::size_t max_size) {
+	if (count > max_size - size)
+		throw std::length_error { "geom: append exceeds max_size" };
+	return size + count;
+}
+
+} // namespace detail
+
+/**
+ * \brief Memory arena handing out buffers from large chunks, recycled as a whole.
+ *
+ * Intended for data living for a single frame: allocation is a pointer increment,
+ * deallocation is a no-op and reset() makes all memory available again
+ * without returning it to the system.
+ * After the first frames the chunks are thus already mapped and faulted in,
+ * and allocating a frame's collections neither calls malloc nor causes page faults.
+ *
+ * On Linux chunks are mapped with mmap and advised to be backed by transparent 2 MB huge pages,
+ * which reduces TLB misses when streaming over large collections.
+ *
+ * The arena is not thread safe, use one arena per thread or pipeline stage.
+ * All memory allocated from the arena has to be unused when reset() is called.
+ */
+class frame_arena {
+public:
+	/// Size of a huge page on x86_64 Linux, chunks are rounded up to multiples of it.
+	static constexpr std::size_t huge_page_size = std::size_t { 2 } << 20;
+
+	/**
+	 * \param chunk_size minimum size in bytes of the chunks allocated from the system.
+	 * \param huge_pages advise the system to back chunks with huge pages.
+	 */
+	explicit frame_arena(std::size_t chunk_size = std::size_t { 64 } << 20, bool huge_pages = true) :
+			chunk_size { round_up(std::max<std::size_t>(chunk_size, 1), huge_page_size) },
+			huge_pages { huge_pages } {
+	}
+
+	~frame_arena() {
+		for (auto&& c : chunks)
+			release(c);
+	}
+
+	frame_arena(const frame_arena&) = delete;
+	frame_arena& operator=(const frame_arena&) = delete;
+
+	/// Returns @p bytes of memory aligned to @p alignment, which has to be a power of two.
+	void* allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t)) {
+		for (; current < chunks.size(); ++current) {
+			if (auto p = take(chunks[current], bytes, alignment))
+				return p;
+		}
+		chunks.push_back(acquire(std::max(chunk_size, round_up(bytes + alignment, huge_page_size))));
+		return take(chunks.back(), bytes, alignment);
+	}
+
+	/// Memory is only reclaimed by reset().
+	void deallocate(void*, std::size_t) noexcept {
+	}
+
+	/// Makes all memory of the arena available for the next frame.
+	void reset() noexcept {
+		for (auto&& c : chunks)
+			c.used = 0;
+		current = 0;
+	}
+
+	/// Total size in bytes of the chunks owned by the arena.
+	std::size_t capacity() const noexcept {
+		std::size_t total = 0;
+		for (auto&& c : chunks)
+			total += c.size;
+		return total;
+	}
+
+private:
+	struct chunk {
+		char* data;
+		std::size_t size;
+		std::size_t used;
+	};
+
+	static std::size_t round_up(std::size_t value, std::size_t multiple) noexcept {
+		return (value + multiple - 1) / multiple * multiple;
+	}
+
+	/// bump allocates from @p c, null if @p c is exhausted
+	static void* take(chunk& c, std::size_t bytes, std::size_t alignment) noexcept {
+		const auto base = reinterpret_cast<std::uintptr_t>(c.data);
+		const auto offset = round_up(base + c.used, alignment) - base;
+		if (offset + bytes > c.size)
+			return nullptr;
+		c.used = offset + bytes;
+		return c.data + offset;
+	}
+
+	chunk acquire(std::size_t size) const {
+#ifdef __linux__
+		void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			throw std::bad_alloc { };
+#ifdef MADV_HUGEPAGE
+		if (huge_pages)
+			madvise(p, size, MADV_HUGEPAGE);
+#endif
+		return chunk { static_cast<char*>(p), size, 0 };
+#else
+		return chunk { static_cast<char*>(::operator new(size)), size, 0 };
+#endif
+	}
+
+	static void release(const chunk& c) noexcept {
+#ifdef __linux__
+		munmap(c.data, c.size);
+#else
+		::operator delete(c.data);
+#endif
+	}
+
+	std::size_t chunk_size;
+	bool huge_pages;
+	std::vector<chunk> chunks;
+	/// index of the chunk allocations are served from
+	std::size_t current = 0;
+};
+
+/**
+ * \brief Standard allocator drawing from a frame_arena.
+ *
+ * Allocations are aligned to at least EIGEN_MAX_ALIGN_BYTES,
+ * such that it can be used for every layout of geom::collection:
+ *
+ * \code
+ * frame_arena arena;
+ * collection<object<Vector3f, tag>, soa_layout, arena_allocator<object<Vector3f, tag>>> c(n, uninitialized, arena);
+ * \endcode
+ */
+template<class T>
+class arena_allocator {
+public:
+	using value_type = T;
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	/// Alignment of all allocations.
+	static constexpr std::size_t alignment = alignof(T) > 64 ? alignof(T) : 64;
+
+	arena_allocator(frame_arena& arena) noexcept :
+			arena { &arena } {
+	}
+	template<class U>
+	arena_allocator(const arena_allocator<U>& o) noexcept :
+			arena { o.arena } {
+	}
+
+	T* allocate(std::size_t n) {
+		return static_cast<T*>(arena->allocate(n * sizeof(T), alignment));
+	}
+	void deallocate(T* p, std::size_t n) noexcept {
+		arena->deallocate(p, n * sizeof(T));
+	}
+
+	template<class U>
+	bool operator==(const arena_allocator<U>& o) const noexcept {
+		return arena == o.arena;
+	}
+	template<class U>
+	bool operator!=(const arena_allocator<U>& o) const noexcept {
+		return arena != o.arena;
+	}
+
+private:
+	template<class U>
+	friend class arena_allocator;
+
+	frame_arena* arena;
+};
+
+template<class T>
+constexpr std::size_t arena_allocator<T>::alignment;
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_ALLOCATOR_H_ */
@@ -0,0 +1,438 @@
+#ifndef GEOM_SRC_ANNOTATION_STORAGE_H_
+#define GEOM_SRC_ANNOTATION_STORAGE_H_
+
+//This header contains the storage of the meta data block of geom::collection.
+//Annotations are stored as one array of meta_t by default.
+//Annotation types which declare their fields through annotation_fields
+//are stored as one array per field instead.
+
+#include "allocator.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace fc
+{
+namespace geom
+{
+
+/**
+ * \brief Describes data member @p ptr of annotation type @p class_t.
+ *
+ * Use the macro GEOM_FIELD to avoid spelling out the member type.
+ */
+template<class class_t, class member_t, member_t class_t::*ptr>
+struct field {
+	using value_type = member_t;
+
+	static member_t& get(class_t& c) noexcept {
+		return c.*ptr;
+	}
+	static const member_t& get(const class_t& c) noexcept {
+		return c.*ptr;
+	}
+};
+
+/// Declares field geom::field for data member @p member of annotation type @p type.
+#define GEOM_FIELD(type, member) ::fc::geom::field<type, decltype(type::member), &type::member>
+
+/// List of fields of an annotation type, see annotation_fields.
+template<class... fields>
+struct columns {
+	static_assert(sizeof...(fields) > 0, "columnar annotations need at least one field");
+	using type = std::tuple<fields...>;
+};
+
+/**
+ * \brief Trait declaring the fields of annotation type @p meta_t.
+ *
+ * By default annotations are stored as one array of meta_t.
+ * Specializing annotation_fields for a type as columns of all its data members
+ * makes geom::collection store every field in its own array:
+ *
+ * \code
+ * template<>
+ * struct annotation_fields<tag> : columns<GEOM_FIELD(tag, t), GEOM_FIELD(tag, x)> {};
+ * \endcode
+ *
+ * Whole annotations are assembled on demand from a default constructed meta_t,
+ * thus every data member, which is not default initialized, has to be listed.
+ */
+template<class meta_t>
+struct annotation_fields {
+};
+
+namespace detail
+{
+
+template<class meta_t, class = void>
+struct is_columnar : std::false_type {
+};
+
+template<class meta_t>
+struct is_columnar<meta_t, decltype(void(std::declval<typename annotation_fields<meta_t>::type>()))>
+		: std::true_type {
+};
+
+/// used to expand a parameter pack into a sequence of expressions in C++14
+using swallow = int[];
+
+/// moves the elements at increasing positions @p indices of @p v to the positions [out, out + count).
+template<class vector_t>
+void compact_elements(vector_t& v, const std::size_t* indices, std::size_t count, std::size_t out) {
+	for (std::size_t j = 0; j < count; ++j)
+		if (indices[j] != out + j)
+			v[out + j] = std::move(v[indices[j]]);
+}
+
+/// moves the elements at increasing positions @p indices of @p v to its front and shrinks it to @p count.
+template<class vector_t>
+void select_elements(vector_t& v, const std::size_t* indices, std::size_t count) {
+	compact_elements(v, indices, count, 0);
+	v.erase(v.begin() + count, v.end());
+}
+
+/// copies the elements at positions @p indices of @p v to the positions [out, out + count) of @p dst.
+template<class vector_t, class out_vector_t>
+void copy_elements(const vector_t& v, const std::size_t* indices, std::size_t count, out_vector_t& dst, std::size_t out) {
+	for (std::size_t j = 0; j < count; ++j)
+		dst[out + j] = v[indices[j]];
+}
+
+/// copies the elements at positions @p indices of @p v into @p out, which may use a different allocator.
+template<class vector_t, class out_vector_t>
+void gather_elements(const vector_t& v, const std::size_t* indices, std::size_t count, out_vector_t& out) {
+	out.clear();
+	out.reserve(count);
+	for (std::size_t j = 0; j < count; ++j)
+		out.push_back(v[indices[j]]);
+}
+
+} // namespace detail
+
+template<class meta_t, class allocator_t = std::allocator<meta_t>,
+		bool columnar = detail::is_columnar<meta_t>::value>
+class annotation_storage;
+
+/// Annotations stored as one contiguous array of meta_t.
+template<class meta_t, class allocator_t>
+class annotation_storage<meta_t, allocator_t, false> {
+public:
+	using value_type = meta_t;
+	using size_type = std::size_t;
+	using allocator_type = allocator_t;
+	using reference = meta_t&;
+	using const_reference = const meta_t&;
+
+	annotation_storage() = default;
+	explicit annotation_storage(const allocator_type& alloc) :
+			meta_data(alloc) {
+	}
+	/// Creates @p size value initialized annotations.
+	explicit annotation_storage(size_type size, const allocator_type& alloc = allocator_type()) :
+			meta_data(size, meta_t(), alloc) {
+	}
+	/// Creates @p size default initialized annotations, trivial types are left uninitialized.
+	annotation_storage(size_type size, uninitialized_t, const allocator_type& alloc = allocator_type()) :
+			meta_data(size, alloc) {
+	}
+
+	size_type size() const noexcept {
+		return meta_data.size();
+	}
+	bool empty() const noexcept {
+		return meta_data.empty();
+	}
+	void resize(size_type size) {
+		meta_data.resize(size, meta_t());
+	}
+	void resize(size_type size, uninitialized_t) {
+		meta_data.resize(size);
+	}
+	void reserve(size_type capacity) {
+		meta_data.reserve(capacity);
+	}
+
+	size_type max_size() const noexcept {
+		return meta_data.max_size();
+	}
+
+	/**
+	 * \brief Appends the @p count annotations at @p values, which must not point into this storage.
+	 * \throws std::length_error if the result would exceed max_size().
+	 */
+	void append(const meta_t* values, size_type count) {
+		const auto first = size();
+		resize(detail::grown_size(first, count, max_size()), uninitialized);
+		std::copy_n(values, count, meta_data.data() + first);
+	}
+	/// Appends all annotations of @p o, which may be this storage.
+	void append(const annotation_storage& o) {
+		const auto count = o.size();
+		const auto first = size();
+		resize(detail::grown_size(first, count, max_size()), uninitialized);
+		std::copy_n(o.meta_data.data(), count, meta_data.data() + first);
+	}
+
+	reference operator[](size_type i) {
+		return meta_data[i];
+	}
+	const_reference operator[](size_type i) const {
+		return meta_data[i];
+	}
+
+	const_reference load(size_type i) const {
+		return meta_data[i];
+	}
+
+	/// Contiguous array of all annotations.
+	const meta_t* data() const noexcept {
+		return meta_data.data();
+	}
+	meta_t* data() noexcept {
+		return meta_data.data();
+	}
+	void store(size_type i, const meta_t& value) {
+		meta_data[i] = value;
+	}
+	void store(size_type i, meta_t&& value) {
+		meta_data[i] = std::move(value);
+	}
+
+	void swap_elements(size_type i, size_type j) {
+		using std::swap;
+		swap(meta_data[i], meta_data[j]);
+	}
+
+	/// Keeps only the @p count annotations at the increasing positions @p indices, in that order.
+	void select(const size_type* indices, size_type count) {
+		detail::select_elements(meta_data, indices, count);
+	}
+
+	/// Moves the annotations at the increasing positions @p indices to [out, out + count), indices[j] >= out + j.
+	void compact(const size_type* indices, size_type count, size_type out) {
+		detail::compact_elements(meta_data, indices, count, out);
+	}
+
+	/// Writes copies of the @p count annotations of @p src at positions @p indices to the positions [out, out + count).
+	template<class src_allocator_t>
+	void copy_selected(const annotation_storage<meta_t, src_allocator_t, false>& src, const size_type* indices,
+			size_type count, size_type out) {
+		detail::copy_elements(src.meta_data, indices, count, meta_data, out);
+	}
+
+	/// Copies the @p count annotations at positions @p indices into @p out, which may use another allocator.
+	template<class out_allocator_t>
+	void gather(const size_type* indices, size_type count, annotation_storage<meta_t, out_allocator_t, false>& out) const {
+		detail::gather_elements(meta_data, indices, count, out.meta_data);
+	}
+
+private:
+	template<class, class, bool>
+	friend class annotation_storage;
+
+	detail::storage_vector<meta_t, allocator_t> meta_data;
+};
+
+/**
+ * \brief Annotations stored as one contiguous array per field.
+ *
+ * Whole annotations are assembled on load and decomposed on store.
+ * Single fields are accessed through column().
+ */
+template<class meta_t, class allocator_t>
+class annotation_storage<meta_t, allocator_t, true> {
+	using fields = typename annotation_fields<meta_t>::type;
+	static constexpr std::size_t field_count = std::tuple_size<fields>::value;
+	using indices = std::make_index_sequence<field_count>;
+
+	template<std::size_t I>
+	using field_type = typename std::tuple_element<I, fields>::type::value_type;
+
+	template<std::size_t... I>
+	static auto make_columns(std::index_sequence<I...>)
+	-> std::tuple<detail::storage_vector<field_type<I>, allocator_t>...>;
+
+	using columns_t = decltype(make_columns(indices { }));
+
+public:
+	using value_type = meta_t;
+	using size_type = std::size_t;
+	using allocator_type = allocator_t;
+
+	/// Type of the array storing field @p I.
+	template<std::size_t I>
+	using column_type = typename std::tuple_element<I, columns_t>::type;
+
+	annotation_storage() = default;
+	explicit annotation_storage(const allocator_type& alloc) :
+			data { allocate_columns(alloc, indices { }) } {
+	}
+	/// Creates @p size annotations with value initialized fields.
+	explicit annotation_storage(size_type size, const allocator_type& alloc = allocator_type()) :
+			data { allocate_columns(alloc, indices { }) } {
+		resize(size);
+	}
+	/// Creates @p size annotations with default initialized fields, trivial fields are left uninitialized.
+	annotation_storage(size_type size, uninitialized_t, const allocator_type& alloc = allocator_type()) :
+			data { allocate_columns(alloc, indices { }) } {
+		resize(size, uninitialized);
+	}
+
+	size_type size() const noexcept {
+		return std::get<0>(data).size();
+	}
+	bool empty() const noexcept {
+		return std::get<0>(data).empty();
+	}
+	void resize(size_type size) {
+		resize_impl(size, indices { });
+	}
+	void resize(size_type size, uninitialized_t) {
+		resize_impl(size, uninitialized, indices { });
+	}
+	void reserve(size_type capacity) {
+		reserve_impl(capacity, indices { });
+	}
+
+	size_type max_size() const noexcept {
+		return std::get<0>(data).max_size();
+	}
+
+	/**
+	 * \brief Appends the @p count annotations at @p values, which are decomposed into the columns.
+	 * \throws std::length_error if the result would exceed max_size().
+	 */
+	void append(const meta_t* values, size_type count) {
+		const auto first = size();
+		resize(detail::grown_size(first, count, max_size()), uninitialized);
+		for (size_type j = 0; j < count; ++j)
+			store(first + j, values[j]);
+	}
+	/// Appends all annotations of @p o column by column, @p o may be this storage.
+	void append(const annotation_storage& o) {
+		const auto count = o.size();
+		const auto first = size();
+		resize(detail::grown_size(first, count, max_size()), uninitialized);
+		append_impl(o, first, count, indices { });
+	}
+
+	/// Contiguous array of field @p I, in the order of the fields in annotation_fields.
+	template<std::size_t I>
+	column_type<I>& column() noexcept {
+		return std::get<I>(data);
+	}
+	template<std::size_t I>
+	const column_type<I>& column() const noexcept {
+		return std::get<I>(data);
+	}
+
+	meta_t load(size_type i) const {
+		meta_t value { };
+		load_impl(i, value, indices { });
+		return value;
+	}
+	void store(size_type i, const meta_t& value) {
+		store_impl(i, value, indices { });
+	}
+
+	void swap_elements(size_type i, size_type j) {
+		swap_impl(i, j, indices { });
+	}
+
+	/// Keeps only the @p count annotations at the increasing positions @p positions, in that order.
+	void select(const size_type* positions, size_type count) {
+		select_impl(positions, count, indices { });
+	}
+
+	/// Moves the annotations at the increasing @p positions to [out, out + count), positions[j] >= out + j.
+	void compact(const size_type* positions, size_type count, size_type out) {
+		compact_impl(positions, count, out, indices { });
+	}
+
+	/// Writes copies of the @p count annotations of @p src at @p positions to the positions [out, out + count).
+	template<class src_allocator_t>
+	void copy_selected(const annotation_storage<meta_t, src_allocator_t, true>& src, const size_type* positions,
+			size_type count, size_type out) {
+		copy_selected_impl(src, positions, count, out, indices { });
+	}
+
+	/// Copies the @p count annotations at @p positions into @p out, which may use another allocator.
+	template<class out_allocator_t>
+	void gather(const size_type* positions, size_type count, annotation_storage<meta_t, out_allocator_t, true>& out) const {
+		gather_impl(positions, count, out, indices { });
+	}
+
+private:
+	template<class, class, bool>
+	friend class annotation_storage;
+
+	template<std::size_t... I>
+	static columns_t allocate_columns(const allocator_type& alloc, std::index_sequence<I...>) {
+		return columns_t { column_type<I>(alloc)... };
+	}
+	template<std::size_t... I>
+	void resize_impl(size_type size, std::index_sequence<I...>) {
+		(void) detail::swallow { 0, (std::get<I>(data).resize(size, field_type<I>()), 0)... };
+	}
+	template<std::size_t... I>
+	void resize_impl(size_type size, uninitialized_t, std::index_sequence<I...>) {
+		(void) detail::swallow { 0, (std::get<I>(data).resize(size), 0)... };
+	}
+	template<std::size_t... I>
+	void reserve_impl(size_type capacity, std::index_sequence<I...>) {
+		(void) detail::swallow { 0, (std::get<I>(data).reserve(capacity), 0)... };
+	}
+	template<std::size_t... I>
+	void append_impl(const annotation_storage& o, size_type first, size_type count, std::index_sequence<I...>) {
+		(void) detail::swallow { 0, (std::copy_n(std::get<I>(o.data).begin(), count,
+				std::get<I>(data).begin() + first), 0)... };
+	}
+	template<std::size_t... I>
+	void load_impl(size_type i, meta_t& value, std::index_sequence<I...>) const {
+		(void) detail::swallow { 0, (std::tuple_element<I, fields>::type::get(value) =
+				std::get<I>(data)[i], 0)... };
+	}
+	template<std::size_t... I>
+	void store_impl(size_type i, const meta_t& value, std::index_sequence<I...>) {
+		(void) detail::swallow { 0, (std::get<I>(data)[i] =
+				std::tuple_element<I, fields>::type::get(value), 0)... };
+	}
+	template<std::size_t... I>
+	void swap_impl(size_type i, size_type j, std::index_sequence<I...>) {
+		using std::swap;
+		(void) detail::swallow { 0, (swap(std::get<I>(data)[i], std::get<I>(data)[j]), 0)... };
+	}
+	template<std::size_t... I>
+	void select_impl(const size_type* positions, size_type count, std::index_sequence<I...>) {
+		(void) detail::swallow { 0, (detail::select_elements(std::get<I>(data), positions, count), 0)... };
+	}
+	template<std::size_t... I>
+	void compact_impl(const size_type* positions, size_type count, size_type out, std::index_sequence<I...>) {
+		(void) detail::swallow { 0, (detail::compact_elements(std::get<I>(data), positions, count, out), 0)... };
+	}
+	template<class src_t, std::size_t... I>
+	void copy_selected_impl(const src_t& src, const size_type* positions, size_type count, size_type out,
+			std::index_sequence<I...>) {
+		(void) detail::swallow { 0, (detail::copy_elements(std::get<I>(src.data), positions, count,
+				std::get<I>(data), out), 0)... };
+	}
+	template<class out_t, std::size_t... I>
+	void gather_impl(const size_type* positions, size_type count, out_t& out, std::index_sequence<I...>) const {
+		(void) detail::swallow { 0, (detail::gather_elements(std::get<I>(data), positions, count,
+				std::get<I>(out.data)), 0)... };
+	}
+
+	columns_t data;
+};
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_ANNOTATION_STORAGE_H_ */
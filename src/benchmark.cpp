@@ -1,9 +1,23 @@
 #include <benchmark/benchmark.h>
 
+#include "chunk_stream.h"
 #include "collection.h"
+#include "collection_view.h"
+#include "culling.h"
+#include "mapped_collection.h"
+#include "multi_pose.h"
+#include "pipeline.h"
+#include "projection.h"
+#include "voxel_grid.h"
+#include "transform.hpp"
 
 #include <random>
 #include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <unordered_map>
 
 #define __assume(cond) do { if (!(cond)) __builtin_unreachable(); } while (0)
 
@@ -25,8 +39,7 @@ using tagged_vec3f = geom::object<Eigen::Vector3f,tag>;
 
 static void Vector3d(benchmark::State& state) {
 
-	std::random_device rd{};
-	std::mt19937 gen(rd());
+	std::mt19937 gen(42);
 
 	std::uniform_real_distribution<> d(0, 10000);
 	std::vector<Eigen::Vector3d> a(state.range(0));
@@ -51,8 +64,7 @@ static void Vector3d(benchmark::State& state) {
 
 static void Vector4d(benchmark::State& state) {
 
-	std::random_device rd{};
-	std::mt19937 gen(rd());
+	std::mt19937 gen(42);
 
 	std::uniform_real_distribution<> d(0, 10000);
 	std::vector<Eigen::Vector4d> a(state.range(0));
@@ -77,8 +89,7 @@ static void Vector4d(benchmark::State& state) {
 
 static void Tagged3d(benchmark::State& state) {
 
-	std::random_device rd{};
-	std::mt19937 gen(rd());
+	std::mt19937 gen(42);
 
 	std::uniform_real_distribution<> d(0, 10000);
 	std::vector<tagged_vec3d> a(state.range(0));
@@ -103,8 +114,7 @@ static void Tagged3d(benchmark::State& state) {
 
 static void Tagged3f(benchmark::State& state) {
 
-	std::random_device rd{};
-	std::mt19937 gen(rd());
+	std::mt19937 gen(42);
 
 	std::uniform_real_distribution<float> d(0, 10000);
 	std::vector<tagged_vec3f> a(state.range(0));
@@ -130,8 +140,7 @@ static void Tagged3f(benchmark::State& state) {
 
 static void Vector3f(benchmark::State& state) {
 
-	std::random_device rd{};
-	std::mt19937 gen(rd());
+	std::mt19937 gen(42);
 
 	std::uniform_real_distribution<float> d(0, 10000);
 	std::vector<Eigen::Vector3f> a(state.range(0));
@@ -158,8 +167,7 @@ static constexpr auto storage_order = Eigen::RowMajor;
 
 //static void Matrix3d(benchmark::State& state) {
 //
-//	std::random_device rd{};
-//	std::mt19937 gen(rd());
+//	std::mt19937 gen(42);
 //
 //	std::uniform_real_distribution<> d(0, 10000);
 //	Eigen::Matrix<double, 3, Eigen::Dynamic, storage_order> a
@@ -181,8 +189,7 @@ static constexpr auto storage_order = Eigen::RowMajor;
 //
 //static void Matrix3f(benchmark::State& state) {
 //
-//	std::random_device rd{};
-//	std::mt19937 gen(rd());
+//	std::mt19937 gen(42);
 //
 //	std::uniform_real_distribution<float> d(0, 10000);
 //	Eigen::Matrix<float, 3, Eigen::Dynamic, storage_order> a
@@ -204,8 +211,7 @@ static constexpr auto storage_order = Eigen::RowMajor;
 
 static void geom3dint(benchmark::State& state) {
 
-	std::random_device rd{};
-	std::mt19937 gen(rd());
+	std::mt19937 gen(42);
 
 	std::uniform_real_distribution<> d(0, 10000);
 	geom::collection<tagged_vec3d> a(state.range(0));
@@ -229,8 +235,7 @@ static void geom3dint(benchmark::State& state) {
 
 static void geom3fint(benchmark::State& state) {
 
-	std::random_device rd{};
-	std::mt19937 gen(rd());
+	std::mt19937 gen(42);
 
 	std::uniform_real_distribution<float> d(0, 10000);
 	geom::collection<tagged_vec3f> a(state.range(0));
@@ -252,11 +257,826 @@ static void geom3fint(benchmark::State& state) {
 	}
 }
 
+static void geom3dbulk(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d> a(state.range(0));
+
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	Eigen::Affine3d m{};
+	m = Eigen::AngleAxisd(0.9, Eigen::Vector3d::UnitZ())
+	  * Eigen::AngleAxisd(1.234, Eigen::Vector3d::UnitY())
+	  * Eigen::AngleAxisd(-43, Eigen::Vector3d::UnitZ())
+	  * Eigen::Translation3d(1.,1.,2.);
+
+	while (state.KeepRunning()) {
+
+		a.transform(m);
+		benchmark::DoNotOptimize(a);
+	}
+}
+
+static void geom3fbulk(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+
+	std::uniform_real_distribution<float> d(0, 10000);
+	geom::collection<tagged_vec3f> a(state.range(0));
+
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3f{Eigen::Vector3f{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	Eigen::Affine3f m{};
+	m = Eigen::AngleAxisf(0.9, Eigen::Vector3f::UnitZ())
+	  * Eigen::AngleAxisf(1.234, Eigen::Vector3f::UnitY())
+	  * Eigen::AngleAxisf(-43, Eigen::Vector3f::UnitZ())
+	  * Eigen::Translation3f(1.,1.,2.);
+
+	while (state.KeepRunning()) {
+
+		a.transform(m);
+		benchmark::DoNotOptimize(a);
+	}
+}
+
+static void geom3dsoa(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d, geom::soa_layout> a(state.range(0));
+
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	Eigen::Affine3d m{};
+	m = Eigen::AngleAxisd(0.9, Eigen::Vector3d::UnitZ())
+	  * Eigen::AngleAxisd(1.234, Eigen::Vector3d::UnitY())
+	  * Eigen::AngleAxisd(-43, Eigen::Vector3d::UnitZ())
+	  * Eigen::Translation3d(1.,1.,2.);
+
+	while (state.KeepRunning()) {
+
+		a.transform(m);
+		benchmark::DoNotOptimize(a);
+	}
+}
+
+static void geom3fsoa(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+
+	std::uniform_real_distribution<float> d(0, 10000);
+	geom::collection<tagged_vec3f, geom::soa_layout> a(state.range(0));
+
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3f{Eigen::Vector3f{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	Eigen::Affine3f m{};
+	m = Eigen::AngleAxisf(0.9, Eigen::Vector3f::UnitZ())
+	  * Eigen::AngleAxisf(1.234, Eigen::Vector3f::UnitY())
+	  * Eigen::AngleAxisf(-43, Eigen::Vector3f::UnitZ())
+	  * Eigen::Translation3f(1.,1.,2.);
+
+	while (state.KeepRunning()) {
+
+		a.transform(m);
+		benchmark::DoNotOptimize(a);
+	}
+}
+
+static void geom3dpadded(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d, geom::padded_layout> a(state.range(0));
+
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	Eigen::Affine3d m{};
+	m = Eigen::AngleAxisd(0.9, Eigen::Vector3d::UnitZ())
+	  * Eigen::AngleAxisd(1.234, Eigen::Vector3d::UnitY())
+	  * Eigen::AngleAxisd(-43, Eigen::Vector3d::UnitZ())
+	  * Eigen::Translation3d(1.,1.,2.);
+
+	while (state.KeepRunning()) {
+
+		a.transform(m);
+		benchmark::DoNotOptimize(a);
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0) * 4 * sizeof(double));
+}
+
+static void geom3fpadded(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+
+	std::uniform_real_distribution<float> d(0, 10000);
+	geom::collection<tagged_vec3f, geom::padded_layout> a(state.range(0));
+
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3f{Eigen::Vector3f{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	Eigen::Affine3f m{};
+	m = Eigen::AngleAxisf(0.9, Eigen::Vector3f::UnitZ())
+	  * Eigen::AngleAxisf(1.234, Eigen::Vector3f::UnitY())
+	  * Eigen::AngleAxisf(-43, Eigen::Vector3f::UnitZ())
+	  * Eigen::Translation3f(1.,1.,2.);
+
+	while (state.KeepRunning()) {
+
+		a.transform(m);
+		benchmark::DoNotOptimize(a);
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0) * 4 * sizeof(float));
+}
+
+static void geom3dtranslation(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d> a(state.range(0));
+
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	const geom::translation<double, 3> m { Eigen::Vector3d{1.,1.,2.} };
+
+	while (state.KeepRunning()) {
+
+		a.transform(m);
+		benchmark::DoNotOptimize(a);
+	}
+}
+
+static void geom3drigid(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d> a(state.range(0));
+
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	const auto m = geom::as_transform_kind(Eigen::AngleAxisd(0.9, Eigen::Vector3d::UnitZ()))
+	  * geom::translation<double, 3>{ Eigen::Vector3d{1.,1.,2.} };
+
+	while (state.KeepRunning()) {
+
+		a.transform(m);
+		benchmark::DoNotOptimize(a);
+	}
+}
+
+static void geom3dstatistics(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d> a(state.range(0));
+
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	while (state.KeepRunning()) {
+		benchmark::DoNotOptimize(a.statistics());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void geom3dcrop(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d> a(state.range(0));
+
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	//keeps about a quarter of the points, as when cropping a frame to a region of interest
+	while (state.KeepRunning()) {
+		benchmark::DoNotOptimize(a.filter(geom::by_point([](const auto& p) { return p.x() < 2500; })));
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void geom3dreorder(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d> a(state.range(0));
+
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	while (state.KeepRunning()) {
+		benchmark::DoNotOptimize(a.reorder_spatially(geom::parallel));
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/// per frame cost of allocating a soa collection and filling its points, as from a sensor driver
+static void geom3fframe(benchmark::State& state) {
+
+	while (state.KeepRunning()) {
+		geom::collection<tagged_vec3f, geom::soa_layout> a(state.range(0));
+		std::fill_n(a.points().row(0), state.range(0), 1.f);
+		benchmark::DoNotOptimize(a.points().row(0));
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void geom3fframearena(benchmark::State& state) {
+
+	geom::frame_arena arena;
+	using allocator = geom::arena_allocator<tagged_vec3f>;
+	while (state.KeepRunning()) {
+		{
+			geom::collection<tagged_vec3f, geom::soa_layout, allocator> a(state.range(0), geom::uninitialized, arena);
+			std::fill_n(a.points().row(0), state.range(0), 1.f);
+			benchmark::DoNotOptimize(a.points().row(0));
+		}
+		arena.reset();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/// writes a seeded collection of @p size points to a file for the replay benchmarks
+static std::string replay_file(std::size_t size) {
+	const std::string path = "geom_benchmark_replay.bin";
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d> a(size);
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+	geom::write_collection(a, path);
+	return path;
+}
+
+/// replay of a recorded frame through the mapped file, the points are reduced in place
+static void geom3dreplaymapped(benchmark::State& state) {
+
+	const auto path = replay_file(state.range(0));
+	while (state.KeepRunning()) {
+		geom::mapped_collection<tagged_vec3d> m { path };
+		benchmark::DoNotOptimize(m.points().block(0, m.size()).rowwise().maxCoeff().eval());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	std::remove(path.c_str());
+}
+
+/// replay of a recorded frame by copying it into a collection element by element
+static void geom3dreplaycopy(benchmark::State& state) {
+
+	const auto path = replay_file(state.range(0));
+	while (state.KeepRunning()) {
+		geom::mapped_collection<tagged_vec3d> m { path };
+		geom::collection<tagged_vec3d> a(m.begin(), m.end());
+		benchmark::DoNotOptimize(a.points().block(0, a.size()).rowwise().maxCoeff().eval());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	std::remove(path.c_str());
+}
+
+/// transform of points quantized to int16 with unit steps, compare with geom3dsoa
+static void geom3dquantized(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d, geom::quantized_layout<std::int16_t>> a(state.range(0));
+	a.points().requantize(geom::quantization<double, 3> { 1.0 });
+
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	Eigen::Affine3d m{};
+	m = Eigen::AngleAxisd(0.9, Eigen::Vector3d::UnitZ())
+	  * Eigen::AngleAxisd(1.234, Eigen::Vector3d::UnitY())
+	  * Eigen::AngleAxisd(-43, Eigen::Vector3d::UnitZ())
+	  * Eigen::Translation3d(1.,1.,2.);
+
+	while (state.KeepRunning()) {
+
+		a.transform(m);
+		benchmark::DoNotOptimize(a);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/// statistics of points quantized to int16, compare with geom3dstatistics
+static void geom3dquantizedstatistics(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d, geom::quantized_layout<std::int16_t>> a(state.range(0));
+	a.points().requantize(geom::quantization<double, 3> { 1.0 });
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(a.statistics());
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/// sensor packets of a frame, points and annotations as separate arrays
+struct packet {
+	std::vector<Eigen::Vector3d> points;
+	std::vector<tag> meta;
+};
+
+static std::vector<packet> make_packets(std::size_t size, std::size_t count) {
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	std::vector<packet> packets(count);
+	for (std::size_t i = 0; i < size; ++i) {
+		auto& p = packets[i % count];
+		p.points.emplace_back(d(gen), d(gen), d(gen));
+		p.meta.push_back(tag { long(i) });
+	}
+	return packets;
+}
+
+/// merges 64 packets into a frame by appending them block by block
+static void geom3dappend(benchmark::State& state) {
+
+	const auto packets = make_packets(state.range(0), 64);
+	while (state.KeepRunning()) {
+		geom::collection<tagged_vec3d> frame;
+		frame.reserve(state.range(0));
+		for (auto&& p : packets)
+			frame.append(p.points.data(), p.meta.data(), p.points.size());
+		benchmark::DoNotOptimize(frame.points().data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/// merges 64 packets into a frame through a temporary vector of objects, the reference for geom3dappend
+static void geom3dappendobjects(benchmark::State& state) {
+
+	const auto packets = make_packets(state.range(0), 64);
+	while (state.KeepRunning()) {
+		std::vector<tagged_vec3d> objects;
+		objects.reserve(state.range(0));
+		for (auto&& p : packets)
+			for (std::size_t i = 0; i < p.points.size(); ++i)
+				objects.emplace_back(p.points[i], p.meta[i]);
+		geom::collection<tagged_vec3d> frame(objects.begin(), objects.end());
+		benchmark::DoNotOptimize(frame.points().data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/// statistics of the points in the lower half of the cube through a view
+static void geom3dviewstatistics(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d> a(state.range(0));
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	while (state.KeepRunning()) {
+		const auto lower = geom::view(a).filter(geom::by_point([](const Eigen::Vector3d& p) { return p.z() < 5000; }));
+		benchmark::DoNotOptimize(lower.statistics());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/// statistics of the points in the lower half of the cube through a filtered copy, compare with geom3dviewstatistics
+static void geom3dfilterstatistics(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d> a(state.range(0));
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	while (state.KeepRunning()) {
+		const auto lower = a.filter(geom::by_point([](const Eigen::Vector3d& p) { return p.z() < 5000; }));
+		benchmark::DoNotOptimize(lower.statistics());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static const Eigen::Affine3d stream_transform { Eigen::AngleAxisd(0.9, Eigen::Vector3d::UnitZ())
+		* Eigen::Translation3d(1., 1., 2.) };
+
+/// transformed copy of a collection by copying it and transforming the copy in place, as before transform_into
+static void geom3dcopytransform(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d, geom::soa_layout> a(state.range(0));
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+	const Eigen::Affine3d m { Eigen::AngleAxisd(0.9, Eigen::Vector3d::UnitZ()) * Eigen::Translation3d(1., 1., 2.) };
+	auto b = a;
+
+	while (state.KeepRunning()) {
+		b = a;
+		b.transform(m);
+		benchmark::DoNotOptimize(b);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+/// transformed copy of a collection with transform_into, reusing the destination
+static void geom3dtransforminto(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d, geom::soa_layout> a(state.range(0));
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+	const Eigen::Affine3d m { Eigen::AngleAxisd(0.9, Eigen::Vector3d::UnitZ()) * Eigen::Translation3d(1., 1., 2.) };
+	geom::transformed_collection<decltype(a)> b(a.size(), geom::uninitialized);
+
+	while (state.KeepRunning()) {
+		geom::transform_into(a, m, b);
+		benchmark::DoNotOptimize(b);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+using pipeline_cloud = geom::collection<tagged_vec3d, geom::soa_layout>;
+/// chunks of random points for the pipeline benchmarks
+static std::vector<pipeline_cloud> pipeline_chunks(std::size_t points) {
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	std::vector<pipeline_cloud> chunks;
+	for (int c = 0; c < 16; ++c) {
+		pipeline_cloud a(points);
+		std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{c}}; });
+		chunks.push_back(std::move(a));
+	}
+	return chunks;
+}
+/// transform, crop and sort stages applied to every chunk, first stage of one chunk after the last of the previous
+static void geom3dpipelineserial(benchmark::State& state) {
+
+	const auto chunks = pipeline_chunks(state.range(0));
+	auto move = geom::transform(Eigen::Affine3d(Eigen::AngleAxisd(0.9, Eigen::Vector3d::UnitZ())));
+	const Eigen::AlignedBox3d crop { Eigen::Vector3d::Constant(-5000), Eigen::Vector3d::Constant(5000) };
+
+	while (state.KeepRunning()) {
+		for (auto c : chunks) {
+			c = move(std::move(c));
+			c.erase_if(geom::by_point([&crop](const Eigen::Vector3d& p) { return !crop.contains(p); }));
+			c.reorder_spatially(geom::sequential);
+			benchmark::DoNotOptimize(c);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0) * chunks.size());
+}
+/// the stages of geom3dpipelineserial in a pipeline, one worker per stage
+static void geom3dpipeline(benchmark::State& state) {
+
+	const auto chunks = pipeline_chunks(state.range(0));
+	const Eigen::AlignedBox3d crop { Eigen::Vector3d::Constant(-5000), Eigen::Vector3d::Constant(5000) };
+
+	while (state.KeepRunning()) {
+		geom::pipeline<pipeline_cloud> p { 4 };
+		p.then(geom::transform(Eigen::Affine3d(Eigen::AngleAxisd(0.9, Eigen::Vector3d::UnitZ()))))
+		 .then([&crop](pipeline_cloud c) {
+			c.erase_if(geom::by_point([&crop](const Eigen::Vector3d& p) { return !crop.contains(p); }));
+			return c;
+		 })
+		 .then([](pipeline_cloud c) { c.reorder_spatially(geom::sequential); return c; });
+		p.start();
+		std::thread producer { [&p, &chunks] {
+			for (const auto& c : chunks)
+				p.push(c);
+			p.close();
+		} };
+		pipeline_cloud out;
+		while (p.pop(out))
+			benchmark::DoNotOptimize(out);
+		producer.join();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0) * chunks.size());
+}
+/// camera at the origin looking along +z at points spread over a cube in front and behind it
+static geom::collection<tagged_vec3f, geom::soa_layout> projection_cloud(std::size_t points) {
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<float> d(-100, 100);
+	geom::collection<tagged_vec3f, geom::soa_layout> a(points);
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3f{Eigen::Vector3f{d(gen),d(gen),d(gen)},tag{0}}; });
+	return a;
+}
+static geom::pinhole_camera<float> projection_camera() {
+	return geom::pinhole_camera<float>::from_focal(800, 800, 640, 360, Eigen::Affine3f::Identity(), 1280, 720, 0.1f);
+}
+/// projection with one Eigen product and divide per point, visible objects appended to the 2D collection
+static void geom3fprojectloop(benchmark::State& state) {
+
+	const auto a = projection_cloud(state.range(0));
+	const auto camera = projection_camera();
+	const Eigen::Matrix<float, 3, 4> p = camera.projection();
+
+	while (state.KeepRunning()) {
+		geom::collection<geom::object<Eigen::Vector2f, tag>> pixels;
+		for (std::size_t i = 0; i < a.size(); ++i) {
+			const Eigen::Vector3f h = p * a.points()[i].homogeneous();
+			const Eigen::Vector2f pixel = h.head<2>() / h.z();
+			if (h.z() > camera.near() && pixel.x() >= 0 && pixel.x() < camera.width()
+					&& pixel.y() >= 0 && pixel.y() < camera.height())
+				pixels.emplace_back(pixel, a.meta()[i]);
+		}
+		benchmark::DoNotOptimize(pixels);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+/// projection with project
+static void geom3fproject(benchmark::State& state) {
+
+	const auto a = projection_cloud(state.range(0));
+	const auto camera = projection_camera();
+
+	while (state.KeepRunning()) {
+		auto pixels = geom::project(a, camera, geom::sequential);
+		benchmark::DoNotOptimize(pixels);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+/// edge length of the voxels of the voxel benchmarks, 40k voxels in voxel_cloud
+static constexpr double voxel_edge = 0.5;
+/// cloud of a 50 m square, 2 m high, in random order, the worst case for finding the voxel of a point
+static geom::collection<tagged_vec3d, geom::soa_layout> voxel_cloud(std::size_t points) {
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 50);
+	std::uniform_real_distribution<> h(0, 2);
+	geom::collection<tagged_vec3d, geom::soa_layout> a(points);
+	int t = 0;
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),h(gen)},tag{t++}}; });
+	return a;
+}
+/// voxel downsampling with an unordered_map from voxel index to sum of points and latest tag
+static void geom3dvoxelmap(benchmark::State& state) {
+
+	const auto a = voxel_cloud(state.range(0));
+	struct voxel {
+		Eigen::Vector3d sum;
+		std::size_t count;
+		tag latest;
+	};
+
+	while (state.KeepRunning()) {
+		std::unordered_map<std::uint64_t, voxel> voxels;
+		for (std::size_t i = 0; i < a.size(); ++i) {
+			const Eigen::Vector3d p = a.points()[i];
+			const std::uint64_t key = std::uint64_t(p.x() / voxel_edge) | std::uint64_t(p.y() / voxel_edge) << 21
+					| std::uint64_t(p.z() / voxel_edge) << 42;
+			auto& v = voxels.emplace(key, voxel { Eigen::Vector3d::Zero(), 0, tag { } }).first->second;
+			v.sum += p;
+			++v.count;
+			v.latest = std::max(v.latest.t, a.meta()[i].t) == v.latest.t ? v.latest : a.meta()[i];
+		}
+		geom::collection<tagged_vec3d, geom::soa_layout> out;
+		out.reserve(voxels.size());
+		for (const auto& v : voxels)
+			out.emplace_back(v.second.sum / double(v.second.count), v.second.latest);
+		benchmark::DoNotOptimize(out);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+/// voxel downsampling with voxel_downsample
+static void geom3dvoxelgrid(benchmark::State& state) {
+
+	const auto a = voxel_cloud(state.range(0));
+
+	while (state.KeepRunning()) {
+		auto out = geom::voxel_downsample(a, voxel_edge, geom::keep_max(&tag::t), geom::parallel);
+		benchmark::DoNotOptimize(out);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+/// voxel downsampling with voxel_downsample of voxel_cloud sorted into scan lines along x, as measured by a line scanner
+static void geom3dvoxelgridscan(benchmark::State& state) {
+
+	auto a = voxel_cloud(state.range(0));
+	const auto lines = std::max<std::size_t>(1, a.size() / 5000);
+	std::vector<std::size_t> order(a.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](std::size_t i, std::size_t j) {
+		const auto line_i = std::size_t(a.points()[i].y() / 50 * lines), line_j = std::size_t(a.points()[j].y() / 50 * lines);
+		return line_i < line_j || (line_i == line_j && a.points()[i].x() < a.points()[j].x());
+	});
+	geom::collection<tagged_vec3d, geom::soa_layout> scan(a.size());
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		scan.points()[i] = a.points()[order[i]];
+		scan.meta()[i] = tag{int(i)};
+	}
+
+	while (state.KeepRunning()) {
+		auto out = geom::voxel_downsample(scan, voxel_edge, geom::keep_max(&tag::t), geom::parallel);
+		benchmark::DoNotOptimize(out);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+/// streams a file through transform in chunks of 64k objects, the next chunk is read while transforming
+static void geom3dstreamchunked(benchmark::State& state) {
+
+	const auto path = replay_file(state.range(0));
+	geom::chunk_reader<tagged_vec3d> reader { path };
+	while (state.KeepRunning()) {
+		geom::for_each_chunk(reader, 1 << 16, [](auto& chunk) {
+			chunk.transform(stream_transform);
+			benchmark::DoNotOptimize(chunk.points().data());
+		});
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	std::remove(path.c_str());
+}
+
+/// reads the whole file into memory and transforms it, the reference for geom3dstreamchunked
+static void geom3dstreammemory(benchmark::State& state) {
+
+	const auto path = replay_file(state.range(0));
+	geom::chunk_reader<tagged_vec3d> reader { path };
+	while (state.KeepRunning()) {
+		geom::collection<tagged_vec3d> a;
+		reader.read(0, reader.size(), a);
+		a.transform(stream_transform);
+		benchmark::DoNotOptimize(a.points().data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	std::remove(path.c_str());
+}
+
+static void geom3dparallel(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d> a(state.range(0));
+
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+
+	Eigen::Affine3d m{};
+	m = Eigen::AngleAxisd(0.9, Eigen::Vector3d::UnitZ())
+	  * Eigen::AngleAxisd(1.234, Eigen::Vector3d::UnitY())
+	  * Eigen::AngleAxisd(-43, Eigen::Vector3d::UnitZ())
+	  * Eigen::Translation3d(1.,1.,2.);
+
+	while (state.KeepRunning()) {
+
+		a.transform(m, geom::parallel);
+		benchmark::DoNotOptimize(a);
+	}
+}
+
 static constexpr int benchmark_size = 8<<12;
 
 
+/// frusta of four cameras in the center of the cube [0, 10000]^3 looking along +-x and +-y, near 1, far 5000
+static std::vector<geom::convex_volume<double, 3>> camera_frusta() {
+	Eigen::Matrix4d projection = Eigen::Matrix4d::Zero();
+	projection(0, 0) = projection(1, 1) = 1;
+	projection(2, 2) = -5001. / 4999.;
+	projection(2, 3) = -10000. / 4999.;
+	projection(3, 2) = -1;
+	std::vector<geom::convex_volume<double, 3>> frusta;
+	for (int k = 0; k < 4; ++k) {
+		const Eigen::Affine3d camera = Eigen::Translation3d(5000, 5000, 5000)
+				* Eigen::AngleAxisd(k * M_PI / 2, Eigen::Vector3d::UnitZ()) * Eigen::AngleAxisd(M_PI / 2, Eigen::Vector3d::UnitX());
+		frusta.push_back(geom::convex_volume<double, 3>::frustum(projection * camera.inverse().matrix()));
+	}
+	return frusta;
+}
+/// culling against four frusta with a scalar loop testing every point with Eigen, compare with geom3dcull
+static void geom3dcullscalar(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d, geom::soa_layout> a(state.range(0));
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+	const auto frusta = camera_frusta();
+
+	while (state.KeepRunning()) {
+		for (const auto& frustum : frusta) {
+			std::vector<std::size_t> visible;
+			for (std::size_t i = 0; i < a.size(); ++i) {
+				const Eigen::Vector3d p = a.points()[i];
+				if (std::all_of(frustum.planes().begin(), frustum.planes().end(),
+						[&p](const Eigen::Hyperplane<double, 3>& plane) { return plane.signedDistance(p) >= 0; }))
+					visible.push_back(i);
+			}
+			benchmark::DoNotOptimize(visible.data());
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0) * frusta.size());
+}
+/// culling against four frusta one after the other
+static void geom3dcull(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d, geom::soa_layout> a(state.range(0));
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+	const auto frusta = camera_frusta();
+
+	while (state.KeepRunning()) {
+		for (const auto& frustum : frusta)
+			benchmark::DoNotOptimize(geom::cull(a, frustum, geom::parallel).data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0) * frusta.size());
+}
+/// culling against four frusta in one pass
+static void geom3dcullbits(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d, geom::soa_layout> a(state.range(0));
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+	const auto frusta = camera_frusta();
+
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(geom::cull_bits(a, frusta, geom::parallel).data());
+	state.SetItemsProcessed(state.iterations() * state.range(0) * frusta.size());
+}
+/// culling against four frusta pruned by a kd_tree built once, slower than geom3dcull for volumes this large
+static void geom3dcullkdtree(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d, geom::soa_layout> a(state.range(0));
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+	const auto frusta = camera_frusta();
+	const geom::kd_tree<decltype(a)> tree { a };
+
+	while (state.KeepRunning()) {
+		for (const auto& frustum : frusta)
+			benchmark::DoNotOptimize(geom::cull(tree, frustum).data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0) * frusta.size());
+}
+/// culling against a small oriented box holding about 0.5% of the points
+static void geom3dcullbox(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d, geom::soa_layout> a(state.range(0));
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+	const auto box = geom::convex_volume<double, 3>::oriented_box(Eigen::Translation3d(3000, 6000, 2000)
+			* Eigen::AngleAxisd(0.7, Eigen::Vector3d(1, 1, 0).normalized()) * Eigen::Scaling(1000., 500., 500.));
+
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(geom::cull(a, box, geom::parallel).data());
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+/// culling against the box of geom3dcullbox pruned by a kd_tree built once
+static void geom3dcullboxkdtree(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d, geom::soa_layout> a(state.range(0));
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+	const auto box = geom::convex_volume<double, 3>::oriented_box(Eigen::Translation3d(3000, 6000, 2000)
+			* Eigen::AngleAxisd(0.7, Eigen::Vector3d(1, 1, 0).normalized()) * Eigen::Scaling(1000., 500., 500.));
+	const geom::kd_tree<decltype(a)> tree { a };
+
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(geom::cull(tree, box).data());
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+/// 32 candidate poses around a rigid motion, as scored by scan matching
+static std::vector<Eigen::Affine3d, Eigen::aligned_allocator<Eigen::Affine3d>> candidate_poses() {
+	std::vector<Eigen::Affine3d, Eigen::aligned_allocator<Eigen::Affine3d>> poses;
+	for (int p = 0; p < 32; ++p)
+		poses.push_back(Eigen::Affine3d(Eigen::Translation3d(p % 4, p / 4 % 4, p / 16)
+				* Eigen::AngleAxisd(0.01 * p, Eigen::Vector3d::UnitZ())));
+	return poses;
+}
+/// inliers of every candidate pose with one transform and count pass over the collection per pose
+static void geom3dposesloop(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d, geom::soa_layout> a(state.range(0));
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+	const auto poses = candidate_poses();
+	const Eigen::AlignedBox3d inliers { Eigen::Vector3d::Constant(2000), Eigen::Vector3d::Constant(8000) };
+
+	while (state.KeepRunning()) {
+		for (const auto& pose : poses) {
+			auto moved = a.points();
+			moved.apply(geom::as_transform_kind(pose), 0, moved.size());
+			std::size_t score = 0;
+			for (std::size_t i = 0; i < moved.size(); ++i)
+				score += inliers.contains(moved[i]);
+			benchmark::DoNotOptimize(score);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0) * poses.size());
+}
+/// inliers of every candidate pose with score_poses
+static void geom3dposesbatched(benchmark::State& state) {
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<> d(0, 10000);
+	geom::collection<tagged_vec3d, geom::soa_layout> a(state.range(0));
+	std::generate(a.begin(), a.end(), [&]() {return tagged_vec3d{Eigen::Vector3d{d(gen),d(gen),d(gen)},tag{0}}; });
+	const auto poses = candidate_poses();
+
+	while (state.KeepRunning()) {
+		benchmark::DoNotOptimize(geom::score_poses(a, poses.data(), poses.size(), [](const auto& block) {
+			return std::size_t(((block.array() >= 2000).colwise().all() && (block.array() <= 8000).colwise().all()).count());
+		}, geom::parallel));
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0) * poses.size());
+}
 BENCHMARK(Vector3d)->RangeMultiplier(2)->Range(64, benchmark_size);
-//BENCHMARK(Vector4d)->RangeMultiplier(2)->Range(64, benchmark_size);
+BENCHMARK(Vector4d)->RangeMultiplier(2)->Range(64, benchmark_size);
 BENCHMARK(Vector3f)->RangeMultiplier(2)->Range(64, benchmark_size);
 //BENCHMARK(Matrix3d)->RangeMultiplier(2)->Range(64, benchmark_size);
 //BENCHMARK(Matrix3f)->RangeMultiplier(2)->Range(64, benchmark_size);
@@ -264,5 +1084,46 @@ BENCHMARK(Tagged3d)->RangeMultiplier(2)->Range(64, benchmark_size);
 BENCHMARK(Tagged3f)->RangeMultiplier(2)->Range(64, benchmark_size);
 BENCHMARK(geom3dint)->RangeMultiplier(2)->Range(64, benchmark_size);
 BENCHMARK(geom3fint)->RangeMultiplier(2)->Range(64, benchmark_size);
-
-BENCHMARK_MAIN()
+BENCHMARK(geom3dbulk)->RangeMultiplier(2)->Range(64, benchmark_size);
+BENCHMARK(geom3fbulk)->RangeMultiplier(2)->Range(64, benchmark_size);
+BENCHMARK(geom3dsoa)->RangeMultiplier(2)->Range(64, benchmark_size);
+BENCHMARK(geom3fsoa)->RangeMultiplier(2)->Range(64, benchmark_size);
+BENCHMARK(geom3dpadded)->RangeMultiplier(2)->Range(64, benchmark_size);
+BENCHMARK(geom3fpadded)->RangeMultiplier(2)->Range(64, benchmark_size);
+BENCHMARK(geom3dtranslation)->RangeMultiplier(2)->Range(64, benchmark_size);
+BENCHMARK(geom3drigid)->RangeMultiplier(2)->Range(64, benchmark_size);
+BENCHMARK(geom3dstatistics)->RangeMultiplier(8)->Range(64, 8<<20);
+BENCHMARK(geom3dcrop)->RangeMultiplier(8)->Range(64, 8<<20);
+BENCHMARK(geom3dreorder)->RangeMultiplier(8)->Range(64, 8<<20);
+BENCHMARK(geom3fframe)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3fframearena)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dreplaymapped)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dreplaycopy)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dquantized)->RangeMultiplier(8)->Range(64, 8<<20);
+BENCHMARK(geom3dquantizedstatistics)->RangeMultiplier(8)->Range(64, 8<<20);
+BENCHMARK(geom3dappend)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dappendobjects)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dviewstatistics)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dfilterstatistics)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dcullscalar)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dcull)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dcullbits)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dcullkdtree)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dcullbox)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dcullboxkdtree)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dposesloop)->RangeMultiplier(8)->Range(4096, 1<<20);
+BENCHMARK(geom3dposesbatched)->RangeMultiplier(8)->Range(4096, 1<<20);
+BENCHMARK(geom3dcopytransform)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dtransforminto)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dpipelineserial)->RangeMultiplier(8)->Range(4096, 1<<20)->UseRealTime();
+BENCHMARK(geom3dpipeline)->RangeMultiplier(8)->Range(4096, 1<<20)->UseRealTime();
+BENCHMARK(geom3fprojectloop)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3fproject)->RangeMultiplier(8)->Range(4096, 8<<20);
+BENCHMARK(geom3dvoxelmap)->RangeMultiplier(8)->Range(1<<16, 16<<20)->UseRealTime();
+BENCHMARK(geom3dvoxelgrid)->RangeMultiplier(8)->Range(1<<16, 16<<20)->UseRealTime();
+BENCHMARK(geom3dvoxelgridscan)->RangeMultiplier(8)->Range(1<<16, 16<<20)->UseRealTime();
+BENCHMARK(geom3dstreamchunked)->RangeMultiplier(8)->Range(1<<16, 8<<20)->UseRealTime();
+BENCHMARK(geom3dstreammemory)->RangeMultiplier(8)->Range(1<<16, 8<<20)->UseRealTime();
+BENCHMARK(geom3dparallel)->RangeMultiplier(2)->Range(64, benchmark_size);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,337 @@
+//Benchmark suite at production sizes, from 1K points, which fit into L1, up to 100M points.
+//Transforms points stored as array of objects (AoS) and in geom::collection with every storage layout,
+//for float and double and for 1 up to hardware_concurrency threads,
+//and computes point statistics of the collections.
+//Every case reports items_per_second (points) and bytes_per_second (bytes of point memory touched),
+//inputs are generated from a fixed seed.
+//
+//  geom_benchmark_suite --geom_max_points=10000000 --benchmark_out=baseline.json --benchmark_out_format=json
+//  geom_benchmark_suite --geom_max_points=10000000 --geom_baseline=baseline.json --geom_tolerance=0.1
+//
+//The second run exits with 1 if a case processes more than 10% fewer points per second than in the baseline.
+//Options:
+//  --geom_max_points=N   largest size run, default 100000000 which needs up to 6 GB of memory
+//  --geom_max_threads=N  largest thread count run, default hardware_concurrency
+//  --geom_baseline=FILE  JSON output of an earlier run to compare with
+//  --geom_tolerance=X    relative slowdown tolerated by the comparison, default 0.05
+
+#include <benchmark/benchmark.h>
+
+#include "collection.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace fc;
+
+namespace
+{
+
+/// annotation of the benchmarked objects, a 32 bit id as carried by most production clouds
+struct label {
+	std::uint32_t id;
+};
+
+struct suite_options {
+	std::int64_t max_points = 100000000;
+	std::size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+	std::string baseline;
+	double tolerance = 0.05;
+};
+
+constexpr std::uint32_t seed = 42;
+
+/// bytes of point memory per point in storage layout @p layout
+template<class layout, class vector_t>
+struct point_bytes {
+	static constexpr std::size_t value = sizeof(typename vector_t::Scalar) * vector_t::RowsAtCompileTime;
+};
+template<class vector_t>
+struct point_bytes<geom::padded_layout, vector_t> {
+	static constexpr std::size_t value = sizeof(typename vector_t::Scalar) * 4;
+};
+template<class code_t, class vector_t>
+struct point_bytes<geom::quantized_layout<code_t>, vector_t> {
+	static constexpr std::size_t value = sizeof(code_t) * vector_t::RowsAtCompileTime;
+};
+
+template<class layout>
+const char* layout_name();
+template<>
+const char* layout_name<geom::packed_layout>() {
+	return "packed";
+}
+template<>
+const char* layout_name<geom::soa_layout>() {
+	return "soa";
+}
+template<>
+const char* layout_name<geom::padded_layout>() {
+	return "padded";
+}
+template<>
+const char* layout_name<geom::quantized_layout<std::int16_t>>() {
+	return "quantized16";
+}
+
+template<class scalar>
+const char* scalar_name() {
+	return sizeof(scalar) == sizeof(float) ? "float" : "double";
+}
+
+/// seeded points in the cube [-10, 10]^3, within the range of quantized_layout<int16_t>
+template<class vector_t>
+std::vector<vector_t, Eigen::aligned_allocator<vector_t>> make_points(std::size_t n) {
+	using scalar = typename vector_t::Scalar;
+	std::mt19937 gen(seed);
+	std::uniform_real_distribution<scalar> d(-10, 10);
+	std::vector<vector_t, Eigen::aligned_allocator<vector_t>> points(n);
+	for (auto&& p : points)
+		p = vector_t { d(gen), d(gen), d(gen) };
+	return points;
+}
+
+/// rigid transformation, the benchmarks apply it and its inverse in turn such that points stay in range
+template<class scalar>
+Eigen::Transform<scalar, 3, Eigen::Affine> motion() {
+	using vector_type = Eigen::Matrix<scalar, 3, 1>;
+	Eigen::Transform<scalar, 3, Eigen::Affine> m;
+	m = Eigen::AngleAxis<scalar>(scalar(0.9), vector_type::UnitZ())
+			* Eigen::AngleAxis<scalar>(scalar(1.234), vector_type::UnitY())
+			* Eigen::Translation<scalar, 3>(scalar(1), scalar(1), scalar(2));
+	return m;
+}
+
+void set_counters(benchmark::State& state, std::size_t points_per_iteration, std::size_t bytes_per_iteration) {
+	state.SetItemsProcessed(std::int64_t(state.iterations() * points_per_iteration));
+	state.SetBytesProcessed(std::int64_t(state.iterations() * bytes_per_iteration));
+}
+
+/// transform of an array of objects, every object is read and written
+template<class scalar>
+void aos_transform(benchmark::State& state) {
+	using vector_type = Eigen::Matrix<scalar, 3, 1>;
+	using object_type = geom::object<vector_type, label>;
+	const auto n = std::size_t(state.range(0));
+	const auto points = make_points<vector_type>(n);
+	std::vector<object_type, Eigen::aligned_allocator<object_type>> a(n);
+	for (std::size_t i = 0; i < n; ++i)
+		a[i] = object_type { points[i], label { std::uint32_t(i) } };
+	const auto m = motion<scalar>();
+	const auto inverse = m.inverse();
+
+	while (state.KeepRunning()) {
+		for (auto&& x : a)
+			x.point = m * x.point;
+		for (auto&& x : a)
+			x.point = inverse * x.point;
+		benchmark::DoNotOptimize(a.data());
+	}
+	set_counters(state, 2 * n, 2 * 2 * n * sizeof(object_type));
+}
+
+template<class scalar, class layout>
+geom::collection<geom::object<Eigen::Matrix<scalar, 3, 1>, label>, layout> make_collection(std::size_t n) {
+	using vector_type = Eigen::Matrix<scalar, 3, 1>;
+	const auto points = make_points<vector_type>(n);
+	std::vector<label> meta(n);
+	for (std::size_t i = 0; i < n; ++i)
+		meta[i].id = std::uint32_t(i);
+	geom::collection<geom::object<vector_type, label>, layout> c;
+	c.append(points.data(), meta.data(), n);
+	return c;
+}
+
+/// collection::transform on @p threads threads, the points are read and written
+template<class scalar, class layout>
+void collection_transform(benchmark::State& state, std::size_t threads) {
+	const auto n = std::size_t(state.range(0));
+	auto c = make_collection<scalar, layout>(n);
+	const auto m = motion<scalar>();
+	const auto inverse = m.inverse();
+	//the calling thread takes part in parallel_for_each_block
+	std::unique_ptr<geom::thread_pool> pool { threads > 1 ? new geom::thread_pool(threads - 1) : nullptr };
+
+	while (state.KeepRunning()) {
+		if (pool) {
+			c.transform(m, geom::parallel.on(*pool));
+			c.transform(inverse, geom::parallel.on(*pool));
+		} else {
+			c.transform(m);
+			c.transform(inverse);
+		}
+		benchmark::ClobberMemory();
+	}
+	set_counters(state, 2 * n, 2 * 2 * n * point_bytes<layout, Eigen::Matrix<scalar, 3, 1>>::value);
+}
+
+/// collection::statistics on @p threads threads, the points are read once
+template<class scalar, class layout>
+void collection_statistics(benchmark::State& state, std::size_t threads) {
+	const auto n = std::size_t(state.range(0));
+	const auto c = make_collection<scalar, layout>(n);
+	std::unique_ptr<geom::thread_pool> pool { threads > 1 ? new geom::thread_pool(threads - 1) : nullptr };
+
+	while (state.KeepRunning()) {
+		if (pool)
+			benchmark::DoNotOptimize(c.statistics(geom::parallel.on(*pool)));
+		else
+			benchmark::DoNotOptimize(c.statistics());
+	}
+	set_counters(state, n, n * point_bytes<layout, Eigen::Matrix<scalar, 3, 1>>::value);
+}
+
+std::vector<std::int64_t> sizes(const suite_options& options) {
+	std::vector<std::int64_t> result;
+	for (const std::int64_t n : { std::int64_t(1) << 10, std::int64_t(1) << 15, std::int64_t(1) << 20,
+			std::int64_t(10000000), std::int64_t(100000000) })
+		if (n <= options.max_points)
+			result.push_back(n);
+	return result;
+}
+
+std::vector<std::size_t> thread_counts(const suite_options& options) {
+	std::vector<std::size_t> result;
+	for (std::size_t t = 1; t < options.max_threads; t *= 2)
+		result.push_back(t);
+	result.push_back(options.max_threads);
+	return result;
+}
+
+template<class B>
+void add_sizes(B* bench, const suite_options& options) {
+	for (const auto n : sizes(options))
+		bench->Arg(n);
+	bench->UseRealTime()->Unit(benchmark::kMicrosecond);
+}
+
+template<class scalar, class layout>
+void register_layout(const suite_options& options) {
+	for (const auto threads : thread_counts(options)) {
+		const auto suffix = std::string("/") + layout_name<layout>() + "/" + scalar_name<scalar>()
+				+ "/threads:" + std::to_string(threads);
+		add_sizes(benchmark::RegisterBenchmark(("transform" + suffix).c_str(),
+				collection_transform<scalar, layout>, threads), options);
+		add_sizes(benchmark::RegisterBenchmark(("statistics" + suffix).c_str(),
+				collection_statistics<scalar, layout>, threads), options);
+	}
+}
+
+template<class scalar>
+void register_scalar(const suite_options& options) {
+	add_sizes(benchmark::RegisterBenchmark((std::string("transform/aos/") + scalar_name<scalar>()
+			+ "/threads:1").c_str(), aos_transform<scalar>), options);
+	register_layout<scalar, geom::packed_layout>(options);
+	register_layout<scalar, geom::soa_layout>(options);
+	register_layout<scalar, geom::padded_layout>(options);
+	register_layout<scalar, geom::quantized_layout<std::int16_t>>(options);
+}
+
+/// console reporter remembering the points per second of every run for the baseline comparison
+class recording_reporter: public benchmark::ConsoleReporter {
+public:
+	void ReportRuns(const std::vector<Run>& runs) override {
+		for (const auto& run : runs) {
+			const auto items = run.counters.find("items_per_second");
+			if (run.run_type == Run::RT_Iteration && items != run.counters.end())
+				rates[run.benchmark_name()] = items->second.value;
+		}
+		ConsoleReporter::ReportRuns(runs);
+	}
+
+	std::map<std::string, double> rates;
+};
+
+/// items_per_second by benchmark name of the JSON output of Google benchmark in @p path
+std::map<std::string, double> read_baseline(const std::string& path) {
+	std::ifstream in { path };
+	if (!in)
+		throw std::runtime_error { "can't open baseline " + path };
+	std::stringstream buffer;
+	buffer << in.rdbuf();
+	const auto text = buffer.str();
+
+	std::map<std::string, double> rates;
+	const std::string name_key = "\"name\": \"", rate_key = "\"items_per_second\": ";
+	for (auto pos = text.find(name_key); pos != std::string::npos;) {
+		const auto first = pos + name_key.size();
+		const auto name = text.substr(first, text.find('"', first) - first);
+		const auto next = text.find(name_key, first);
+		const auto rate = text.find(rate_key, first);
+		if (rate < next)
+			rates[name] = std::strtod(text.c_str() + rate + rate_key.size(), nullptr);
+		pos = next;
+	}
+	return rates;
+}
+
+/// prints cases slower than the baseline by more than the tolerance, returns their number
+int compare(const std::map<std::string, double>& current, const std::map<std::string, double>& baseline,
+		double tolerance) {
+	int regressions = 0, compared = 0;
+	for (const auto& run : current) {
+		const auto reference = baseline.find(run.first);
+		if (reference == baseline.end() || reference->second <= 0)
+			continue;
+		++compared;
+		const auto ratio = run.second / reference->second;
+		if (ratio < 1 - tolerance) {
+			++regressions;
+			std::cout << "regression: " << run.first << " at " << ratio * 100 << "% of baseline\n";
+		}
+	}
+	std::cout << compared << " cases compared with baseline, " << regressions << " regressions\n";
+	return regressions;
+}
+
+/// removes the --geom_ options from the command line and returns them
+suite_options parse_options(int& argc, char** argv) {
+	suite_options options;
+	int kept = 1;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const auto value = arg.substr(arg.find('=') + 1);
+		if (arg.compare(0, 18, "--geom_max_points=") == 0)
+			options.max_points = std::atoll(value.c_str());
+		else if (arg.compare(0, 19, "--geom_max_threads=") == 0)
+			options.max_threads = std::max<std::size_t>(1, std::size_t(std::atoll(value.c_str())));
+		else if (arg.compare(0, 16, "--geom_baseline=") == 0)
+			options.baseline = value;
+		else if (arg.compare(0, 17, "--geom_tolerance=") == 0)
+			options.tolerance = std::atof(value.c_str());
+		else
+			argv[kept++] = argv[i];
+	}
+	argc = kept;
+	return options;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	const auto options = parse_options(argc, argv);
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv))
+		return 1;
+
+	register_scalar<float>(options);
+	register_scalar<double>(options);
+
+	recording_reporter reporter;
+	benchmark::RunSpecifiedBenchmarks(&reporter);
+	if (options.baseline.empty())
+		return 0;
+	return compare(reporter.rates, read_baseline(options.baseline), options.tolerance) == 0 ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+#ifndef GEOM_SRC_BOUNDED_QUEUE_H_
+#define GEOM_SRC_BOUNDED_QUEUE_H_
+
+//This header contains fixed capacity lock-free queues passing e.g. geom::collection chunks between threads:
+//spsc_queue for one producer and one consumer thread, mpmc_queue for any number of both.
+//Both move elements into and out of preallocated slots, the slots keep the moved from objects,
+//such that the memory of moved collections is released by the receiving thread.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace fc
+{
+namespace geom
+{
+
+namespace detail
+{
+
+/// size of the padding separating the indices written by producers and consumers, one cache line
+constexpr std::size_t cache_line = 64;
+
+/// smallest power of two >= @p n, at least 2
+inline std::size_t queue_capacity(std::size_t n) {
+	std::size_t capacity = 2;
+	while (capacity < n)
+		capacity *= 2;
+	return capacity;
+}
+
+} // namespace detail
+
+/**
+ * \brief Bounded queue for one producer thread and one consumer thread.
+ *
+ * try_push may only be called by the producer, try_pop by the consumer.
+ * The capacity is rounded up to a power of two.
+ */
+template<class T>
+class spsc_queue {
+public:
+	using value_type = T;
+
+	explicit spsc_queue(std::size_t capacity) :
+			slots(detail::queue_capacity(capacity)), mask { slots.size() - 1 } {
+	}
+
+	spsc_queue(const spsc_queue&) = delete;
+	spsc_queue& operator=(const spsc_queue&) = delete;
+
+	std::size_t capacity() const noexcept {
+		return slots.size();
+	}
+
+	/// Moves @p value into the queue, returns false and leaves @p value untouched if the queue is full.
+	bool try_push(T&& value) {
+		const auto t = tail.load(std::memory_order_relaxed);
+		if (t - head_cache == slots.size()) {
+			head_cache = head.load(std::memory_order_acquire);
+			if (t - head_cache == slots.size())
+				return false;
+		}
+		slots[t & mask] = std::move(value);
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// Moves the oldest element to @p value, returns false if the queue is empty.
+	bool try_pop(T& value) {
+		const auto h = head.load(std::memory_order_relaxed);
+		if (h == tail_cache) {
+			tail_cache = tail.load(std::memory_order_acquire);
+			if (h == tail_cache)
+				return false;
+		}
+		value = std::move(slots[h & mask]);
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// Number of elements, exact when called by producer or consumer while the other one is idle.
+	std::size_t size() const noexcept {
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+	bool empty() const noexcept {
+		return size() == 0;
+	}
+	bool full() const noexcept {
+		return size() >= slots.size();
+	}
+
+private:
+	std::vector<T> slots;
+	const std::size_t mask;
+
+	//consumer side
+	char consumer_padding[detail::cache_line];
+	std::atomic<std::size_t> head { 0 };
+	std::size_t tail_cache = 0;
+	//producer side
+	char producer_padding[detail::cache_line];
+	std::atomic<std::size_t> tail { 0 };
+	std::size_t head_cache = 0;
+};
+
+/**
+ * \brief Bounded queue for any number of producer and consumer threads.
+ *
+ * Every slot carries a sequence number telling producers and consumers whose turn it is,
+ * a push or pop claims a slot with a single compare and swap.
+ * Elements are popped in the order their pushes claimed slots.
+ * The capacity is rounded up to a power of two.
+ */
+template<class T>
+class mpmc_queue {
+public:
+	using value_type = T;
+
+	explicit mpmc_queue(std::size_t capacity) :
+			cells(new cell[detail::queue_capacity(capacity)]), mask { detail::queue_capacity(capacity) - 1 } {
+		for (std::size_t i = 0; i <= mask; ++i)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	mpmc_queue(const mpmc_queue&) = delete;
+	mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+	std::size_t capacity() const noexcept {
+		return mask + 1;
+	}
+
+	/// Moves @p value into the queue, returns false and leaves @p value untouched if the queue is full.
+	bool try_push(T&& value) {
+		auto position = enqueue_position.load(std::memory_order_relaxed);
+		while (true) {
+			auto& c = cells[position & mask];
+			const auto lag = std::intptr_t(c.sequence.load(std::memory_order_acquire)) - std::intptr_t(position);
+			if (lag == 0) {
+				if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					c.value = std::move(value);
+					c.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (lag < 0) {
+				return false;
+			} else {
+				position = enqueue_position.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/// Moves the oldest element to @p value, returns false if the queue is empty.
+	bool try_pop(T& value) {
+		auto position = dequeue_position.load(std::memory_order_relaxed);
+		while (true) {
+			auto& c = cells[position & mask];
+			const auto lag = std::intptr_t(c.sequence.load(std::memory_order_acquire)) - std::intptr_t(position + 1);
+			if (lag == 0) {
+				if (dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					value = std::move(c.value);
+					c.sequence.store(position + mask + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (lag < 0) {
+				return false;
+			} else {
+				position = dequeue_position.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/// Number of claimed slots, approximate while other threads push or pop.
+	std::size_t size() const noexcept {
+		const auto pushed = enqueue_position.load(std::memory_order_acquire);
+		const auto popped = dequeue_position.load(std::memory_order_acquire);
+		return pushed > popped ? pushed - popped : 0;
+	}
+	bool empty() const noexcept {
+		return size() == 0;
+	}
+	bool full() const noexcept {
+		return size() >= capacity();
+	}
+
+private:
+	struct cell {
+		std::atomic<std::size_t> sequence;
+		T value;
+	};
+
+	std::unique_ptr<cell[]> cells;
+	const std::size_t mask;
+
+	char enqueue_padding[detail::cache_line];
+	std::atomic<std::size_t> enqueue_position { 0 };
+	char dequeue_padding[detail::cache_line];
+	std::atomic<std::size_t> dequeue_position { 0 };
+};
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_BOUNDED_QUEUE_H_ */
@@ -0,0 +1,412 @@
+#ifndef GEOM_SRC_CHUNK_STREAM_H_
+#define GEOM_SRC_CHUNK_STREAM_H_
+
+//This header contains chunked access to collection files (see mapped_collection.h)
+//for datasets which don't fit into memory.
+//chunk_reader reads ranges of objects into a geom::collection, chunk_writer appends collections to a file
+//and for_each_chunk streams a file through a function chunk by chunk,
+//reading the next chunk in the background while the current one is processed:
+//
+//  chunk_reader<object<Vector3d, tag>, soa_layout> source { "in.bin" };
+//  chunk_writer<object<Vector3d, tag>, soa_layout> sink { "out.bin", source.size() };
+//  for_each_chunk(source, 1 << 20, [&](auto& chunk) {
+//      chunk.transform(m);
+//      chunk.erase_if(by_point(outside));
+//      sink.write(chunk);
+//  });
+//
+//Only two chunks are held in memory at any time. Requires POSIX pread and pwrite.
+
+#include "collection.h"
+#include "instrument.h"
+#include "mapped_collection.h"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fc
+{
+namespace geom
+{
+
+namespace detail
+{
+
+/// Owning POSIX file descriptor.
+class file_handle {
+public:
+	file_handle() = default;
+	file_handle(const std::string& path, int flags, const char* action) :
+			fd { ::open(path.c_str(), flags, 0644) } {
+		if (fd < 0)
+			throw std::runtime_error { "can't open " + path + " for " + action };
+	}
+	~file_handle() {
+		if (fd >= 0)
+			::close(fd);
+	}
+
+	file_handle(const file_handle&) = delete;
+	file_handle& operator=(const file_handle&) = delete;
+	file_handle(file_handle&& o) noexcept :
+			fd { o.fd } {
+		o.fd = -1;
+	}
+	file_handle& operator=(file_handle&& o) noexcept {
+		std::swap(fd, o.fd);
+		return *this;
+	}
+
+	int get() const noexcept {
+		return fd;
+	}
+
+private:
+	int fd = -1;
+};
+
+/// reads exactly @p bytes at @p offset of @p fd into @p data, throws std::runtime_error on failure.
+inline void read_at(int fd, void* data, std::uint64_t bytes, std::uint64_t offset, const std::string& path) {
+	auto out = static_cast<char*>(data);
+	while (bytes > 0) {
+		const auto n = ::pread(fd, out, bytes, off_t(offset));
+		if (n <= 0)
+			throw std::runtime_error { "failed reading " + path };
+		out += n;
+		bytes -= std::uint64_t(n);
+		offset += std::uint64_t(n);
+	}
+}
+
+/// writes @p bytes from @p data at @p offset of @p fd, throws std::runtime_error on failure.
+inline void write_at(int fd, const void* data, std::uint64_t bytes, std::uint64_t offset, const std::string& path) {
+	auto in = static_cast<const char*>(data);
+	while (bytes > 0) {
+		const auto n = ::pwrite(fd, in, bytes, off_t(offset));
+		if (n <= 0)
+			throw std::runtime_error { "failed writing " + path };
+		in += n;
+		bytes -= std::uint64_t(n);
+		offset += std::uint64_t(n);
+	}
+}
+
+/**
+ * \brief runs reads one at a time on a single reader thread.
+ *
+ * The thread lives as long as the prefetcher, such that streaming a file
+ * doesn't create a thread per chunk.
+ */
+class prefetcher {
+public:
+	prefetcher() :
+			reader { [this]() { run(); } } {
+	}
+	~prefetcher() {
+		{
+			std::lock_guard<std::mutex> lock { mutex };
+			stopped = true;
+		}
+		changed.notify_all();
+		reader.join();
+	}
+
+	prefetcher(const prefetcher&) = delete;
+	prefetcher& operator=(const prefetcher&) = delete;
+
+	/// starts @p read on the reader thread, the previous read must have been waited for.
+	void start(std::function<void()> read) {
+		{
+			std::lock_guard<std::mutex> lock { mutex };
+			job = std::move(read);
+			busy = true;
+		}
+		changed.notify_all();
+	}
+
+	/// waits until the started read finished, its exception is dropped.
+	void wait() {
+		std::unique_lock<std::mutex> lock { mutex };
+		changed.wait(lock, [this]() { return !busy; });
+		error = nullptr;
+	}
+
+	/// waits until the started read finished and rethrows its exception.
+	void get() {
+		std::unique_lock<std::mutex> lock { mutex };
+		changed.wait(lock, [this]() { return !busy; });
+		if (error)
+			std::rethrow_exception(std::exchange(error, nullptr));
+	}
+
+private:
+	void run() {
+		std::unique_lock<std::mutex> lock { mutex };
+		while (true) {
+			changed.wait(lock, [this]() { return stopped || job; });
+			if (!job)
+				return;
+			auto read = std::move(job);
+			job = nullptr;
+			lock.unlock();
+			std::exception_ptr failure;
+			try {
+				read();
+			} catch (...) {
+				failure = std::current_exception();
+			}
+			lock.lock();
+			error = failure;
+			busy = false;
+			changed.notify_all();
+		}
+	}
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::function<void()> job;
+	std::exception_ptr error;
+	bool busy = false;
+	bool stopped = false;
+	std::thread reader;
+};
+
+} // namespace detail
+
+/**
+ * \brief Reads ranges of objects of a collection file into geom::collection.
+ *
+ * Every range is read with one pread per annotation array and one per point block,
+ * or one per coordinate for soa_layout.
+ * read() may be called concurrently from several threads.
+ *
+ * \tparam T, layout, allocator_t parameters of the collection chunks are read into,
+ * T and layout have to match the file.
+ */
+template<class T, class layout = typename default_layout<typename T::vector_type>::type,
+		class allocator_t = Eigen::aligned_allocator<T>>
+class chunk_reader {
+	using description = detail::file_description<T, layout>;
+	using arrays = typename description::arrays;
+
+public:
+	using collection_type = collection<T, layout, allocator_t>;
+	using size_type = std::size_t;
+
+	/**
+	 * \brief Opens file @p path and reads its header.
+	 *
+	 * \throws std::runtime_error if the file can't be read or doesn't match T and layout.
+	 */
+	explicit chunk_reader(const std::string& path) :
+			path { path }, file { path, O_RDONLY, "reading" } {
+		struct stat info;
+		if (::fstat(file.get(), &info) != 0)
+			throw std::runtime_error { "can't open " + path + " for reading" };
+		const auto length = std::uint64_t(info.st_size);
+		std::array<char, description::head_size> head { };
+		detail::read_at(file.get(), head.data(), std::min<std::uint64_t>(length, head.size()), 0, path);
+		file_layout = description::parse(head.data(), length, path);
+	}
+
+	/// Number of objects in the file.
+	size_type size() const noexcept {
+		return file_layout.header.count;
+	}
+
+	/// Reads @p count objects starting at @p first into @p out, which is resized to count.
+	void read(size_type first, size_type count, collection_type& out) const {
+		using scalar_type = typename collection_type::scalar_type;
+		if (first > size() || count > size() - first)
+			throw std::out_of_range { "chunk_reader: range exceeds " + path };
+		GEOM_PROBE(io, count, count * (detail::stored_point_bytes<std::decay_t<decltype(out.points())>>::value
+				+ sizeof(typename collection_type::annotation)));
+		out.resize(count, uninitialized);
+		const auto& h = file_layout.header;
+		auto& points = out.points();
+		if (h.coordinate_stride == 1) {
+			detail::read_at(file.get(), points.data(), count * h.point_stride * sizeof(scalar_type),
+					h.point_offset + first * h.point_stride * sizeof(scalar_type), path);
+		} else {
+			for (int r = 0; r < collection_type::dimension; ++r)
+				detail::read_at(file.get(), points.data() + r * points.coordinate_stride(),
+						count * sizeof(scalar_type),
+						h.point_offset + (r * h.coordinate_stride + first) * sizeof(scalar_type), path);
+		}
+		const auto data = arrays::mutable_data(out.meta());
+		for (std::size_t a = 0; a < arrays::count; ++a) {
+			const auto& entry = file_layout.entries[a];
+			detail::read_at(file.get(), data[a], count * entry.element_size,
+					entry.offset + first * entry.element_size, path);
+		}
+	}
+
+private:
+	std::string path;
+	detail::file_handle file;
+	description file_layout;
+};
+
+/**
+ * \brief Appends collections to a collection file, which can be read with mapped_collection and chunk_reader.
+ *
+ * Point block and annotation arrays are placed for a fixed capacity when the file is created,
+ * the file is sparse and unwritten space takes no disk space on most file systems.
+ * The header with the final number of objects is written by close() or the destructor.
+ */
+template<class T, class layout = typename default_layout<typename T::vector_type>::type>
+class chunk_writer {
+	using description = detail::file_description<T, layout>;
+	using arrays = typename description::arrays;
+	using points_type = point_storage<layout, typename T::vector_type>;
+
+public:
+	using size_type = std::size_t;
+
+	/**
+	 * \brief Creates file @p path for at most @p capacity objects.
+	 *
+	 * \throws std::runtime_error if the file can't be created.
+	 */
+	chunk_writer(const std::string& path, size_type capacity) :
+			path { path }, file { path, O_WRONLY | O_CREAT | O_TRUNC, "writing" },
+			file_layout { description::describe(0, capacity, points_type::geometry(capacity)) },
+			capacity { capacity } {
+		if (::ftruncate(file.get(), off_t(file_layout.length)) != 0)
+			throw std::runtime_error { "failed writing " + path };
+	}
+
+	~chunk_writer() {
+		try {
+			close();
+		} catch (...) {
+		}
+	}
+
+	chunk_writer(const chunk_writer&) = delete;
+	chunk_writer& operator=(const chunk_writer&) = delete;
+
+	/// Number of objects written so far.
+	size_type size() const noexcept {
+		return count;
+	}
+
+	/**
+	 * \brief Appends all objects of @p c to the file.
+	 *
+	 * \throws std::length_error if the capacity of the file would be exceeded.
+	 */
+	template<class allocator_t>
+	void write(const collection<T, layout, allocator_t>& c) {
+		using scalar_type = typename T::vector_type::Scalar;
+		GEOM_PROBE(io, c.size(), c.size() * (detail::stored_point_bytes<points_type>::value
+				+ sizeof(typename collection<T, layout, allocator_t>::annotation)));
+		if (file.get() < 0)
+			throw std::logic_error { "chunk_writer: " + path + " is closed" };
+		if (c.size() > capacity - count)
+			throw std::length_error { "chunk_writer: capacity of " + path + " exceeded" };
+		const auto& h = file_layout.header;
+		const auto& points = c.points();
+		if (h.coordinate_stride == 1) {
+			detail::write_at(file.get(), points.data(), c.size() * h.point_stride * sizeof(scalar_type),
+					h.point_offset + count * h.point_stride * sizeof(scalar_type), path);
+		} else {
+			for (int r = 0; r < T::vector_type::RowsAtCompileTime; ++r)
+				detail::write_at(file.get(), points.data() + r * points.coordinate_stride(),
+						c.size() * sizeof(scalar_type),
+						h.point_offset + (r * h.coordinate_stride + count) * sizeof(scalar_type), path);
+		}
+		const auto data = arrays::data(c.meta());
+		for (std::size_t a = 0; a < arrays::count; ++a) {
+			const auto& entry = file_layout.entries[a];
+			detail::write_at(file.get(), data[a], c.size() * entry.element_size,
+					entry.offset + count * entry.element_size, path);
+		}
+		count += c.size();
+	}
+
+	/// Writes the header and closes the file, further writes are not allowed.
+	void close() {
+		if (file.get() < 0)
+			return;
+		detail::file_handle closing = std::move(file);
+		file_layout.header.count = count;
+		detail::write_at(closing.get(), &file_layout.header, sizeof(file_header), 0, path);
+		detail::write_at(closing.get(), file_layout.entries.data(), sizeof(file_layout.entries),
+				sizeof(file_header), path);
+	}
+
+private:
+	std::string path;
+	detail::file_handle file;
+	description file_layout;
+	size_type capacity;
+	size_type count = 0;
+};
+
+/**
+ * \brief Calls @p f(chunk) for consecutive chunks of @p chunk_size objects read from @p source.
+ *
+ * chunk is a collection_type& holding the objects of the chunk, which f may modify.
+ * While f processes a chunk the next one is read by a reader thread,
+ * which is started once per call, only these two chunks are held in memory.
+ * Exceptions of f and of reading are propagated after the pending read finished.
+ *
+ * \param alloc allocator of the two chunk collections.
+ */
+template<class T, class layout, class allocator_t, class F>
+void for_each_chunk(const chunk_reader<T, layout, allocator_t>& source, std::size_t chunk_size, F f,
+		const allocator_t& alloc = allocator_t()) {
+	using collection_type = typename chunk_reader<T, layout, allocator_t>::collection_type;
+	chunk_size = std::max<std::size_t>(chunk_size, 1);
+	const auto total = source.size();
+	collection_type current { alloc }, next { alloc };
+	std::size_t first = 0;
+	source.read(first, std::min(chunk_size, total), current);
+	if (current.size() >= total) {
+		if (total > 0)
+			f(current);
+		return;
+	}
+	detail::prefetcher prefetch;
+	while (first < total) {
+		const auto following = first + current.size();
+		const bool more = following < total;
+		if (more) {
+			prefetch.start([&source, &next, following, chunk_size, total]() {
+				source.read(following, std::min(chunk_size, total - following), next);
+			});
+		}
+		try {
+			f(current);
+		} catch (...) {
+			if (more)
+				prefetch.wait();
+			throw;
+		}
+		if (more)
+			prefetch.get();
+		first = following;
+		std::swap(current, next);
+	}
+}
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_CHUNK_STREAM_H_ */
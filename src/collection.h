@@ -8,31 +8,50 @@
 #ifndef GEOM_SRC_COLLECTION_H_
 #define GEOM_SRC_COLLECTION_H_
 
+#include "allocator.h"
+#include "annotation_storage.h"
 #include "config.h"
+#include "instrument.h"
+#include "morton.h"
 #include "object.h"
+#include "quantized_storage.h"
+#include "reduction.h"
+#include "storage.h"
+#include "thread_pool.h"
+#include "transform_kinds.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace fc
 {
 namespace geom
 {
 
-template<class >
+template<class T, class = typename default_layout<typename T::vector_type>::type,
+		class = Eigen::aligned_allocator<T>>
 class collection;
 
 /**
  * \brief Proxy of actual geom::object for reference access in geom::collection::iterators
  *
- * \tparam T instantiation of geom::object point_reference proxies.
+ * \tparam collection_t instantiation of geom::collection point_reference refers to.
  *
  * stores index and pointer to geom::collection
  * This allows it to refer to the point and metadata of the geom::object
  * point_reference serves as a proxy to.
  */
-template<class T>
+template<class collection_t>
 struct point_reference {
-	friend class collection<T> ;
+	using T = typename collection_t::value_type;
+	friend collection_t;
 
-	point_reference(collection<T>* cont, typename collection<T>::size_type index) :
+	point_reference(collection_t* cont, typename collection_t::size_type index) :
 			index { index }, access { cont } {
 	}
 
@@ -45,13 +64,13 @@ struct point_reference {
 
 	point_reference& operator=(const T& value) {
 		point() = value.point;
-		meta() = static_cast<const typename T::annotation&>(value);
+		access->annotations.store(index, static_cast<const typename T::annotation&>(value));
 		return *this;
 	}
 
 	point_reference& operator=(T&& value) {
 		point() = value.point;
-		meta() = static_cast<typename T::annotation&&>(value);
+		access->annotations.store(index, static_cast<typename T::annotation&&>(value));
 		return *this;
 	}
 
@@ -59,10 +78,15 @@ struct point_reference {
 		return T { point(), meta() };
 	}
 
-	void swap(point_reference<T>& o) {
+	void swap(point_reference& o) {
 		using std::swap;
-		swap(point(), o.point());
-		swap(meta(), o.meta());
+		//points might be proxies depending on the layout, thus swap through a temporary
+		typename collection_t::vector_type tmp = point();
+		point() = o.point();
+		o.point() = tmp;
+		typename collection_t::annotation tmp_meta = meta();
+		access->annotations.store(index, o.meta());
+		o.access->annotations.store(o.index, std::move(tmp_meta));
 	}
 
 	bool operator==(const point_reference& o) const {
@@ -82,30 +106,96 @@ struct point_reference {
 	}
 
 private:
-	auto& point() {
+	decltype(auto) point() {
 		return access->point_matrix[index];
 	}
-	auto& meta() {
-		return access->annotations[index];
-	}
 
-	const auto& point() const {
-		return access->point_matrix[index];
+	decltype(auto) point() const {
+		return static_cast<const collection_t*>(access)->point_matrix[index];
 	}
-	const auto& meta() const {
-		return access->annotations[index];
+	decltype(auto) meta() const {
+		return static_cast<const collection_t*>(access)->annotations.load(index);
 	}
 
-	friend class collection<T> ;
-	typename collection<T>::size_type index;
-	collection<T>* access;
+	typename collection_t::size_type index;
+	collection_t* access;
 };
 
-template<class T>
-void swap(point_reference<T>& l, point_reference<T>& r) {
+template<class collection_t>
+void swap(point_reference<collection_t>& l, point_reference<collection_t>& r) {
 	l.swap(r);
 }
 
+/// Predicate on the point of an object only, see by_point.
+template<class F>
+struct point_predicate {
+	F f;
+};
+
+/// Predicate on the annotation of an object only, see by_annotation.
+template<class F>
+struct annotation_predicate {
+	F f;
+};
+
+/**
+ * \brief Marks @p f as predicate on points for collection::erase_if and collection::filter.
+ *
+ * @p f is called with the point only, annotations are not read while the predicate is evaluated.
+ */
+template<class F>
+point_predicate<F> by_point(F f) {
+	return { std::move(f) };
+}
+
+/**
+ * \brief Marks @p f as predicate on annotations for collection::erase_if and collection::filter.
+ *
+ * @p f is called with the annotation only, points are not read while the predicate is evaluated.
+ */
+template<class F>
+annotation_predicate<F> by_annotation(F f) {
+	return { std::move(f) };
+}
+
+namespace detail
+{
+
+/// evaluates predicate @p pred on object @p i of collection @p c, see by_point and by_annotation.
+template<class collection_t, class F>
+bool matches(const collection_t& c, const point_predicate<F>& pred, std::size_t i) {
+	return pred.f(c.points()[i]);
+}
+template<class collection_t, class F>
+bool matches(const collection_t& c, const annotation_predicate<F>& pred, std::size_t i) {
+	return pred.f(c.meta().load(i));
+}
+template<class collection_t, class F>
+bool matches(const collection_t& c, const F& pred, std::size_t i) {
+	return pred(typename collection_t::value_type { c.points()[i], c.meta().load(i) });
+}
+
+/// number of objects per block of algorithms on @p collection_t, the grain of the policy if set.
+template<class collection_t>
+typename collection_t::size_type block_grain(sequential_policy) {
+	return collection_t::block_size();
+}
+template<class collection_t>
+typename collection_t::size_type block_grain(parallel_policy policy) {
+	return policy.grain ? policy.grain : collection_t::block_size();
+}
+
+/// fails to compile if transform kind @p kind_t doesn't match the points of @p collection_t.
+template<class collection_t, class kind_t>
+void check_kind(const kind_t&) {
+	static_assert(std::is_same<typename kind_t::scalar_type, typename collection_t::scalar_type>::value,
+			"scalar type of transformation does not match collection");
+	static_assert(kind_t::dimension == collection_t::dimension,
+			"dimension of transformation does not match collection");
+}
+
+} // namespace detail
+
 /**
  * \Container class for geom objects with cache friendly storage
  *
@@ -114,20 +204,30 @@ void swap(point_reference<T>& l, point_reference<T>& r) {
  * without any effect of the metadata on the cache.
  *
  * \tparam T type of object stores in collection, an instantiation of geom::object
+ * \tparam layout storage policy of the point block, see storage.h
+ * \tparam allocator_t allocator rebound to allocate the arrays of points and annotations,
+ * see allocator.h for an arena allocator recycling memory between frames.
  *
  * \invariant point_matrix.size() == annotations.size()
  */
-template<class T>
+template<class T, class layout, class allocator_t>
 class collection {
 public:
 	using value_type = T;
+	using allocator_type = allocator_t;
 	/// Type of vector stored (vector3d, Vector2f etc.)
 	using vector_type = typename T::vector_type;
 	/// Type of meta data in the stored objects
 	using annotation = typename T::annotation;
-	using difference_type = T*; //todo
+	/// Scalar type of the vector coordinates (double, float etc.)
+	using scalar_type = typename vector_type::Scalar;
+	/// Number of coordinates per point
+	static constexpr int dimension = vector_type::RowsAtCompileTime;
+	using difference_type = std::ptrdiff_t;
 	using size_type = size_t;
 
+	class const_iterator;
+
 	/**
 	 * \brief random access iterator over collection.
 	 *
@@ -139,8 +239,8 @@ public:
 		using difference_type = collection::difference_type;
 		using value_type = typename collection::value_type;
 		///Note the reference is point_reference proxy and not value_type&.
-		using reference = point_reference<T>;
-		using pointer = point_reference<T>*;
+		using reference = point_reference<collection>;
+		using pointer = point_reference<collection>*;
 		using size_type = typename collection::size_type;
 		using iterator_category = std::random_access_iterator_tag;
 
@@ -184,38 +284,43 @@ public:
 			return *this;
 		}
 		iterator operator++(int) {
-			return iterator { index++ };
+			return iterator { index++, access };
 		}
 		iterator& operator--() {
 			--index;
 			return *this;
 		}
 		iterator operator--(int) {
-			return iterator { index-- };
+			return iterator { index--, access };
 		}
 		iterator& operator+=(size_type p) {
 			index += p;
 			return *this;
 		}
 		iterator operator+(size_type p) const {
-			return iterator { index + p };
+			return iterator { index + p, access };
 		}
 		iterator& operator-=(size_type p) {
 			index -= p;
 			return *this;
 		}
 		iterator operator-(size_type p) const {
-			return iterator { index - p };
+			return iterator { index - p, access };
 		}
 		difference_type operator-(iterator p) const {
-			return difference_type { index - p.index };
+			return static_cast<difference_type>(index) - static_cast<difference_type>(p.index);
 		}
 
 		reference operator*() {
 			return reference { access, index };
 		}
+		reference operator[](difference_type n) {
+			return reference { access, index + n };
+		}
 		pointer operator->() const;
 	private:
+		friend class const_iterator;
+
 		size_type index = 0;
 		collection* access = nullptr;
 	};
@@ -223,19 +328,18 @@ public:
 	public:
 		using difference_type = collection::difference_type;
 		using value_type = typename collection::value_type;
-		using const_reference = const point_reference<T>;
-		using const_pointer = const point_reference<T>*;
+		using reference = const point_reference<collection>;
+		using pointer = const point_reference<collection>*;
+		using const_reference = reference;
+		using const_pointer = pointer;
 		using size_type = typename collection::size_type;
 		using iterator_category = std::random_access_iterator_tag;
 
 		const_iterator() = default;
 		const_iterator(const const_iterator&) = default;
 		const_iterator(const_iterator&&) = default;
-		const_iterator(const iterator& o) {
-			index = o.index;
-		}
-		const_iterator(iterator&& o) {
-			index = o.index;
+		const_iterator(const iterator& o) :
+				index { o.index }, access { o.access } {
 		}
 
 		const_iterator(size_type index, const collection* access) :
@@ -274,36 +378,39 @@ public:
 			return *this;
 		}
 		const_iterator operator++(int) {
-			return const_iterator { index++ };
+			return const_iterator { index++, access };
 		}
 		const_iterator& operator--() {
 			--index;
 			return *this;
 		}
 		const_iterator operator--(int) {
-			return const_iterator { index-- };
+			return const_iterator { index--, access };
 		}
 		const_iterator& operator+=(size_type p) {
 			index += p;
 			return *this;
 		}
 		const_iterator operator+(size_type p) const {
-			return iterator { index + p };
+			return const_iterator { index + p, access };
 		}
 		const_iterator& operator-=(size_type p) {
 			index -= p;
 			return *this;
 		}
 		const_iterator operator-(size_type p) const {
-			return iterator { index - p };
+			return const_iterator { index - p, access };
 		}
 		difference_type operator-(const_iterator p) const {
-			return difference_type { index - p.index };
+			return static_cast<difference_type>(index) - static_cast<difference_type>(p.index);
 		}
 
 		const_reference operator*() {
 			return const_reference { access, index };
 		}
+		const_reference operator[](difference_type n) {
+			return const_reference { access, index + n };
+		}
 		const_pointer operator->() const;
 	private:
 		size_type index = 0;
@@ -319,36 +426,55 @@ public:
 	collection(const collection&) = default;
 	collection(collection&&) = default;
 
+	explicit collection(const allocator_type& alloc) :
+			point_matrix(alloc), annotations(alloc) {
+	}
+
 	/// Constructor taking an initalizer_list of geom::object.
-	collection(std::initializer_list<T> o) :
-			point_matrix(o.size()), annotations ( o.size() ) {
+	collection(std::initializer_list<T> o, const allocator_type& alloc = allocator_type()) :
+			point_matrix(o.size(), uninitialized, alloc), annotations(o.size(), uninitialized, alloc) {
 		int index { 0 };
 
 		//extract geometric data and meta data from object and store it.
 		for (auto&& x : o) {
 			point_matrix[index] = x.point;
-			annotations[index] = static_cast<typename T::annotation>(x);
+			annotations.store(index, static_cast<const typename T::annotation&>(x));
 			++index;
 		}
 	}
 
 	///Construct collection from a range of geom::object.
 	template<class iterator_t>
-	collection(iterator_t begin, iterator_t end) :
-			point_matrix(end - begin), annotations ( end - begin ) {
+	collection(iterator_t begin, iterator_t end, const allocator_type& alloc = allocator_type()) :
+			point_matrix(end - begin, uninitialized, alloc), annotations(end - begin, uninitialized, alloc) {
 		int index { 0 };
 
 		//extract geometric data and meta data from object and store it.
 		for (auto i = begin; i != end; ++i) {
-			point_matrix[index] = i->point;
-			annotations[index] = static_cast<typename T::annotation>(*i);
+			const T& o = *i;
+			point_matrix[index] = o.point;
+			annotations.store(index, static_cast<const typename T::annotation&>(o));
 			++index;
 		}
 	}
 
 	///Construct collection with default initialized members and @p size.
-	explicit collection(size_type size) :
-			point_matrix(size), annotations( size ) {
+	explicit collection(size_type size, const allocator_type& alloc = allocator_type()) :
+			point_matrix(size, alloc), annotations(size, alloc) {
+	}
+
+	/**
+	 * \brief Construct collection of @p size objects without initializing their memory.
+	 *
+	 * Points and trivial annotations have indeterminate values and have to be written before they are read.
+	 * Avoids clearing buffers which are overwritten right away, e.g. by a sensor driver.
+	 */
+	collection(size_type size, uninitialized_t, const allocator_type& alloc = allocator_type()) :
+			point_matrix(size, uninitialized, alloc), annotations(size, uninitialized, alloc) {
+	}
+
+	allocator_type get_allocator() const {
+		return point_matrix.get_allocator();
 	}
 
 	collection& operator=(const collection&) = default;
@@ -389,13 +515,465 @@ public:
 		return point_matrix;
 	}
 
+	/// Annotations of all objects, see annotation_storage.h.
+	const auto& meta() const noexcept {
+		return annotations;
+	}
+	auto& meta() noexcept {
+		return annotations;
+	}
+
+	/// Resizes to @p size objects, new objects are value initialized.
+	void resize(size_type size) {
+		point_matrix.resize(size);
+		annotations.resize(size);
+	}
+	/// Resizes to @p size objects, new points and trivial annotations are left uninitialized.
+	void resize(size_type size, uninitialized_t) {
+		point_matrix.resize(size, uninitialized);
+		annotations.resize(size, uninitialized);
+	}
+	/// Reserves memory for @p capacity objects, growing up to capacity doesn't reallocate.
+	void reserve(size_type capacity) {
+		point_matrix.reserve(capacity);
+		annotations.reserve(capacity);
+	}
+
+	/// Appends an object with point @p p and annotation @p meta.
+	void emplace_back(const vector_type& p, annotation meta) {
+		const auto i = size();
+		resize(i + 1, uninitialized);
+		point_matrix[i] = p;
+		annotations.store(i, std::move(meta));
+	}
+	void push_back(const T& o) {
+		emplace_back(o.point, o);
+	}
+
+	/**
+	 * \brief Appends @p count objects given as separate arrays of points and annotations.
+	 *
+	 * Points and annotations are copied block by block, without assembling objects.
+	 * Both arrays must not point into this collection.
+	 * If an exception is thrown, the collection keeps its former objects.
+	 * \throws std::length_error if the result would exceed the size of either storage.
+	 */
+	void append(const vector_type* points, const annotation* meta, size_type count) {
+		const auto old_size = size();
+		point_matrix.append(points, count);
+		try {
+			annotations.append(meta, count);
+		} catch (...) {
+			resize(old_size, uninitialized);
+			throw;
+		}
+	}
+	/// Appends all objects of @p o, which may be this collection, block by block.
+	void append(const collection& o) {
+		const auto old_size = size();
+		point_matrix.append(o.point_matrix);
+		try {
+			annotations.append(o.annotations);
+		} catch (...) {
+			resize(old_size, uninitialized);
+			throw;
+		}
+	}
+
+	/**
+	 * \brief Applies transformation @p m to all points in the collection.
+	 *
+	 * The point block is processed as a whole in a single pass,
+	 * annotations are not touched.
+	 * @p m is either a transform kind (see transform_kinds.h) or an Eigen transformation,
+	 * which is mapped to the most specific kind at compile time.
+	 * Scalar type and dimension of @p m have to match vector_type.
+	 */
+	template<class matrix_t>
+	void transform(const matrix_t& m) {
+		GEOM_PROBE(transform, size(), 2 * size() * point_bytes());
+		const auto& k = as_transform_kind<dimension>(m);
+		detail::check_kind<collection>(k);
+		point_matrix.apply(k, 0, size());
+	}
+
+	/**
+	 * \brief Applies transformation @p m to all points using the given execution policy.
+	 *
+	 * With parallel_policy the point block is split into cache sized blocks
+	 * which are transformed concurrently by the threads of the pool.
+	 */
+	template<class matrix_t>
+	void transform(const matrix_t& m, parallel_policy policy) {
+		GEOM_PROBE(transform, size(), 2 * size() * point_bytes());
+		const auto& k = as_transform_kind<dimension>(m);
+		detail::check_kind<collection>(k);
+		parallel_for_each_block(size(), detail::block_grain<collection>(policy), [this, &k](size_type first, size_type last) {
+			point_matrix.apply(k, first, last - first);
+		}, policy);
+	}
+
+	template<class matrix_t>
+	void transform(const matrix_t& m, sequential_policy) {
+		transform(m);
+	}
+
+	/**
+	 * \brief Bounding box, centroid and covariance of all points in a single pass.
+	 *
+	 * With parallel_policy every block of points is reduced by one thread
+	 * and the partial results are merged in block order.
+	 */
+	template<class policy_t = sequential_policy>
+	point_statistics<scalar_type, dimension> statistics(policy_t policy = sequential) const {
+		GEOM_PROBE(statistics, size(), size() * point_bytes());
+		const auto grain = detail::block_grain<collection>(policy);
+		const auto blocks = (size() + grain - 1) / grain;
+		std::vector<point_statistics<scalar_type, dimension>> partial(blocks);
+		parallel_for_each_block(size(), grain, [this, &partial, grain](size_type first, size_type last) {
+			partial[first / grain] = detail::block_statistics(point_matrix.block(first, last - first));
+		}, policy);
+
+		point_statistics<scalar_type, dimension> result { };
+		for (auto&& p : partial)
+			result += p;
+		return result;
+	}
+
+	/// Axis aligned bounding box of all points, empty for an empty collection.
+	template<class policy_t = sequential_policy>
+	auto bounds(policy_t policy = sequential) const {
+		return statistics(policy).bounds;
+	}
+
+	/// Centroid of all points.
+	template<class policy_t = sequential_policy>
+	auto centroid(policy_t policy = sequential) const {
+		return statistics(policy).mean;
+	}
+
+	/// Population covariance of all points.
+	template<class policy_t = sequential_policy>
+	auto covariance(policy_t policy = sequential) const {
+		return statistics(policy).covariance();
+	}
+
+	/**
+	 * \brief Removes all objects for which @p pred returns true.
+	 *
+	 * The relative order of the remaining objects is preserved.
+	 * @p pred is called with the object, or with the point or annotation only
+	 * if wrapped by by_point or by_annotation.
+	 * Objects are compacted in place tile by tile, the kept positions of a tile are collected on the stack
+	 * and its points and annotations are moved to the front right away, nothing is allocated.
+	 * \returns number of removed objects.
+	 */
+	template<class predicate_t>
+	size_type erase_if(const predicate_t& pred) {
+		GEOM_PROBE(filter, size(), 2 * size() * (point_bytes() + sizeof(annotation)));
+		size_type kept[filter_tile];
+		size_type out = 0;
+		for (size_type first = 0; first < size(); first += filter_tile) {
+			const auto n = std::min(filter_tile, size() - first);
+			const auto count = select_tile(pred, false, first, n, kept);
+			//nothing moves as long as no object was removed
+			if (out != first || count != n) {
+				point_matrix.copy_selected(point_matrix, kept, count, out);
+				annotations.compact(kept, count, out);
+			}
+			out += count;
+		}
+		const auto removed = size() - out;
+		point_matrix.resize(out, uninitialized);
+		annotations.resize(out, uninitialized);
+		return removed;
+	}
+
+	/**
+	 * \brief Copy of all objects for which @p pred returns true, in their original order.
+	 *
+	 * @p pred as in erase_if, the collection itself is not modified.
+	 * A first pass evaluates the predicate once per object into a bit mask,
+	 * the result is then allocated at its final size and filled tile by tile.
+	 */
+	template<class predicate_t>
+	collection filter(const predicate_t& pred) const {
+		GEOM_PROBE(filter, size(), 2 * size() * (point_bytes() + sizeof(annotation)));
+		std::vector<std::uint64_t> mask((size() + 63) / 64);
+		size_type total = 0;
+		for (size_type i = 0; i < size(); ++i) {
+			const bool match = detail::matches(*this, pred, i);
+			mask[i / 64] |= std::uint64_t(match) << (i % 64);
+			total += match;
+		}
+
+		collection result(total, uninitialized, get_allocator());
+		size_type kept[filter_tile];
+		size_type out = 0;
+		for (size_type first = 0; first < size(); first += filter_tile) {
+			const auto last = std::min(first + filter_tile, size());
+			size_type count = 0;
+			for (auto i = first; i < last; ++i) {
+				kept[count] = i;
+				count += (mask[i / 64] >> (i % 64)) & 1;
+			}
+			result.point_matrix.copy_selected(point_matrix, kept, count, out);
+			result.annotations.copy_selected(annotations, kept, count, out);
+			out += count;
+		}
+		return result;
+	}
+
+	/**
+	 * \brief Sorts the objects along the Morton (Z-order) curve through their bounding box.
+	 *
+	 * Objects close in space end up close in memory, which improves the locality
+	 * of neighbourhood based algorithms on the collection.
+	 * Morton keys of the quantized points are computed blockwise, concurrently with a parallel_policy,
+	 * and sorted by radix sort, then points and annotations are permuted in bulk.
+	 * The quantization grid has about 4^dimension cells per object,
+	 * objects sharing a cell keep their relative order.
+	 * \returns permutation applied, element i holds the former position of the object now at i.
+	 */
+	template<class policy_t = sequential_policy>
+	std::vector<size_type> reorder_spatially(policy_t policy = sequential) {
+		GEOM_PROBE(reorder, size(), 3 * size() * (point_bytes() + sizeof(annotation)));
+		std::vector<std::uint64_t> keys(size());
+		std::vector<size_type> order(size());
+		if (empty())
+			return order;
+
+		//finer grids only add radix sort passes without improving locality
+		int bits = 2;
+		while (bits < morton_bits<dimension>::value && (size() >> (bits * dimension - 2 * dimension)) != 0)
+			++bits;
+		//quantize in double, the largest cell index is not representable as float in 2D
+		const double cells = double((std::uint64_t { 1 } << bits) - 1);
+		const auto box = bounds(policy);
+		double lower[dimension], scale[dimension];
+		for (int r = 0; r < dimension; ++r) {
+			lower[r] = double(box.min()[r]);
+			const auto extent = double(box.max()[r]) - lower[r];
+			scale[r] = extent > 0 ? cells / extent : 0;
+		}
+
+		parallel_for_each_block(size(), detail::block_grain<collection>(policy), [&](size_type first, size_type last) {
+			const auto block = point_matrix.block(first, last - first);
+			for (size_type i = first; i < last; ++i) {
+				std::uint32_t c[dimension];
+				for (int r = 0; r < dimension; ++r)
+					c[r] = std::uint32_t(std::min(cells, (double(block.coeff(r, i - first)) - lower[r]) * scale[r]));
+				keys[i] = morton_code(c);
+				order[i] = i;
+			}
+		}, policy);
+		radix_sort_by_key(keys, order);
+
+		decltype(point_matrix) points { get_allocator() };
+		decltype(annotations) meta { get_allocator() };
+		point_matrix.gather(order.data(), order.size(), points);
+		annotations.gather(order.data(), order.size(), meta);
+		point_matrix = std::move(points);
+		annotations = std::move(meta);
+		return order;
+	}
+
+	/**
+	 * \brief Contiguous array of annotation field @p I.
+	 *
+	 * Only available for annotation types stored in columns, see annotation_fields.
+	 * Scans over a single field touch only the memory of that field.
+	 */
+	template<std::size_t I>
+	const auto& column() const noexcept {
+		return annotations.template column<I>();
+	}
+	template<std::size_t I>
+	auto& column() noexcept {
+		return annotations.template column<I>();
+	}
+
+	/// Number of elements in a cache sized block of points and annotations.
+	static constexpr size_type block_size() noexcept {
+		return cache_block_bytes / (sizeof(vector_type) + sizeof(annotation)) > 0 ?
+				cache_block_bytes / (sizeof(vector_type) + sizeof(annotation)) : 1;
+	}
+
 private:
-	friend class point_reference<T> ;
+	friend struct point_reference<collection> ;
+
+	/// writes the increasing positions in [first, first + n) for which @p pred returns @p value, returns their number.
+	template<class predicate_t>
+	size_type select_tile(const predicate_t& pred, bool value, size_type first, size_type n, size_type* positions) const {
+		size_type count = 0;
+		for (auto i = first; i < first + n; ++i) {
+			//branch free, the position is always written and only kept if it matches
+			positions[count] = i;
+			count += detail::matches(*this, pred, i) == value;
+		}
+		return count;
+	}
 
-	std::vector<vector_type> point_matrix;
-	std::vector<annotation> annotations;
+	/// number of objects compacted at once by erase_if and filter, their positions are kept on the stack
+	static constexpr size_type filter_tile = 256;
+
+	/// bytes of point memory per point, for instrumentation
+	static constexpr size_type point_bytes() noexcept {
+		return detail::stored_point_bytes<point_storage<layout, vector_type, allocator_t>>::value;
+	}
+
+	point_storage<layout, vector_type, allocator_t> point_matrix;
+	annotation_storage<annotation, allocator_t> annotations;
 };
 
+template<class T, class layout, class allocator_t>
+constexpr typename collection<T, layout, allocator_t>::size_type collection<T, layout, allocator_t>::filter_tile;
+
+/**
+ * \brief Writes the points of @p src transformed by @p m to @p dst, @p src is not modified.
+ *
+ * Readers may keep using @p src while the transformed points are written.
+ * @p dst is resized to src.size() without initializing, which doesn't allocate
+ * once it held as many points before, e.g. when it is reused every frame.
+ * Annotations are not copied, they stay shared with @p src by position, see transformed_collection.
+ * quantized_layout destinations encode the points with their own quantization.
+ */
+template<class T, class layout, class allocator_t, class matrix_t, class policy_t = sequential_policy>
+void transform_into(const collection<T, layout, allocator_t>& src, const matrix_t& m,
+		point_storage<layout, typename T::vector_type, allocator_t>& dst, policy_t policy = sequential) {
+	using collection_type = collection<T, layout, allocator_t>;
+	using size_type = typename collection_type::size_type;
+	const auto& k = as_transform_kind<collection_type::dimension>(m);
+	detail::check_kind<collection_type>(k);
+	GEOM_PROBE(transform, src.size(), 2 * src.size() * detail::stored_point_bytes<std::decay_t<decltype(dst)>>::value);
+	dst.resize(src.size(), uninitialized);
+	parallel_for_each_block(src.size(), detail::block_grain<collection_type>(policy),
+			[&src, &k, &dst](size_type first, size_type last) {
+				dst.apply(k, first, last - first, src.points());
+			}, policy);
+}
+
+/**
+ * \brief Transformed points of a collection together with the annotations of that collection.
+ *
+ * Destination of transform_into, which writes the points and refers to the annotations of the source
+ * instead of copying them. The source has to outlive the transformed_collection
+ * and must not be resized or reordered while it is used, its annotations are read by position.
+ * Annotations are copied only by to_collection().
+ *
+ * \tparam collection_t instantiation of geom::collection transformed.
+ */
+template<class collection_t>
+class transformed_collection {
+public:
+	using collection_type = collection_t;
+	using value_type = typename collection_t::value_type;
+	using vector_type = typename collection_t::vector_type;
+	using annotation = typename collection_t::annotation;
+	using scalar_type = typename collection_t::scalar_type;
+	static constexpr int dimension = collection_t::dimension;
+	using size_type = typename collection_t::size_type;
+	using allocator_type = typename collection_t::allocator_type;
+	using points_type = std::decay_t<decltype(std::declval<collection_t&>().points())>;
+	using const_reference = value_type;
+	using const_iterator = detail::proxy_iterator<const transformed_collection, const_reference, value_type>;
+	using iterator = const_iterator;
+
+	transformed_collection() = default;
+	explicit transformed_collection(const allocator_type& alloc) :
+			point_matrix(alloc) {
+	}
+	/// Preallocates the points of @p size objects, which refer to no annotations before the first transform_into.
+	transformed_collection(size_type size, uninitialized_t, const allocator_type& alloc = allocator_type()) :
+			point_matrix(size, uninitialized, alloc) {
+	}
+
+	size_type size() const noexcept {
+		return point_matrix.size();
+	}
+	bool empty() const noexcept {
+		return point_matrix.empty();
+	}
+
+	/// Transformed points, owned by this object.
+	const points_type& points() const noexcept {
+		return point_matrix;
+	}
+	points_type& points() noexcept {
+		return point_matrix;
+	}
+
+	/// Collection the points were transformed from, null before the first transform_into.
+	const collection_t* source() const noexcept {
+		return from;
+	}
+	/// Annotations of the source collection.
+	const auto& meta() const noexcept {
+		assert(from);
+		return from->meta();
+	}
+
+	/// Object @p i, assembled from the transformed point and the annotation of the source.
+	value_type operator[](size_type i) const {
+		return value_type { point_matrix[i], meta().load(i) };
+	}
+
+	const_iterator begin() const noexcept {
+		return const_iterator { this, 0 };
+	}
+	const_iterator end() const noexcept {
+		return const_iterator { this, size() };
+	}
+
+	/// Copy of the transformed points with copies of the annotations as self-contained collection.
+	collection_t to_collection() const {
+		collection_t result(size(), uninitialized, point_matrix.get_allocator());
+		result.points() = point_matrix;
+		if (!empty())
+			result.meta() = meta();
+		return result;
+	}
+
+	/// Writes the points of @p src transformed by @p m and refers to the annotations of @p src, see transform_into.
+	template<class matrix_t, class policy_t = sequential_policy>
+	void assign(const collection_t& src, const matrix_t& m, policy_t policy = sequential) {
+		transform_into(src, m, point_matrix, policy);
+		from = &src;
+	}
+
+private:
+	points_type point_matrix;
+	const collection_t* from = nullptr;
+};
+
+template<class collection_t>
+constexpr int transformed_collection<collection_t>::dimension;
+
+/**
+ * \brief Writes the points of @p src transformed by @p m to @p dst, which then refers to the annotations of @p src.
+ *
+ * Points as by the point storage overload, no annotation is copied.
+ */
+template<class T, class layout, class allocator_t, class matrix_t, class policy_t = sequential_policy>
+void transform_into(const collection<T, layout, allocator_t>& src, const matrix_t& m,
+		transformed_collection<collection<T, layout, allocator_t>>& dst, policy_t policy = sequential) {
+	dst.assign(src, m, policy);
+}
+
+/**
+ * \brief Calls @p f(first, last) for cache sized blocks of indices covering collection @p c.
+ *
+ * Points and annotations of a block are accessed through c.points()
+ * and the collection iterators, blocks are disjoint and may be modified concurrently.
+ * With parallel_policy blocks are processed by the threads of the pool,
+ * the grain of the policy overrides the default block size.
+ */
+template<class T, class layout, class allocator_t, class F, class policy_t = parallel_policy>
+void parallel_for_each_block(collection<T, layout, allocator_t>& c, F f, policy_t policy = parallel) {
+	using collection_type = collection<T, layout, allocator_t>;
+	parallel_for_each_block(c.size(), detail::block_grain<collection_type>(policy), std::move(f), policy);
+}
+
 } // namespace geom
 } // namespace fc
 
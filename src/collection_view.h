@@ -0,0 +1,257 @@
+#ifndef GEOM_SRC_COLLECTION_VIEW_H_
+#define GEOM_SRC_COLLECTION_VIEW_H_
+
+//This header contains collection_view, a subset of the objects of a geom::collection
+//given by their positions, which is transformed, reduced and filtered without copying the collection.
+
+#include "collection.h"
+#include "instrument.h"
+#include "reduction.h"
+#include "thread_pool.h"
+#include "transform_kinds.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace fc
+{
+namespace geom
+{
+
+/**
+ * \brief Subset of the objects of a geom::collection, stored as increasing positions.
+ *
+ * A view refers to the collection it was created from, which has to outlive the view
+ * and must not be resized or reordered while the view is used.
+ * Iteration yields point_reference proxies to the objects in the collection,
+ * transform() modifies the viewed points in place.
+ * filter() and operator& narrow a view further without touching the collection,
+ * to_collection() copies the viewed objects once they are needed as a collection.
+ *
+ * \tparam collection_t instantiation of geom::collection viewed.
+ */
+template<class collection_t>
+class collection_view {
+public:
+	using collection_type = collection_t;
+	using value_type = typename collection_t::value_type;
+	using vector_type = typename collection_t::vector_type;
+	using annotation = typename collection_t::annotation;
+	using scalar_type = typename collection_t::scalar_type;
+	static constexpr int dimension = collection_t::dimension;
+	using size_type = typename collection_t::size_type;
+	using reference = point_reference<collection_t>;
+	using const_reference = value_type;
+	using iterator = detail::proxy_iterator<collection_view, reference, value_type>;
+	using const_iterator = detail::proxy_iterator<const collection_view, const_reference, value_type>;
+
+	/// View of all objects of @p c.
+	explicit collection_view(collection_t& c) :
+			source { &c }, positions(c.size()) {
+		std::iota(positions.begin(), positions.end(), size_type(0));
+	}
+	/// View of the objects of @p c at the increasing positions @p indices.
+	collection_view(collection_t& c, std::vector<size_type> indices) :
+			source { &c }, positions(std::move(indices)) {
+		assert(std::is_sorted(positions.begin(), positions.end()));
+	}
+	/// View of the objects of @p c whose flag in @p mask is set, @p mask holds one flag per object.
+	collection_view(collection_t& c, const std::vector<bool>& mask) :
+			source { &c }, positions(mask.size()) {
+		assert(mask.size() == c.size());
+		size_type count = 0;
+		for (size_type i = 0; i < mask.size(); ++i) {
+			positions[count] = i;
+			count += mask[i];
+		}
+		positions.resize(count);
+	}
+
+	size_type size() const noexcept {
+		return positions.size();
+	}
+	bool empty() const noexcept {
+		return positions.empty();
+	}
+
+	/// Collection the view refers to.
+	collection_t& base() const noexcept {
+		return *source;
+	}
+	/// Increasing positions of the viewed objects in the collection.
+	const std::vector<size_type>& indices() const noexcept {
+		return positions;
+	}
+	/// One flag per object of the collection, set for the viewed objects.
+	std::vector<bool> mask() const {
+		std::vector<bool> flags(source->size());
+		for (const auto i : positions)
+			flags[i] = true;
+		return flags;
+	}
+
+	/// Proxy of the @p k th viewed object.
+	reference operator[](size_type k) {
+		return reference { source, positions[k] };
+	}
+	const_reference operator[](size_type k) const {
+		const collection_t& c = *source;
+		return value_type { c.points()[positions[k]], c.meta().load(positions[k]) };
+	}
+
+	iterator begin() noexcept {
+		return iterator { this, 0 };
+	}
+	iterator end() noexcept {
+		return iterator { this, size() };
+	}
+	const_iterator begin() const noexcept {
+		return const_iterator { this, 0 };
+	}
+	const_iterator end() const noexcept {
+		return const_iterator { this, size() };
+	}
+
+	/**
+	 * \brief View of the objects of this view for which @p pred returns true.
+	 *
+	 * @p pred as in collection::erase_if, it is only evaluated for the viewed objects.
+	 */
+	template<class predicate_t>
+	collection_view filter(const predicate_t& pred) const {
+		GEOM_PROBE(filter, size(), size() * (point_bytes() + sizeof(annotation)));
+		std::vector<size_type> kept(size());
+		size_type count = 0;
+		for (const auto i : positions) {
+			//branch free, the position is always written and only kept if it matches
+			kept[count] = i;
+			count += detail::matches(*source, pred, i);
+		}
+		kept.resize(count);
+		return collection_view { *source, std::move(kept) };
+	}
+
+	/// Objects contained in both views, which have to view the same collection.
+	friend collection_view operator&(const collection_view& l, const collection_view& r) {
+		assert(l.source == r.source);
+		std::vector<size_type> both;
+		both.reserve(std::min(l.size(), r.size()));
+		std::set_intersection(l.positions.begin(), l.positions.end(), r.positions.begin(), r.positions.end(),
+				std::back_inserter(both));
+		return collection_view { *l.source, std::move(both) };
+	}
+
+	/**
+	 * \brief Applies transformation @p m to the viewed points, see collection::transform.
+	 *
+	 * Runs of consecutive positions are passed to the point kernel as one block,
+	 * a view of a contiguous region is thus transformed as fast as the collection itself.
+	 */
+	template<class matrix_t, class policy_t = sequential_policy>
+	void transform(const matrix_t& m, policy_t policy = sequential) {
+		GEOM_PROBE(transform, size(), 2 * size() * point_bytes());
+		const auto& k = as_transform_kind<collection_t::dimension>(m);
+		detail::check_kind<collection_t>(k);
+		auto& points = source->points();
+		parallel_for_each_block(size(), detail::block_grain<collection_t>(policy), [this, &k, &points](size_type first, size_type last) {
+			for_each_run(first, last, [&k, &points](size_type position, size_type count) {
+				points.apply(k, position, count);
+			});
+		}, policy);
+	}
+
+	/// Bounding box, centroid and covariance of the viewed points, see collection::statistics.
+	template<class policy_t = sequential_policy>
+	point_statistics<scalar_type, dimension> statistics(policy_t policy = sequential) const {
+		GEOM_PROBE(statistics, size(), size() * point_bytes());
+		const auto block = detail::block_grain<collection_t>(policy);
+		std::vector<point_statistics<scalar_type, dimension>> partial((size() + block - 1) / block);
+		parallel_for_each_block(size(), block, [this, &partial, block](size_type first, size_type last) {
+			partial[first / block] = gathered_statistics(first, last);
+		}, policy);
+
+		point_statistics<scalar_type, dimension> result { };
+		for (auto&& p : partial)
+			result += p;
+		return result;
+	}
+
+	template<class policy_t = sequential_policy>
+	auto bounds(policy_t policy = sequential) const {
+		return statistics(policy).bounds;
+	}
+	template<class policy_t = sequential_policy>
+	auto centroid(policy_t policy = sequential) const {
+		return statistics(policy).mean;
+	}
+	template<class policy_t = sequential_policy>
+	auto covariance(policy_t policy = sequential) const {
+		return statistics(policy).covariance();
+	}
+
+	/// Copy of the viewed objects as collection, in the order of the view.
+	collection_t to_collection() const {
+		collection_t result { source->get_allocator() };
+		source->points().gather(positions.data(), size(), result.points());
+		source->meta().gather(positions.data(), size(), result.meta());
+		return result;
+	}
+
+private:
+	/// number of viewed points gathered at once by statistics
+	static constexpr size_type gather_tile = 256;
+
+	/// bytes of point memory per point, for instrumentation
+	static constexpr size_type point_bytes() noexcept {
+		return detail::stored_point_bytes<std::decay_t<decltype(std::declval<collection_t&>().points())>>::value;
+	}
+
+	/// calls @p f(position, count) for the maximal runs of consecutive positions among positions[first, last).
+	template<class F>
+	void for_each_run(size_type first, size_type last, F f) const {
+		while (first < last) {
+			size_type run = 1;
+			while (first + run < last && positions[first + run] == positions[first] + run)
+				++run;
+			f(positions[first], run);
+			first += run;
+		}
+	}
+
+	/// statistics of the viewed points [first, last), gathered tile by tile into a dense block.
+	point_statistics<scalar_type, dimension> gathered_statistics(size_type first, size_type last) const {
+		const auto& points = static_cast<const collection_t&>(*source).points();
+		Eigen::Matrix<scalar_type, dimension, gather_tile> tile;
+		point_statistics<scalar_type, dimension> result { };
+		for (; first < last; first += gather_tile) {
+			const auto count = std::min(gather_tile, last - first);
+			for (size_type j = 0; j < count; ++j)
+				tile.col(j) = points[positions[first + j]];
+			result += detail::block_statistics(tile.leftCols(count));
+		}
+		return result;
+	}
+
+	collection_t* source;
+	std::vector<size_type> positions;
+};
+
+template<class collection_t>
+constexpr typename collection_view<collection_t>::size_type collection_view<collection_t>::gather_tile;
+
+/// View of all objects of collection @p c, e.g. view(c).filter(by_point(inside)).
+template<class T, class layout, class allocator_t>
+collection_view<collection<T, layout, allocator_t>> view(collection<T, layout, allocator_t>& c) {
+	return collection_view<collection<T, layout, allocator_t>> { c };
+}
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_COLLECTION_VIEW_H_ */
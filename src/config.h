@@ -14,6 +14,15 @@
 
 #include <eigen3/Eigen/Eigen>
 
+//Define GEOM_PAD_VECTOR3F to store Vector3f points padded to four aligned lanes
+//in geom::collection by default (see padded_layout in storage.h).
+//This trades one third more memory for aligned vector loads in the transform kernels.
+//#define GEOM_PAD_VECTOR3F
+
+//Define GEOM_INSTRUMENT to count calls, points, bytes and time of the operations of geom
+//(see instrument.h). Without it the probes are removed at compile time.
+//#define GEOM_INSTRUMENT
+
 namespace fc
 {
 namespace geom
@@ -32,6 +41,10 @@ using Vector4f = Eigen::Vector4f;
 using Transformf = Eigen::Affine3f;
 using Transformd = Eigen::Affine3d;
 
+/// Size in bytes of the blocks parallel algorithms split collections into.
+/// Chosen such that a block of points and annotations fits comfortably into L2.
+constexpr std::size_t cache_block_bytes = 256 * 1024;
+
 } // namespace geom
 } // namespace fc
 
@@ -0,0 +1,323 @@
+#ifndef GEOM_SRC_CULLING_H_
+#define GEOM_SRC_CULLING_H_
+
+//This header contains culling of geom::collection against volumes:
+//convex_volume, the intersection of half-spaces such as a view frustum or an oriented box,
+//and Eigen::AlignedBox.
+//
+//  const auto frustum = convex_volume<double, 3>::frustum(projection * view);
+//  const auto visible = cull(c, frustum);          //increasing positions of the points inside
+//  collection_view<decltype(c)> v { c, visible };
+//  cull_in_place(c, frustum);                      //removes the objects outside
+//  const auto near = cull(tree, frustum);          //same positions, pruned by a kd_tree of c
+//
+//Points are tested tile by tile with one pass per plane, which the compiler vectorizes for soa_layout.
+
+#include "collection.h"
+#include "instrument.h"
+#include "kd_tree.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace fc
+{
+namespace geom
+{
+
+/**
+ * \brief Intersection of half-spaces, given as hyperplanes with normals pointing inside.
+ *
+ * A point p is inside if plane.signedDistance(p) >= 0 for all planes,
+ * a volume without planes contains all points.
+ */
+template<class scalar_t, int dim>
+class convex_volume {
+public:
+	using scalar_type = scalar_t;
+	static constexpr int dimension = dim;
+	using vector_type = Eigen::Matrix<scalar_t, dim, 1>;
+	using plane_type = Eigen::Hyperplane<scalar_t, dim>;
+	using plane_list = std::vector<plane_type, Eigen::aligned_allocator<plane_type>>;
+	using box_type = Eigen::AlignedBox<scalar_t, dim>;
+
+	convex_volume() = default;
+	explicit convex_volume(plane_list planes) :
+			bounding_planes(std::move(planes)) {
+	}
+
+	/**
+	 * \brief View frustum of the projection @p view_projection in OpenGL convention.
+	 *
+	 * Points with clip coordinates -w <= x, y, z <= w are inside, the planes are normalized.
+	 */
+	static convex_volume frustum(const Eigen::Matrix<scalar_t, dim + 1, dim + 1>& view_projection) {
+		plane_list planes;
+		for (int r = 0; r < dim; ++r) {
+			add_normalized(planes, view_projection.row(dim) + view_projection.row(r));
+			add_normalized(planes, view_projection.row(dim) - view_projection.row(r));
+		}
+		return convex_volume { std::move(planes) };
+	}
+
+	/// Oriented box, the image of the cube [-1, 1]^dim under @p box.
+	static convex_volume oriented_box(const Eigen::Transform<scalar_t, dim, Eigen::Affine>& box) {
+		const Eigen::Matrix<scalar_t, dim + 1, dim + 1> to_cube = box.inverse().matrix();
+		plane_list planes;
+		for (int r = 0; r < dim; ++r) {
+			//-1 <= row r of to_cube * [p, 1] <= 1
+			Eigen::Matrix<scalar_t, 1, dim + 1> row = to_cube.row(r);
+			row[dim] += 1;
+			add_normalized(planes, row);
+			row = -to_cube.row(r);
+			row[dim] += 1;
+			add_normalized(planes, row);
+		}
+		return convex_volume { std::move(planes) };
+	}
+
+	const plane_list& planes() const noexcept {
+		return bounding_planes;
+	}
+
+	bool contains(const vector_type& p) const {
+		for (const auto& plane : bounding_planes) {
+			auto s = plane.offset();
+			for (int r = 0; r < dim; ++r)
+				s += plane.normal()[r] * p[r];
+			if (s < 0)
+				return false;
+		}
+		return true;
+	}
+
+	/**
+	 * \brief Containment of axis aligned box @p box.
+	 *
+	 * Conservative, a box outside of the volume but not of any single plane is reported as intersecting.
+	 */
+	containment classify(const box_type& box) const {
+		auto result = containment::inside;
+		for (const auto& plane : bounding_planes) {
+			//corners of the box farthest inside and farthest outside of the plane
+			auto far_in = plane.offset(), far_out = plane.offset();
+			for (int r = 0; r < dim; ++r) {
+				const auto n = plane.normal()[r];
+				far_in += n * (n >= 0 ? box.max()[r] : box.min()[r]);
+				far_out += n * (n >= 0 ? box.min()[r] : box.max()[r]);
+			}
+			if (far_in < 0)
+				return containment::outside;
+			if (far_out < 0)
+				result = containment::intersecting;
+		}
+		return result;
+	}
+
+	/// Sets flags[i] to 1 if point i of @p block (one point per column) is inside, to 0 otherwise.
+	template<class block_t>
+	void inside(const block_t& block, std::uint8_t* flags) const {
+		const auto n = block.cols();
+		std::fill(flags, flags + n, std::uint8_t { 1 });
+		for (const auto& plane : bounding_planes) {
+			scalar_t normal[dim];
+			for (int r = 0; r < dim; ++r)
+				normal[r] = plane.normal()[r];
+			const auto offset = plane.offset();
+			for (Eigen::Index i = 0; i < n; ++i) {
+				auto s = offset;
+				for (int r = 0; r < dim; ++r)
+					s += normal[r] * block.coeff(r, i);
+				flags[i] &= std::uint8_t(s >= 0);
+			}
+		}
+	}
+
+private:
+	template<class row_t>
+	static void add_normalized(plane_list& planes, const row_t& coefficients) {
+		plane_type plane;
+		plane.coeffs() = coefficients.transpose();
+		const auto length = plane.normal().norm();
+		if (length > 0)
+			plane.coeffs() /= length;
+		planes.push_back(plane);
+	}
+
+	plane_list bounding_planes;
+};
+
+template<class scalar_t, int dim>
+constexpr int convex_volume<scalar_t, dim>::dimension;
+
+namespace detail
+{
+
+/// number of points tested at once by the culling kernels
+constexpr std::size_t cull_tile = 256;
+
+template<class scalar_t, int dim, class block_t>
+void inside(const convex_volume<scalar_t, dim>& volume, const block_t& block, std::uint8_t* flags) {
+	volume.inside(block, flags);
+}
+
+template<class scalar_t, int dim, class block_t>
+void inside(const Eigen::AlignedBox<scalar_t, dim>& volume, const block_t& block, std::uint8_t* flags) {
+	scalar_t lower[dim], upper[dim];
+	for (int r = 0; r < dim; ++r) {
+		lower[r] = volume.min()[r];
+		upper[r] = volume.max()[r];
+	}
+	for (Eigen::Index i = 0; i < block.cols(); ++i) {
+		std::uint8_t in = 1;
+		for (int r = 0; r < dim; ++r)
+			in &= std::uint8_t(lower[r] <= block.coeff(r, i)) & std::uint8_t(block.coeff(r, i) <= upper[r]);
+		flags[i] = in;
+	}
+}
+
+template<class scalar_t, int dim, class vector_t>
+bool contains(const convex_volume<scalar_t, dim>& volume, const vector_t& p) {
+	return volume.contains(p);
+}
+
+template<class scalar_t, int dim, class vector_t>
+bool contains(const Eigen::AlignedBox<scalar_t, dim>& volume, const vector_t& p) {
+	return volume.contains(p);
+}
+
+template<class scalar_t, int dim>
+containment classify(const convex_volume<scalar_t, dim>& volume, const Eigen::AlignedBox<scalar_t, dim>& box) {
+	return volume.classify(box);
+}
+
+template<class scalar_t, int dim>
+containment classify(const Eigen::AlignedBox<scalar_t, dim>& volume, const Eigen::AlignedBox<scalar_t, dim>& box) {
+	if (volume.contains(box))
+		return containment::inside;
+	return volume.intersects(box) ? containment::intersecting : containment::outside;
+}
+
+} // namespace detail
+
+/**
+ * \brief Increasing positions of the points of collection @p c inside @p volume.
+ *
+ * \param volume convex_volume or Eigen::AlignedBox.
+ * \param policy sequential by default, blocks of points are tested concurrently with parallel_policy.
+ */
+template<class collection_t, class volume_t, class policy_t = sequential_policy>
+std::vector<typename collection_t::size_type> cull(const collection_t& c, const volume_t& volume,
+		policy_t policy = sequential) {
+	using size_type = typename collection_t::size_type;
+	GEOM_PROBE(cull, c.size(), c.size() * detail::stored_point_bytes<std::decay_t<decltype(c.points())>>::value);
+	const auto grain = detail::block_grain<collection_t>(policy);
+	std::vector<size_type> positions(c.size());
+	std::vector<size_type> counts((c.size() + grain - 1) / grain);
+	//every block compacts its positions to the start of its own range
+	parallel_for_each_block(c.size(), grain, [&](size_type first, size_type last) {
+		std::uint8_t flags[detail::cull_tile];
+		auto out = first;
+		for (auto tile = first; tile < last; tile += detail::cull_tile) {
+			const auto count = std::min(detail::cull_tile, last - tile);
+			detail::inside(volume, c.points().block(tile, count), flags);
+			for (size_type i = 0; i < count; ++i) {
+				positions[out] = tile + i;
+				out += flags[i];
+			}
+		}
+		counts[first / grain] = out - first;
+	}, policy);
+
+	size_type total = 0;
+	for (size_type b = 0; b < counts.size(); ++b) {
+		const auto first = positions.begin() + b * grain;
+		std::copy(first, first + counts[b], positions.begin() + total);
+		total += counts[b];
+	}
+	positions.resize(total);
+	return positions;
+}
+
+/// One flag per object of @p c, set for the points inside @p volume, see cull.
+template<class collection_t, class volume_t, class policy_t = sequential_policy>
+std::vector<bool> cull_mask(const collection_t& c, const volume_t& volume, policy_t policy = sequential) {
+	std::vector<bool> mask(c.size());
+	for (const auto i : cull(c, volume, policy))
+		mask[i] = true;
+	return mask;
+}
+
+/**
+ * \brief Tests the points of @p c against up to 32 volumes in one pass.
+ *
+ * Bit k of element i of the result is set if point i is inside volumes[k].
+ * Cheaper than culling against every volume in turn when the points don't fit into cache,
+ * e.g. for the frusta of several cameras.
+ */
+template<class collection_t, class volume_t, class policy_t = sequential_policy>
+std::vector<std::uint32_t> cull_bits(const collection_t& c, const std::vector<volume_t>& volumes,
+		policy_t policy = sequential) {
+	using size_type = typename collection_t::size_type;
+	assert(volumes.size() <= 32);
+	GEOM_PROBE(cull, c.size(), c.size() * detail::stored_point_bytes<std::decay_t<decltype(c.points())>>::value);
+	std::vector<std::uint32_t> bits(c.size());
+	parallel_for_each_block(c.size(), detail::block_grain<collection_t>(policy), [&](size_type first, size_type last) {
+		std::uint8_t flags[detail::cull_tile];
+		for (auto tile = first; tile < last; tile += detail::cull_tile) {
+			const auto count = std::min(detail::cull_tile, last - tile);
+			const auto block = c.points().block(tile, count);
+			for (std::size_t k = 0; k < volumes.size(); ++k) {
+				detail::inside(volumes[k], block, flags);
+				for (size_type i = 0; i < count; ++i)
+					bits[tile + i] |= std::uint32_t(flags[i]) << k;
+			}
+		}
+	}, policy);
+	return bits;
+}
+
+/**
+ * \brief Removes all objects of @p c whose points are outside @p volume.
+ *
+ * The relative order of the remaining objects is preserved, see collection::erase_if.
+ * \returns number of removed objects.
+ */
+template<class collection_t, class volume_t, class policy_t = sequential_policy>
+typename collection_t::size_type cull_in_place(collection_t& c, const volume_t& volume,
+		policy_t policy = sequential) {
+	const auto kept = cull(c, volume, policy);
+	const auto removed = c.size() - kept.size();
+	c.points().select(kept.data(), kept.size());
+	c.meta().select(kept.data(), kept.size());
+	return removed;
+}
+
+/**
+ * \brief Increasing positions of the points inside @p volume of the collection @p tree was built from.
+ *
+ * Subtrees entirely inside or outside of the volume are resolved without testing their points,
+ * which pays off for volumes containing or excluding large parts of the collection.
+ * The result equals cull on the collection.
+ */
+template<class collection_t, class volume_t>
+std::vector<typename collection_t::size_type> cull(const kd_tree<collection_t>& tree, const volume_t& volume) {
+	using tree_type = kd_tree<collection_t>;
+	//the memory visited is added by select
+	GEOM_PROBE(cull, tree.size(), 0);
+	return tree.select([&volume](const typename tree_type::box_type& box) {
+		return detail::classify(volume, box);
+	}, [&volume](const typename tree_type::vector_type& p) {
+		return detail::contains(volume, p);
+	});
+}
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_CULLING_H_ */
@@ -0,0 +1,302 @@
+#ifndef GEOM_SRC_INSTRUMENT_H_
+#define GEOM_SRC_INSTRUMENT_H_
+
+//This header contains the optional instrumentation of the operations of geom.
+//With GEOM_INSTRUMENT defined (see config.h) every instrumented operation counts its calls,
+//points processed, bytes of memory touched, wall time and time stamp counter cycles.
+//Without it GEOM_PROBE expands to nothing and its arguments are not evaluated.
+//
+//  const auto before = instrumentation_snapshot();
+//  run_pipeline();
+//  const auto spent = instrumentation_snapshot() - before;
+//  std::cout << spent[operation::transform].points << " points transformed in "
+//            << spent[operation::transform].nanoseconds << " ns\n";
+//
+//Counters are kept per thread and written without locks or atomic read-modify-write,
+//snapshots sum the counters of all running threads and the totals of finished ones.
+//Time of nested operations, e.g. the cull within cull_in_place, is included in the enclosing one.
+//Operations which learn the memory they touched only while running, e.g. kd_tree queries,
+//add it to the innermost probe of the thread with GEOM_PROBE_BYTES.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace fc
+{
+namespace geom
+{
+
+/// Instrumented operations.
+enum class operation : std::size_t {
+	transform, ///< point transformations of collection and collection_view
+	statistics, ///< point reductions
+	filter, ///< erase_if, filter and collection_view::filter
+	reorder, ///< reorder_spatially
+	cull, ///< culling against volumes
+	tree_build, ///< kd_tree construction
+	tree_query, ///< kd_tree queries
+	io, ///< chunked reading and writing of collection files
+	allocation, ///< allocations of point and annotation storage, points counts elements
+};
+
+constexpr std::size_t operation_count = std::size_t(operation::allocation) + 1;
+
+#ifdef GEOM_INSTRUMENT
+constexpr bool instrumentation_enabled = true;
+#else
+constexpr bool instrumentation_enabled = false;
+#endif
+
+inline const char* operation_name(operation op) noexcept {
+	static const char* const names[operation_count] = { "transform", "statistics", "filter", "reorder",
+			"cull", "tree_build", "tree_query", "io", "allocation" };
+	return names[std::size_t(op)];
+}
+
+/// Counters of one operation.
+struct operation_counters {
+	std::uint64_t calls = 0;
+	std::uint64_t points = 0;
+	std::uint64_t bytes = 0;
+	std::uint64_t nanoseconds = 0;
+	/// time stamp counter cycles, zero on platforms without one
+	std::uint64_t cycles = 0;
+
+	operation_counters& operator+=(const operation_counters& o) noexcept {
+		calls += o.calls;
+		points += o.points;
+		bytes += o.bytes;
+		nanoseconds += o.nanoseconds;
+		cycles += o.cycles;
+		return *this;
+	}
+	operation_counters& operator-=(const operation_counters& o) noexcept {
+		calls -= o.calls;
+		points -= o.points;
+		bytes -= o.bytes;
+		nanoseconds -= o.nanoseconds;
+		cycles -= o.cycles;
+		return *this;
+	}
+};
+
+/// Counters of all operations summed over all threads, see instrumentation_snapshot.
+struct instrument_snapshot {
+	std::array<operation_counters, operation_count> counters { };
+
+	const operation_counters& operator[](operation op) const noexcept {
+		return counters[std::size_t(op)];
+	}
+
+	/// Counts between snapshot @p earlier and this one.
+	instrument_snapshot operator-(const instrument_snapshot& earlier) const noexcept {
+		auto result = *this;
+		for (std::size_t i = 0; i < operation_count; ++i)
+			result.counters[i] -= earlier.counters[i];
+		return result;
+	}
+};
+
+namespace detail
+{
+
+/**
+ * \brief Counters of one thread.
+ *
+ * Only the owning thread writes, with relaxed loads and stores,
+ * snapshots read concurrently with relaxed loads.
+ */
+struct thread_counters {
+	static constexpr std::size_t fields = 5;
+	std::atomic<std::uint64_t> values[operation_count][fields] { };
+
+	void add(operation op, const std::uint64_t (&amounts)[fields]) noexcept {
+		auto& row = values[std::size_t(op)];
+		for (std::size_t f = 0; f < fields; ++f)
+			row[f].store(row[f].load(std::memory_order_relaxed) + amounts[f], std::memory_order_relaxed);
+	}
+
+	operation_counters load(operation op) const noexcept {
+		const auto& row = values[std::size_t(op)];
+		operation_counters result;
+		result.calls = row[0].load(std::memory_order_relaxed);
+		result.points = row[1].load(std::memory_order_relaxed);
+		result.bytes = row[2].load(std::memory_order_relaxed);
+		result.nanoseconds = row[3].load(std::memory_order_relaxed);
+		result.cycles = row[4].load(std::memory_order_relaxed);
+		return result;
+	}
+};
+
+/// Counters of all running threads and the totals of finished threads.
+class counter_registry {
+public:
+	void add_thread(thread_counters& t) {
+		std::lock_guard<std::mutex> lock { mutex };
+		threads.push_back(&t);
+	}
+
+	/// folds the counts of finishing thread @p t into the retired totals.
+	void remove_thread(const thread_counters& t) {
+		std::lock_guard<std::mutex> lock { mutex };
+		for (std::size_t i = 0; i < operation_count; ++i)
+			retired.counters[i] += t.load(operation(i));
+		threads.erase(std::find(threads.begin(), threads.end(), &t));
+	}
+
+	instrument_snapshot snapshot() const {
+		std::lock_guard<std::mutex> lock { mutex };
+		instrument_snapshot result = retired;
+		for (const auto t : threads)
+			for (std::size_t i = 0; i < operation_count; ++i)
+				result.counters[i] += t->load(operation(i));
+		return result;
+	}
+
+	void reset() {
+		std::lock_guard<std::mutex> lock { mutex };
+		retired = instrument_snapshot { };
+		for (const auto t : threads)
+			for (auto& row : t->values)
+				for (auto& v : row)
+					v.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	mutable std::mutex mutex;
+	std::vector<thread_counters*> threads;
+	instrument_snapshot retired;
+};
+
+/// registry of all threads, never destroyed as pool workers
+/// release their counters after static destruction has begun.
+inline counter_registry& counters() {
+	static counter_registry& registry = *new counter_registry;
+	return registry;
+}
+
+/// counters of one thread, registered while the thread runs.
+struct registered_counters {
+	registered_counters() {
+		counters().add_thread(values);
+	}
+	~registered_counters() {
+		counters().remove_thread(values);
+	}
+	registered_counters(const registered_counters&) = delete;
+	registered_counters& operator=(const registered_counters&) = delete;
+
+	thread_counters values;
+};
+
+/// counters of the calling thread, registered on first use
+inline thread_counters& local_counters() {
+	thread_local registered_counters local;
+	return local.values;
+}
+
+inline std::uint64_t cycle_count() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+} // namespace detail
+
+/// Counters of all instrumented operations so far, all zero without GEOM_INSTRUMENT.
+inline instrument_snapshot instrumentation_snapshot() {
+	return detail::counters().snapshot();
+}
+
+/// Sets all counters to zero, counts of operations running concurrently may be lost.
+inline void reset_instrumentation() {
+	detail::counters().reset();
+}
+
+/**
+ * \brief Measures the enclosing scope as one call of an operation.
+ *
+ * Usually created by GEOM_PROBE, which removes it unless GEOM_INSTRUMENT is defined.
+ */
+class scoped_probe {
+public:
+	scoped_probe(operation op, std::uint64_t points, std::uint64_t bytes) noexcept :
+			op { op }, points { points }, bytes { bytes }, enclosing { innermost() },
+			start { std::chrono::steady_clock::now() }, start_cycles { detail::cycle_count() } {
+		innermost() = this;
+	}
+	~scoped_probe() {
+		const auto cycles = detail::cycle_count() - start_cycles;
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start).count();
+		innermost() = enclosing;
+		detail::local_counters().add(op, { 1, points, bytes, std::uint64_t(elapsed), cycles });
+	}
+
+	scoped_probe(const scoped_probe&) = delete;
+	scoped_probe& operator=(const scoped_probe&) = delete;
+
+	/// Adds @p amount to the bytes of the innermost probe of the calling thread, if there is one.
+	static void add_bytes(std::uint64_t amount) noexcept {
+		if (const auto probe = innermost())
+			probe->bytes += amount;
+	}
+
+private:
+	static scoped_probe*& innermost() noexcept {
+		thread_local scoped_probe* probe = nullptr;
+		return probe;
+	}
+
+	operation op;
+	std::uint64_t points, bytes;
+	scoped_probe* enclosing;
+	std::chrono::steady_clock::time_point start;
+	std::uint64_t start_cycles;
+};
+
+} // namespace geom
+} // namespace fc
+
+#define GEOM_PROBE_CONCAT_(a, b) a##b
+#define GEOM_PROBE_NAME_(line) GEOM_PROBE_CONCAT_(geom_probe_, line)
+
+/**
+ * \brief Counts the enclosing scope as call of operation @p op processing @p points and touching @p bytes.
+ *
+ * @p op is an enumerator of geom::operation without qualification.
+ * Expands to nothing unless GEOM_INSTRUMENT is defined.
+ */
+#ifdef GEOM_INSTRUMENT
+#define GEOM_PROBE(op, points, bytes) \
+	::fc::geom::scoped_probe GEOM_PROBE_NAME_(__LINE__) { ::fc::geom::operation::op, \
+		std::uint64_t(points), std::uint64_t(bytes) }
+#else
+#define GEOM_PROBE(op, points, bytes) static_cast<void>(0)
+#endif
+
+/**
+ * \brief Adds @p bytes of memory touched to the innermost probe running on the calling thread.
+ *
+ * For operations which know their memory traffic only at the end, e.g. the nodes visited by a query.
+ * @p bytes is not evaluated unless GEOM_INSTRUMENT is defined.
+ */
+#ifdef GEOM_INSTRUMENT
+#define GEOM_PROBE_BYTES(bytes) ::fc::geom::scoped_probe::add_bytes(std::uint64_t(bytes))
+#else
+#define GEOM_PROBE_BYTES(bytes) static_cast<void>(sizeof(bytes))
+#endif
+
+#endif /* GEOM_SRC_INSTRUMENT_H_ */
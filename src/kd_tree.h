@@ -0,0 +1,413 @@
+#ifndef GEOM_SRC_KD_TREE_H_
+#define GEOM_SRC_KD_TREE_H_
+
+#include "collection.h"
+#include "instrument.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace fc
+{
+namespace geom
+{
+
+/// Relation of a region, e.g. the bounds of a kd_tree node, to a query volume.
+enum class containment {
+	outside, intersecting, inside
+};
+
+/**
+ * \brief k-d tree spatial index over the points of a geom::collection.
+ *
+ * The tree keeps a copy of the points in tree order next to the flat node array,
+ * such that queries touch contiguous memory only.
+ * Queries return indices into the collection the tree was built from,
+ * the annotations of a result are thus reachable through collection::begin() + index.
+ * The tree does not observe the collection, it has to be rebuilt when points change.
+ *
+ * \tparam collection_t instantiation of geom::collection the tree is built from.
+ */
+template<class collection_t>
+class kd_tree {
+public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+	using size_type = typename collection_t::size_type;
+	using scalar_type = typename collection_t::scalar_type;
+	static constexpr int dimension = collection_t::dimension;
+	using vector_type = Eigen::Matrix<scalar_type, dimension, 1>;
+	using box_type = Eigen::AlignedBox<scalar_type, dimension>;
+
+	/// Marks missing neighbours in results of batched knn queries.
+	static constexpr size_type npos = std::numeric_limits<size_type>::max();
+
+	/**
+	 * \brief Builds tree over all points of @p c.
+	 *
+	 * \param leaf_size maximum number of points stored in a leaf.
+	 * \param policy sequential by default, with parallel_policy the upper levels are built sequentially
+	 * and the remaining subtrees concurrently.
+	 */
+	template<class policy_t = sequential_policy>
+	explicit kd_tree(const collection_t& c, size_type leaf_size = 16, policy_t policy = sequential) :
+			leaf_size { std::max<size_type>(leaf_size, 1) },
+			indices(c.size()), points(c.size()) {
+		GEOM_PROBE(tree_build, c.size(), c.size() * (sizeof(vector_type) + sizeof(size_type)));
+		std::iota(indices.begin(), indices.end(), size_type { 0 });
+		std::vector<vector_type, Eigen::aligned_allocator<vector_type>> source(c.size());
+		for (size_type i = 0; i < c.size(); ++i) {
+			source[i] = c.points()[i];
+			root_bounds.extend(source[i]);
+		}
+
+		nodes.resize(node_count(c.size()));
+		if (c.empty())
+			return;
+
+		std::vector<subtree> frontier;
+		build_top(source, 0, 0, c.size(), top_levels(policy), frontier);
+		parallel_for_each_block(frontier.size(), 1, [&](size_type first, size_type last) {
+			for (auto i = first; i < last; ++i)
+				build(source, frontier[i].node, frontier[i].begin, frontier[i].end);
+		}, policy);
+
+		for (size_type i = 0; i < c.size(); ++i)
+			points[i] = source[indices[i]];
+	}
+
+	size_type size() const noexcept {
+		return indices.size();
+	}
+	bool empty() const noexcept {
+		return indices.empty();
+	}
+
+	/// Bounding box of all points, empty for an empty tree.
+	const box_type& bounds() const noexcept {
+		return root_bounds;
+	}
+
+	/// Indices of the @p k nearest neighbours of @p query, sorted by increasing distance.
+	std::vector<size_type> knn(const vector_type& query, size_type k) const {
+		GEOM_PROBE(tree_query, 1, 0);
+		std::vector<std::pair<scalar_type, size_type>> heap;
+		const auto touched = knn_search(query, k, heap);
+		GEOM_PROBE_BYTES(touched);
+		std::sort_heap(heap.begin(), heap.end());
+		std::vector<size_type> result(heap.size());
+		std::transform(heap.begin(), heap.end(), result.begin(),
+				[this](const auto& h) { return indices[h.second]; });
+		return result;
+	}
+
+	/// Indices of all points within distance @p radius of @p query, in no particular order.
+	std::vector<size_type> radius(const vector_type& query, scalar_type radius) const {
+		GEOM_PROBE(tree_query, 1, 0);
+		std::vector<size_type> result;
+		const auto touched = radius_search(query, radius * radius, result);
+		GEOM_PROBE_BYTES(touched);
+		return result;
+	}
+
+	/**
+	 * \brief k nearest neighbours of every point in @p queries.
+	 *
+	 * \param queries random access range of points, e.g. collection::points().
+	 * Blocks of queries run concurrently if @p policy is a parallel_policy.
+	 * \returns flat array of queries.size() * k indices,
+	 * the neighbours of query i start at i * k and are padded with npos.
+	 */
+	template<class query_range, class policy_t = sequential_policy>
+	std::vector<size_type> knn(const query_range& queries, size_type k,
+			policy_t policy = sequential) const {
+		GEOM_PROBE(tree_query, queries.size(), 0);
+		std::vector<size_type> result(queries.size() * k, npos);
+		std::atomic<std::size_t> touched { 0 };
+		parallel_for_each_block(queries.size(), query_block, [&](size_type first, size_type last) {
+			std::vector<std::pair<scalar_type, size_type>> heap;
+			std::size_t bytes = 0;
+			for (auto q = first; q < last; ++q) {
+				heap.clear();
+				bytes += knn_search(queries[q], k, heap);
+				std::sort_heap(heap.begin(), heap.end());
+				for (size_type j = 0; j < heap.size(); ++j)
+					result[q * k + j] = indices[heap[j].second];
+			}
+			if (instrumentation_enabled)
+				touched.fetch_add(bytes, std::memory_order_relaxed);
+		}, policy);
+		GEOM_PROBE_BYTES(touched.load());
+		return result;
+	}
+
+	/// Indices of all points within @p radius of every point in @p queries.
+	template<class query_range, class policy_t = sequential_policy>
+	std::vector<std::vector<size_type>> radius(const query_range& queries, scalar_type radius,
+			policy_t policy = sequential) const {
+		GEOM_PROBE(tree_query, queries.size(), 0);
+		std::vector<std::vector<size_type>> result(queries.size());
+		std::atomic<std::size_t> touched { 0 };
+		parallel_for_each_block(queries.size(), query_block, [&](size_type first, size_type last) {
+			std::size_t bytes = 0;
+			for (auto q = first; q < last; ++q)
+				bytes += radius_search(queries[q], radius * radius, result[q]);
+			if (instrumentation_enabled)
+				touched.fetch_add(bytes, std::memory_order_relaxed);
+		}, policy);
+		GEOM_PROBE_BYTES(touched.load());
+		return result;
+	}
+
+	/**
+	 * \brief Increasing indices of all points inside a query volume.
+	 *
+	 * @p classify(box) returns the containment of an axis aligned box in the volume,
+	 * subtrees with bounds inside are taken without testing their points and subtrees outside are skipped.
+	 * @p contains(point) tests the points of leaves intersecting the volume.
+	 * classify may be conservative and report intersecting for boxes inside or outside the volume.
+	 * Node bounds are derived from the split planes, every point in them lies in the box exactly.
+	 * The nodes and points visited are added to the innermost instrumentation probe, see GEOM_PROBE_BYTES.
+	 */
+	template<class classify_t, class contains_t>
+	std::vector<size_type> select(classify_t classify, contains_t contains) const {
+		std::vector<size_type> result;
+		if (empty())
+			return result;
+		std::pair<size_type, box_type> stack[2 * std::numeric_limits<size_type>::digits];
+		size_type top = 0;
+		std::size_t visited_nodes = 0, tested_points = 0;
+		stack[top++] = { 0, root_bounds };
+		while (top != 0) {
+			const auto current = stack[--top];
+			const auto& n = nodes[current.first];
+			++visited_nodes;
+			const auto relation = classify(current.second);
+			if (relation == containment::outside)
+				continue;
+			if (relation == containment::inside) {
+				result.insert(result.end(), indices.begin() + n.begin, indices.begin() + n.end);
+				continue;
+			}
+			if (n.axis < 0) {
+				tested_points += n.end - n.begin;
+				for (auto i = n.begin; i < n.end; ++i)
+					if (contains(points[i]))
+						result.push_back(indices[i]);
+				continue;
+			}
+			stack[top] = { n.right, current.second };
+			stack[top++].second.min()[n.axis] = n.split;
+			stack[top] = { current.first + 1, current.second };
+			stack[top++].second.max()[n.axis] = n.split;
+		}
+		GEOM_PROBE_BYTES(visited_nodes * sizeof(node) + tested_points * sizeof(vector_type)
+				+ result.size() * sizeof(size_type));
+		if (result.size() < size() / 16) {
+			std::sort(result.begin(), result.end());
+			return result;
+		}
+		//large results are ordered by a linear pass over a bitmap instead of sorting
+		std::vector<bool> selected(size());
+		for (const auto i : result)
+			selected[i] = true;
+		//one spare element for the branch free write after the last selected index
+		result.resize(result.size() + 1);
+		size_type count = 0;
+		for (size_type i = 0; i < selected.size(); ++i) {
+			result[count] = i;
+			count += selected[i];
+		}
+		result.resize(count);
+		return result;
+	}
+
+private:
+	using point_buffer = std::vector<vector_type, Eigen::aligned_allocator<vector_type>>;
+
+	/// Number of queries processed per block in batched queries.
+	static constexpr size_type query_block = 256;
+
+	struct node {
+		/// split coordinate of inner nodes
+		scalar_type split;
+		/// split axis of inner nodes, -1 for leaves
+		int axis;
+		/// range of points in tree order
+		size_type begin, end;
+		/// index of right child, the left child follows its parent directly
+		size_type right;
+	};
+
+	struct subtree {
+		size_type node, begin, end;
+	};
+
+	/// number of nodes of a subtree over @p count points, used to preallocate node indices
+	size_type node_count(size_type count) const {
+		if (count <= leaf_size)
+			return 1;
+		return 1 + node_count(count / 2) + node_count(count - count / 2);
+	}
+
+	static size_type top_levels(sequential_policy) {
+		return 0;
+	}
+	static size_type top_levels(parallel_policy policy) {
+		const auto threads = policy.pool ? policy.pool->size() : default_thread_pool().size();
+		size_type levels = 0;
+		while ((size_type { 1 } << levels) < 4 * threads)
+			++levels;
+		return levels;
+	}
+
+	/// splits range [begin, end) at the median of its widest axis into node @p index
+	void split(const point_buffer& source, size_type index, size_type begin, size_type end) {
+		vector_type lower = source[indices[begin]];
+		vector_type upper = lower;
+		for (auto i = begin + 1; i < end; ++i) {
+			lower = lower.cwiseMin(source[indices[i]]);
+			upper = upper.cwiseMax(source[indices[i]]);
+		}
+		int axis = 0;
+		(upper - lower).maxCoeff(&axis);
+
+		const auto mid = begin + (end - begin) / 2;
+		std::nth_element(indices.begin() + begin, indices.begin() + mid, indices.begin() + end,
+				[&](size_type l, size_type r) { return source[l][axis] < source[r][axis]; });
+
+		auto& n = nodes[index];
+		n.split = source[indices[mid]][axis];
+		n.axis = axis;
+		n.begin = begin;
+		n.end = end;
+		n.right = index + 1 + node_count(mid - begin);
+	}
+
+	void make_leaf(size_type index, size_type begin, size_type end) {
+		nodes[index] = node { 0, -1, begin, end, 0 };
+	}
+
+	void build_top(const point_buffer& source, size_type index, size_type begin, size_type end,
+			size_type levels, std::vector<subtree>& frontier) {
+		if (end - begin <= leaf_size) {
+			make_leaf(index, begin, end);
+			return;
+		}
+		if (levels == 0) {
+			frontier.push_back(subtree { index, begin, end });
+			return;
+		}
+		split(source, index, begin, end);
+		const auto mid = begin + (end - begin) / 2;
+		build_top(source, index + 1, begin, mid, levels - 1, frontier);
+		build_top(source, nodes[index].right, mid, end, levels - 1, frontier);
+	}
+
+	void build(const point_buffer& source, size_type index, size_type begin, size_type end) {
+		if (end - begin <= leaf_size) {
+			make_leaf(index, begin, end);
+			return;
+		}
+		split(source, index, begin, end);
+		const auto mid = begin + (end - begin) / 2;
+		build(source, index + 1, begin, mid);
+		build(source, nodes[index].right, mid, end);
+	}
+
+	/// returns the bytes of nodes and points visited
+	template<class query_t>
+	std::size_t knn_search(const query_t& query, size_type k,
+			std::vector<std::pair<scalar_type, size_type>>& heap) const {
+		if (k == 0 || empty())
+			return 0;
+		const vector_type q = query;
+		auto worst = std::numeric_limits<scalar_type>::max();
+		return visit(q, [&](size_type i, scalar_type d) {
+			if (heap.size() < k) {
+				heap.emplace_back(d, i);
+				std::push_heap(heap.begin(), heap.end());
+			} else if (d < heap.front().first) {
+				std::pop_heap(heap.begin(), heap.end());
+				heap.back() = { d, i };
+				std::push_heap(heap.begin(), heap.end());
+			}
+			if (heap.size() == k)
+				worst = heap.front().first;
+			return worst;
+		}, worst);
+	}
+
+	/// returns the bytes of nodes and points visited
+	template<class query_t>
+	std::size_t radius_search(const query_t& query, scalar_type squared_radius,
+			std::vector<size_type>& result) const {
+		if (empty())
+			return 0;
+		const vector_type q = query;
+		return visit(q, [&](size_type i, scalar_type d) {
+			if (d <= squared_radius)
+				result.push_back(indices[i]);
+			return squared_radius;
+		}, squared_radius);
+	}
+
+	/**
+	 * \brief depth first traversal, nearer child first.
+	 *
+	 * @p f(position, squared distance) is called for every point in visited leaves
+	 * and returns the current squared search radius used to prune far children.
+	 * \returns bytes of the nodes and points visited, for instrumentation.
+	 */
+	template<class F>
+	std::size_t visit(const vector_type& q, F f, scalar_type bound) const {
+		std::pair<size_type, scalar_type> stack[2 * std::numeric_limits<size_type>::digits];
+		size_type top = 0;
+		std::size_t visited_nodes = 0, visited_points = 0;
+		stack[top++] = { 0, scalar_type(0) };
+		while (top != 0) {
+			const auto current = stack[--top];
+			if (current.second > bound)
+				continue;
+			const auto& n = nodes[current.first];
+			++visited_nodes;
+			if (n.axis < 0) {
+				visited_points += n.end - n.begin;
+				for (auto i = n.begin; i < n.end; ++i)
+					bound = f(i, (points[i] - q).squaredNorm());
+				continue;
+			}
+			const auto diff = q[n.axis] - n.split;
+			const auto near = diff < 0 ? current.first + 1 : n.right;
+			const auto far = diff < 0 ? n.right : current.first + 1;
+			stack[top++] = { far, std::max(current.second, diff * diff) };
+			stack[top++] = { near, current.second };
+		}
+		return visited_nodes * sizeof(node) + visited_points * sizeof(vector_type);
+	}
+
+	size_type leaf_size;
+	box_type root_bounds { };
+	std::vector<node> nodes;
+	/// collection index of the points in tree order
+	std::vector<size_type> indices;
+	/// points in tree order
+	point_buffer points;
+};
+
+template<class collection_t>
+constexpr typename kd_tree<collection_t>::size_type kd_tree<collection_t>::npos;
+
+template<class collection_t>
+constexpr typename kd_tree<collection_t>::size_type kd_tree<collection_t>::query_block;
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_KD_TREE_H_ */
@@ -0,0 +1,611 @@
+#ifndef GEOM_SRC_MAPPED_COLLECTION_H_
+#define GEOM_SRC_MAPPED_COLLECTION_H_
+
+//This header contains the binary file format of geom::collection
+//and mapped_collection, which accesses such a file through mmap without copying it.
+//
+//File layout, all integers in native byte order, blocks aligned to file_alignment bytes:
+//
+//  file_header
+//  array_entry[annotation_arrays]   offset and element size of every annotation array
+//  point block                      the point scalars exactly as stored by the layout of the collection,
+//                                   coordinate r of point i at i * point_stride + r * coordinate_stride
+//  annotation arrays                one array of meta_t, or one array per field for columnar annotations
+//
+//Annotations (and all fields of columnar annotations) have to be trivially copyable.
+//Files are only compatible between builds with the same scalar type, dimension, layout
+//and annotation type, mapped_collection checks sizes and layout but can't detect every mismatch.
+//Mapping requires POSIX mmap.
+
+#include "collection.h"
+#include "storage.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fc
+{
+namespace geom
+{
+
+/// Alignment in bytes of the point block and annotation arrays in the file.
+constexpr std::size_t file_alignment = 64;
+
+/// Header at the start of every collection file.
+struct file_header {
+	/// "fcgeom" followed by two zero bytes
+	char magic[8];
+	std::uint32_t version;
+	/// 0x01020304 as written, detects files from machines with different byte order
+	std::uint32_t byte_order;
+	/// size in bytes of a coordinate
+	std::uint32_t scalar_size;
+	std::uint32_t dimension;
+	/// 0 for packed_layout, 1 for soa_layout, 2 for padded_layout
+	std::uint32_t layout;
+	/// number of array_entry following the header
+	std::uint32_t annotation_arrays;
+	/// number of objects
+	std::uint64_t count;
+	/// position and size in bytes of the point block
+	std::uint64_t point_offset;
+	std::uint64_t point_bytes;
+	/// distance in scalars between two points and between two coordinates of a point
+	std::uint64_t point_stride;
+	std::uint64_t coordinate_stride;
+};
+
+/// Position of an annotation array in the file.
+struct array_entry {
+	std::uint64_t offset;
+	std::uint64_t element_size;
+};
+
+/// Current version of the file format.
+constexpr std::uint32_t file_version = 1;
+
+namespace detail
+{
+
+constexpr char file_magic[8] = { 'f', 'c', 'g', 'e', 'o', 'm', 0, 0 };
+constexpr std::uint32_t file_byte_order = 0x01020304;
+
+template<class layout>
+struct layout_code;
+template<>
+struct layout_code<packed_layout> : std::integral_constant<std::uint32_t, 0> {
+};
+template<>
+struct layout_code<soa_layout> : std::integral_constant<std::uint32_t, 1> {
+};
+template<>
+struct layout_code<padded_layout> : std::integral_constant<std::uint32_t, 2> {
+};
+
+constexpr bool all_of(std::initializer_list<bool> values) {
+	for (const bool v : values)
+		if (!v)
+			return false;
+	return true;
+}
+
+inline std::uint64_t align_offset(std::uint64_t offset) {
+	return (offset + file_alignment - 1) / file_alignment * file_alignment;
+}
+
+/// Description of the annotation arrays of meta_t in the file.
+template<class meta_t, bool columnar = is_columnar<meta_t>::value>
+struct annotation_arrays;
+
+template<class meta_t>
+struct annotation_arrays<meta_t, false> {
+	static_assert(std::is_trivially_copyable<meta_t>::value,
+			"annotations have to be trivially copyable to be stored in a file");
+
+	static constexpr std::size_t count = 1;
+
+	static std::array<std::uint64_t, count> element_sizes() {
+		return { { sizeof(meta_t) } };
+	}
+
+	template<class storage_t>
+	static std::array<const void*, count> data(const storage_t& s) {
+		return { { s.data() } };
+	}
+	template<class storage_t>
+	static std::array<void*, count> mutable_data(storage_t& s) {
+		return { { s.data() } };
+	}
+
+	static meta_t load(const std::array<const char*, count>& arrays, std::size_t i) {
+		return reinterpret_cast<const meta_t*>(arrays[0])[i];
+	}
+};
+
+template<class meta_t>
+struct annotation_arrays<meta_t, true> {
+	using fields = typename annotation_fields<meta_t>::type;
+	static constexpr std::size_t count = std::tuple_size<fields>::value;
+	using indices = std::make_index_sequence<count>;
+
+	template<std::size_t I>
+	using field_type = typename std::tuple_element<I, fields>::type::value_type;
+
+	static std::array<std::uint64_t, count> element_sizes() {
+		return element_sizes(indices { });
+	}
+
+	template<class storage_t>
+	static std::array<const void*, count> data(const storage_t& s) {
+		return data(s, indices { });
+	}
+	template<class storage_t>
+	static std::array<void*, count> mutable_data(storage_t& s) {
+		return mutable_data(s, indices { });
+	}
+
+	static meta_t load(const std::array<const char*, count>& arrays, std::size_t i) {
+		meta_t value { };
+		load(arrays, i, value, indices { });
+		return value;
+	}
+
+private:
+	template<std::size_t... I>
+	static std::array<std::uint64_t, count> element_sizes(std::index_sequence<I...>) {
+		static_assert(all_of({ std::is_trivially_copyable<field_type<I>>::value... }),
+				"annotation fields have to be trivially copyable to be stored in a file");
+		static_assert(all_of({ !std::is_same<field_type<I>, bool>::value... }),
+				"bool fields are stored as bitsets in memory and can't be stored in a file");
+		return { { sizeof(field_type<I>)... } };
+	}
+
+	template<class storage_t, std::size_t... I>
+	static std::array<const void*, count> data(const storage_t& s, std::index_sequence<I...>) {
+		return { { static_cast<const void*>(s.template column<I>().data())... } };
+	}
+	template<class storage_t, std::size_t... I>
+	static std::array<void*, count> mutable_data(storage_t& s, std::index_sequence<I...>) {
+		return { { static_cast<void*>(s.template column<I>().data())... } };
+	}
+
+	template<std::size_t... I>
+	static void load(const std::array<const char*, count>& arrays, std::size_t i, meta_t& value,
+			std::index_sequence<I...>) {
+		(void) swallow { 0, (std::tuple_element<I, fields>::type::get(value) =
+				reinterpret_cast<const field_type<I>*>(arrays[I])[i], 0)... };
+	}
+};
+
+/**
+ * \brief Header and annotation array table of a file of T in layout.
+ *
+ * Shared by write_collection, mapped_collection and the chunked reader and writer.
+ */
+template<class T, class layout>
+struct file_description {
+	using arrays = annotation_arrays<typename T::annotation>;
+	using scalar_type = typename T::vector_type::Scalar;
+	static constexpr int dimension = T::vector_type::RowsAtCompileTime;
+
+	/// size in bytes of header and array table
+	static constexpr std::size_t head_size = sizeof(file_header) + arrays::count * sizeof(array_entry);
+
+	file_header header;
+	std::array<array_entry, arrays::count> entries;
+	/// size in bytes of the whole file
+	std::uint64_t length;
+
+	/**
+	 * \brief Describes a file of @p count objects whose point block has geometry @p points.
+	 *
+	 * The annotation arrays are placed for @p capacity >= count objects,
+	 * which lets a writer append objects before the final count is known.
+	 */
+	static file_description describe(std::uint64_t count, std::uint64_t capacity, const block_geometry& points) {
+		file_description d { };
+		file_header& h = d.header;
+		std::memcpy(h.magic, file_magic, sizeof(h.magic));
+		h.version = file_version;
+		h.byte_order = file_byte_order;
+		h.scalar_size = sizeof(scalar_type);
+		h.dimension = dimension;
+		h.layout = layout_code<layout>::value;
+		h.annotation_arrays = arrays::count;
+		h.count = count;
+		h.point_offset = align_offset(head_size);
+		h.point_bytes = points.size * sizeof(scalar_type);
+		h.point_stride = points.point_stride;
+		h.coordinate_stride = points.coordinate_stride;
+
+		const auto sizes = arrays::element_sizes();
+		auto offset = h.point_offset + h.point_bytes;
+		for (std::size_t a = 0; a < arrays::count; ++a) {
+			offset = align_offset(offset);
+			d.entries[a] = array_entry { offset, sizes[a] };
+			offset += sizes[a] * capacity;
+		}
+		d.length = offset;
+		return d;
+	}
+
+	/**
+	 * \brief Reads and validates the description at the start of file @p path of @p length bytes.
+	 *
+	 * \param head the first min(length, head_size) bytes of the file.
+	 * \throws std::runtime_error if the file doesn't match T and layout, its strides don't match layout
+	 * or its blocks are out of range.
+	 */
+	static file_description parse(const char* head, std::uint64_t length, const std::string& path) {
+		const auto fail = [&path](const char* what) {
+			throw std::runtime_error { path + ": " + what };
+		};
+		file_description d { };
+		d.length = length;
+		if (length < sizeof(file_header))
+			fail("not a collection file");
+		file_header& h = d.header;
+		std::memcpy(&h, head, sizeof(h));
+		if (std::memcmp(h.magic, file_magic, sizeof(h.magic)) != 0)
+			fail("not a collection file");
+		if (h.version != file_version)
+			fail("unsupported file version");
+		if (h.byte_order != file_byte_order)
+			fail("byte order doesn't match");
+		if (h.scalar_size != sizeof(scalar_type) || h.dimension != std::uint32_t(dimension))
+			fail("point type doesn't match");
+		if (h.layout != layout_code<layout>::value)
+			fail("layout doesn't match");
+		if (h.annotation_arrays != arrays::count || head_size > length)
+			fail("annotation type doesn't match");
+
+		//a block of count elements of size bytes starting at offset, products are checked before they can overflow
+		const auto fits = [length](std::uint64_t offset, std::uint64_t count, std::uint64_t size) {
+			return offset % file_alignment == 0 && offset <= length
+					&& (size == 0 || count <= (length - offset) / size);
+		};
+		//strides as stored by point_storage<layout>, the coordinate arrays of soa_layout hold at least count points
+		const auto memory = point_storage<layout, typename T::vector_type>::geometry(1);
+		if (h.point_stride != memory.point_stride || (std::is_same<layout, soa_layout>::value ?
+				h.coordinate_stride < std::max<std::uint64_t>(h.count, 1) : h.coordinate_stride != memory.coordinate_stride))
+			fail("point block doesn't match layout");
+		if (h.count != 0) {
+			//scalars up to the last coordinate of the last point, strides are at least 1
+			const auto scalars = h.point_bytes / sizeof(scalar_type);
+			if (!fits(h.point_offset, h.point_bytes, 1) || h.count - 1 > scalars / h.point_stride
+					|| std::uint64_t(dimension - 1) > (scalars - (h.count - 1) * h.point_stride) / h.coordinate_stride
+					|| (h.count - 1) * h.point_stride + (dimension - 1) * h.coordinate_stride >= scalars)
+				fail("point block out of range");
+		}
+
+		std::memcpy(d.entries.data(), head + sizeof(file_header), sizeof(d.entries));
+		const auto sizes = arrays::element_sizes();
+		for (std::size_t a = 0; a < arrays::count; ++a) {
+			if (d.entries[a].element_size != sizes[a])
+				fail("annotation type doesn't match");
+			if (!fits(d.entries[a].offset, h.count, d.entries[a].element_size))
+				fail("annotation block out of range");
+		}
+		return d;
+	}
+};
+
+template<class T, class layout>
+constexpr std::size_t file_description<T, layout>::head_size;
+
+} // namespace detail
+
+/**
+ * \brief Writes collection @p c to file @p path in the format described in mapped_collection.h.
+ *
+ * Points and annotations are written block by block as stored in memory.
+ * The point block has the geometry of a storage of exactly c.size() points,
+ * unused capacity of the coordinate arrays of soa_layout is not written, padding is written as zeros.
+ * \throws std::runtime_error if the file can't be written.
+ */
+template<class T, class layout, class allocator_t>
+void write_collection(const collection<T, layout, allocator_t>& c, const std::string& path) {
+	using description = detail::file_description<T, layout>;
+	using scalar_type = typename description::scalar_type;
+	const auto& points = c.points();
+	const auto geometry = std::decay_t<decltype(points)>::geometry(c.size());
+	const auto d = description::describe(c.size(), c.size(), geometry);
+	const auto& header = d.header;
+	const auto& entries = d.entries;
+
+	std::ofstream out { path, std::ios::binary | std::ios::trunc };
+	if (!out)
+		throw std::runtime_error { "can't open " + path + " for writing" };
+	std::uint64_t position = 0;
+	const auto write = [&](const void* data, std::uint64_t bytes) {
+		out.write(static_cast<const char*>(data), std::streamsize(bytes));
+		position += bytes;
+	};
+	const auto pad_to = [&](std::uint64_t target) {
+		const char zeros[file_alignment] = { };
+		while (position < target)
+			write(zeros, std::min<std::uint64_t>(target - position, file_alignment));
+	};
+
+	write(&header, sizeof(header));
+	write(entries.data(), sizeof(entries));
+	pad_to(header.point_offset);
+	if (geometry.coordinate_stride == 1) {
+		write(points.data(), header.point_bytes);
+	} else {
+		for (int r = 0; r < description::dimension; ++r) {
+			pad_to(header.point_offset + r * geometry.coordinate_stride * sizeof(scalar_type));
+			write(points.data() + r * points.coordinate_stride(), c.size() * sizeof(scalar_type));
+		}
+		pad_to(header.point_offset + header.point_bytes);
+	}
+	const auto data = description::arrays::data(c.meta());
+	for (std::size_t a = 0; a < entries.size(); ++a) {
+		pad_to(entries[a].offset);
+		write(data[a], entries[a].element_size * c.size());
+	}
+	out.flush();
+	if (!out)
+		throw std::runtime_error { "failed writing " + path };
+}
+
+/**
+ * \brief Read only strided view of points, coordinate r of point i at data[i * point_stride + r * coordinate_stride].
+ *
+ * Used for the points of mapped_collection, which keeps the layout of the collection written to the file.
+ */
+template<class vector_t>
+class strided_points {
+public:
+	using vector_type = vector_t;
+	using scalar_type = typename vector_type::Scalar;
+	static constexpr int dimension = vector_type::RowsAtCompileTime;
+	using size_type = std::size_t;
+	using const_reference = Eigen::Map<const vector_type, Eigen::Unaligned, Eigen::InnerStride<>>;
+	using reference = const_reference;
+	using const_iterator = detail::proxy_iterator<const strided_points, const_reference>;
+	using iterator = const_iterator;
+
+	strided_points() = default;
+	strided_points(const scalar_type* data, size_type count, size_type point_stride,
+			size_type coordinate_stride) :
+			points { data }, count { count },
+			point_step { point_stride }, coordinate_step { coordinate_stride } {
+	}
+
+	size_type size() const noexcept {
+		return count;
+	}
+	bool empty() const noexcept {
+		return count == 0;
+	}
+
+	const_reference operator[](size_type i) const {
+		return const_reference { points + i * point_step, Eigen::InnerStride<>(coordinate_step) };
+	}
+
+	const_iterator begin() const noexcept {
+		return const_iterator { this, 0 };
+	}
+	const_iterator end() const noexcept {
+		return const_iterator { this, count };
+	}
+
+	/// Read only Eigen view of @p n points starting at @p first, one point per column.
+	auto block(size_type first, size_type n) const {
+		using matrix_t = Eigen::Matrix<scalar_type, dimension, Eigen::Dynamic>;
+		using stride_t = Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>;
+		return Eigen::Map<const matrix_t, Eigen::Unaligned, stride_t> { points + first * point_step,
+				dimension, Eigen::Index(n), stride_t(point_step, coordinate_step) };
+	}
+
+private:
+	const scalar_type* points = nullptr;
+	size_type count = 0;
+	size_type point_step = 0;
+	size_type coordinate_step = 0;
+};
+
+/// Read only view of a contiguous array, used for the annotation arrays of mapped_collection.
+template<class T>
+class array_view {
+public:
+	using value_type = T;
+	using size_type = std::size_t;
+	using const_iterator = const T*;
+	using iterator = const_iterator;
+
+	array_view() = default;
+	array_view(const T* data, size_type size) :
+			elements { data }, count { size } {
+	}
+
+	const T* data() const noexcept {
+		return elements;
+	}
+	size_type size() const noexcept {
+		return count;
+	}
+	bool empty() const noexcept {
+		return count == 0;
+	}
+	const T& operator[](size_type i) const {
+		return elements[i];
+	}
+	const_iterator begin() const noexcept {
+		return elements;
+	}
+	const_iterator end() const noexcept {
+		return elements + count;
+	}
+
+private:
+	const T* elements = nullptr;
+	size_type count = 0;
+};
+
+/**
+ * \brief Read only collection backed by a file written by write_collection, mapped with mmap.
+ *
+ * Opening does not read or copy the points and annotations,
+ * pages are loaded by the operating system when they are accessed.
+ * Points are exposed in the layout they were written with,
+ * which has to match the layout parameter.
+ *
+ * \tparam T type of object stored in the file, an instantiation of geom::object.
+ * \tparam layout layout of the collection the file was written from.
+ */
+template<class T, class layout = typename default_layout<typename T::vector_type>::type>
+class mapped_collection {
+	using arrays = detail::annotation_arrays<typename T::annotation>;
+
+public:
+	using value_type = T;
+	using vector_type = typename T::vector_type;
+	using annotation = typename T::annotation;
+	using scalar_type = typename vector_type::Scalar;
+	static constexpr int dimension = vector_type::RowsAtCompileTime;
+	using size_type = std::size_t;
+	using const_iterator = detail::proxy_iterator<const mapped_collection, T, T>;
+	using iterator = const_iterator;
+
+	/**
+	 * \brief Maps file @p path.
+	 *
+	 * \throws std::runtime_error if the file can't be mapped or doesn't match T and layout.
+	 */
+	explicit mapped_collection(const std::string& path) {
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw std::runtime_error { "can't open " + path };
+		struct stat info;
+		if (::fstat(fd, &info) != 0 || info.st_size < std::streamoff(sizeof(file_header))) {
+			::close(fd);
+			throw std::runtime_error { path + " is not a collection file" };
+		}
+		length = std::size_t(info.st_size);
+		mapping = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (mapping == MAP_FAILED) {
+			mapping = nullptr;
+			throw std::runtime_error { "can't map " + path };
+		}
+		try {
+			validate(path);
+		} catch (...) {
+			unmap();
+			throw;
+		}
+	}
+
+	~mapped_collection() {
+		unmap();
+	}
+
+	mapped_collection(const mapped_collection&) = delete;
+	mapped_collection& operator=(const mapped_collection&) = delete;
+
+	mapped_collection(mapped_collection&& o) noexcept :
+			mapping { o.mapping }, length { o.length }, count { o.count },
+			point_view { o.point_view }, annotation_data { o.annotation_data } {
+		o.mapping = nullptr;
+		o.count = 0;
+	}
+	mapped_collection& operator=(mapped_collection&& o) noexcept {
+		std::swap(mapping, o.mapping);
+		std::swap(length, o.length);
+		std::swap(count, o.count);
+		std::swap(point_view, o.point_view);
+		std::swap(annotation_data, o.annotation_data);
+		return *this;
+	}
+
+	size_type size() const noexcept {
+		return count;
+	}
+	bool empty() const noexcept {
+		return count == 0;
+	}
+
+	/// Points in the mapped file.
+	const strided_points<vector_type>& points() const noexcept {
+		return point_view;
+	}
+
+	/// Annotation of object @p i.
+	annotation meta(size_type i) const {
+		return arrays::load(annotation_data, i);
+	}
+
+	/// Object @p i, assembled from the mapped point and annotation.
+	T operator[](size_type i) const {
+		return T { point_view[i], meta(i) };
+	}
+
+	const_iterator begin() const noexcept {
+		return const_iterator { this, 0 };
+	}
+	const_iterator end() const noexcept {
+		return const_iterator { this, count };
+	}
+
+	/// Mapped array of annotation field @p I, only available for columnar annotations.
+	template<std::size_t I>
+	auto column() const noexcept {
+		using field_t = typename arrays::template field_type<I>;
+		return array_view<field_t> { reinterpret_cast<const field_t*>(annotation_data[I]), count };
+	}
+
+	/// Mapped array of all annotations, only available for annotations stored as rows.
+	array_view<annotation> annotations() const noexcept {
+		static_assert(!detail::is_columnar<annotation>::value,
+				"columnar annotations are accessed through column()");
+		return { reinterpret_cast<const annotation*>(annotation_data[0]), count };
+	}
+
+private:
+	void validate(const std::string& path) {
+		const char* base = static_cast<const char*>(mapping);
+		const auto d = detail::file_description<T, layout>::parse(base, length, path);
+		const auto& header = d.header;
+		for (std::size_t a = 0; a < arrays::count; ++a)
+			annotation_data[a] = base + d.entries[a].offset;
+
+		count = header.count;
+		point_view = strided_points<vector_type> {
+				reinterpret_cast<const scalar_type*>(base + header.point_offset), count,
+				header.point_stride, header.coordinate_stride };
+	}
+
+	void unmap() noexcept {
+		if (mapping)
+			::munmap(mapping, length);
+		mapping = nullptr;
+	}
+
+	void* mapping = nullptr;
+	std::size_t length = 0;
+	size_type count = 0;
+	strided_points<vector_type> point_view;
+	std::array<const char*, arrays::count> annotation_data { };
+};
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_MAPPED_COLLECTION_H_ */
@@ -0,0 +1,126 @@
+#ifndef GEOM_SRC_MORTON_H_
+#define GEOM_SRC_MORTON_H_
+
+//This header contains Morton (Z-order) codes and the radix sort used to order
+//points of geom::collection spatially.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+namespace fc
+{
+namespace geom
+{
+
+/// Number of bits per coordinate in the 64 bit Morton code of a @p dim dimensional point.
+template<int dim>
+struct morton_bits : std::integral_constant<int, 64 / dim> {
+	static_assert(dim == 2 || dim == 3, "morton codes are available for 2D and 3D points");
+};
+
+namespace detail
+{
+
+/// distributes the lower 21 bits of @p v to every third bit.
+inline std::uint64_t spread_bits(std::uint64_t v, std::integral_constant<int, 3>) {
+#ifdef __BMI2__
+	return _pdep_u64(v, 0x9249249249249249ull);
+#else
+	v &= 0x1fffff;
+	v = (v | v << 32) & 0x1f00000000ffffull;
+	v = (v | v << 16) & 0x1f0000ff0000ffull;
+	v = (v | v << 8) & 0x100f00f00f00f00full;
+	v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+	v = (v | v << 2) & 0x1249249249249249ull;
+	return v;
+#endif
+}
+
+/// distributes the lower 32 bits of @p v to every second bit.
+inline std::uint64_t spread_bits(std::uint64_t v, std::integral_constant<int, 2>) {
+#ifdef __BMI2__
+	return _pdep_u64(v, 0x5555555555555555ull);
+#else
+	v &= 0xffffffff;
+	v = (v | v << 16) & 0x0000ffff0000ffffull;
+	v = (v | v << 8) & 0x00ff00ff00ff00ffull;
+	v = (v | v << 4) & 0x0f0f0f0f0f0f0f0full;
+	v = (v | v << 2) & 0x3333333333333333ull;
+	v = (v | v << 1) & 0x5555555555555555ull;
+	return v;
+#endif
+}
+
+} // namespace detail
+
+/**
+ * \brief Morton code of a point with quantized coordinates @p c.
+ *
+ * Bit i of coordinate r becomes bit i * dim + r of the code,
+ * only the lower morton_bits<dim> bits of every coordinate are used.
+ */
+template<int dim>
+std::uint64_t morton_code(const std::uint32_t (&c)[dim]) {
+	std::uint64_t code = 0;
+	for (int r = 0; r < dim; ++r)
+		code |= detail::spread_bits(c[r], std::integral_constant<int, dim> { }) << r;
+	return code;
+}
+
+/**
+ * \brief Sorts @p keys ascending and applies the same permutation to @p values.
+ *
+ * Least significant digit radix sort with 8 bit digits, stable.
+ * Digits which are equal for all keys are detected in a single pass and skipped,
+ * keys using only the lower bits are thus sorted in fewer passes.
+ */
+template<class value_t>
+void radix_sort_by_key(std::vector<std::uint64_t>& keys, std::vector<value_t>& values) {
+	constexpr int digit_bits = 8;
+	constexpr std::size_t radix = std::size_t { 1 } << digit_bits;
+	const std::size_t n = keys.size();
+	if (n < 2)
+		return;
+
+	std::uint64_t varying = 0;
+	for (const auto k : keys)
+		varying |= k ^ keys[0];
+
+	std::vector<std::uint64_t> key_buffer(n);
+	std::vector<value_t> value_buffer(n);
+	std::array<std::size_t, radix> offsets;
+	for (int shift = 0; shift < 64; shift += digit_bits) {
+		if (((varying >> shift) & (radix - 1)) == 0)
+			continue;
+
+		offsets.fill(0);
+		for (const auto k : keys)
+			++offsets[(k >> shift) & (radix - 1)];
+		std::size_t offset = 0;
+		for (auto&& c : offsets) {
+			const auto count = c;
+			c = offset;
+			offset += count;
+		}
+		for (std::size_t i = 0; i < n; ++i) {
+			const auto slot = offsets[(keys[i] >> shift) & (radix - 1)]++;
+			key_buffer[slot] = keys[i];
+			value_buffer[slot] = values[i];
+		}
+		keys.swap(key_buffer);
+		values.swap(value_buffer);
+	}
+}
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_MORTON_H_ */
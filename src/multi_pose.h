@@ -0,0 +1,186 @@
+#ifndef GEOM_SRC_MULTI_POSE_H_
+#define GEOM_SRC_MULTI_POSE_H_
+
+//This header contains batched transformation of one geom::collection by many poses,
+//e.g. the candidate poses of scan matching or hypothesis scoring.
+//Points are loaded tile by tile into a dense buffer, which is then transformed by every pose,
+//such that the point block is read once instead of once per pose:
+//
+//  std::vector<Transformd> candidates = ...;
+//  const auto inliers = score_poses(scan, candidates.data(), candidates.size(), [&](const auto& block) {
+//      std::size_t n = 0;
+//      for (Eigen::Index i = 0; i < block.cols(); ++i)
+//          n += map.occupied(block.col(i));
+//      return n;
+//  });
+
+#include "collection.h"
+#include "instrument.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace fc
+{
+namespace geom
+{
+
+namespace detail
+{
+
+/// number of points loaded and transformed at once by the multi pose kernels
+constexpr std::size_t pose_tile = 256;
+
+/// @p dim x count block of a pose tile, one point per column and one contiguous row per coordinate.
+template<class scalar, int dim>
+using pose_tile_block = Eigen::Map<const Eigen::Matrix<scalar, dim, Eigen::Dynamic, Eigen::RowMajor>,
+		Eigen::Unaligned, Eigen::OuterStride<pose_tile>>;
+
+template<class scalar, int dim>
+struct pose_kernel {
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+	Eigen::Matrix<scalar, dim, dim> linear;
+	Eigen::Matrix<scalar, dim, 1> translation;
+
+	/// out = linear * in + translation for @p count points of tiles @p in and @p out.
+	void apply(const scalar (&in)[dim][pose_tile], scalar (&out)[dim][pose_tile], std::size_t count) const {
+		for (int r = 0; r < dim; ++r) {
+			scalar row[dim];
+			for (int k = 0; k < dim; ++k)
+				row[k] = linear(r, k);
+			const scalar offset = translation[r];
+			for (std::size_t i = 0; i < count; ++i) {
+				scalar acc = offset;
+				for (int k = 0; k < dim; ++k)
+					acc += row[k] * in[k][i];
+				out[r][i] = acc;
+			}
+		}
+	}
+};
+
+/// number of poses processed per task, splits the poses when there are too few point blocks to keep all threads busy
+inline std::size_t pose_group(std::size_t, std::size_t poses, sequential_policy) {
+	return poses;
+}
+inline std::size_t pose_group(std::size_t blocks, std::size_t poses, parallel_policy policy) {
+	const auto threads = (policy.pool ? policy.pool->size() : default_thread_pool().size()) + 1;
+	const auto groups = std::max<std::size_t>(1, std::min(poses, (4 * threads + blocks - 1) / blocks));
+	return (poses + groups - 1) / groups;
+}
+
+} // namespace detail
+
+/**
+ * \brief Calls @p f(pose, first, block) for every pose and tile of the points of collection @p c.
+ *
+ * block holds the points [first, first + block.cols()) of @p c transformed by poses[pose],
+ * one point per column, it is only valid during the call.
+ * Every tile of points is loaded once per group of poses and transformed by all poses of the group.
+ * Runs on the calling thread by default.
+ * With parallel_policy the tasks, blocks of points times groups of poses, run concurrently,
+ * f has to allow concurrent calls for distinct pairs of pose and first.
+ *
+ * \param poses array of @p count Eigen transformations, e.g. Transformd or Isometry3d.
+ */
+template<class collection_t, class pose_t, class F, class policy_t = sequential_policy>
+void for_each_pose_tile(const collection_t& c, const pose_t* poses, std::size_t count, F f,
+		policy_t policy = sequential) {
+	using scalar_type = typename collection_t::scalar_type;
+	constexpr int dim = collection_t::dimension;
+	using size_type = typename collection_t::size_type;
+	using kernel_type = detail::pose_kernel<scalar_type, dim>;
+	using tile_block = detail::pose_tile_block<scalar_type, dim>;
+	static_assert(std::is_same<typename pose_t::Scalar, scalar_type>::value,
+			"scalar type of poses does not match collection");
+	static_assert(int(pose_t::Dim) == dim, "dimension of poses does not match collection");
+	GEOM_PROBE(transform, c.size() * count, c.size() * sizeof(typename collection_t::vector_type));
+	if (c.empty() || count == 0)
+		return;
+
+	std::vector<kernel_type, Eigen::aligned_allocator<kernel_type>> kernels(count);
+	for (std::size_t p = 0; p < count; ++p) {
+		kernels[p].linear = poses[p].linear();
+		kernels[p].translation = poses[p].translation();
+	}
+
+	const auto grain = detail::block_grain<collection_t>(policy);
+	const auto blocks = (c.size() + grain - 1) / grain;
+	const auto group = detail::pose_group(blocks, count, policy);
+	const auto groups = (count + group - 1) / group;
+	parallel_for_each_block(blocks * groups, 1, [&](std::size_t first_task, std::size_t last_task) {
+		alignas(64) scalar_type points[dim][detail::pose_tile];
+		alignas(64) scalar_type transformed[dim][detail::pose_tile];
+		for (auto task = first_task; task < last_task; ++task) {
+			const auto block = task / groups;
+			const auto first_pose = (task % groups) * group;
+			const auto last_pose = std::min(first_pose + group, count);
+			const size_type last = std::min(c.size(), (block + 1) * grain);
+			for (size_type tile = block * grain; tile < last; tile += detail::pose_tile) {
+				const auto n = std::min<size_type>(detail::pose_tile, last - tile);
+				Eigen::Map<Eigen::Matrix<scalar_type, dim, Eigen::Dynamic, Eigen::RowMajor>, Eigen::Unaligned,
+						Eigen::OuterStride<detail::pose_tile>>(points[0], dim, n) = c.points().block(tile, n);
+				for (auto p = first_pose; p < last_pose; ++p) {
+					kernels[p].apply(points, transformed, n);
+					f(p, tile, tile_block(transformed[0], dim, n));
+				}
+			}
+		}
+	}, policy);
+}
+
+/**
+ * \brief Points of collection @p c transformed by each of the @p count @p poses.
+ *
+ * \returns one dimension x c.size() matrix per pose, point i of pose p is result[p].col(i).
+ */
+template<class collection_t, class pose_t, class policy_t = sequential_policy>
+std::vector<Eigen::Matrix<typename collection_t::scalar_type, collection_t::dimension, Eigen::Dynamic>>
+transform_poses(const collection_t& c, const pose_t* poses, std::size_t count, policy_t policy = sequential) {
+	using matrix_type = Eigen::Matrix<typename collection_t::scalar_type, collection_t::dimension, Eigen::Dynamic>;
+	std::vector<matrix_type> result(count, matrix_type(int(collection_t::dimension), Eigen::Index(c.size())));
+	for_each_pose_tile(c, poses, count, [&result](std::size_t pose, std::size_t first, const auto& block) {
+		result[pose].middleCols(first, block.cols()) = block;
+	}, policy);
+	return result;
+}
+
+/**
+ * \brief Score of every pose, the sum of @p score over the tiles of points transformed by the pose.
+ *
+ * @p score(block) is called with dimension x n blocks of transformed points, one point per column,
+ * and returns a partial score, e.g. the number of inliers or a sum of squared residuals.
+ * Partial scores are summed with operator+= starting from a value initialized score,
+ * in the order of the points independent of the policy.
+ * With parallel_policy score is called concurrently.
+ */
+template<class collection_t, class pose_t, class score_t, class policy_t = sequential_policy>
+auto score_poses(const collection_t& c, const pose_t* poses, std::size_t count, score_t score,
+		policy_t policy = sequential) {
+	using tile_block = detail::pose_tile_block<typename collection_t::scalar_type, collection_t::dimension>;
+	using result_type = std::decay_t<decltype(score(std::declval<const tile_block&>()))>;
+	const auto grain = detail::block_grain<collection_t>(policy);
+	const auto blocks = (c.size() + grain - 1) / grain;
+
+	//one partial score per block of points and pose, summed in block order afterwards
+	std::vector<result_type> partial(blocks * count, result_type { });
+	for_each_pose_tile(c, poses, count, [&](std::size_t pose, std::size_t first, const tile_block& block) {
+		partial[(first / grain) * count + pose] += score(block);
+	}, policy);
+
+	std::vector<result_type> result(count, result_type { });
+	for (std::size_t b = 0; b < blocks; ++b)
+		for (std::size_t p = 0; p < count; ++p)
+			result[p] += partial[b * count + p];
+	return result;
+}
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_MULTI_POSE_H_ */
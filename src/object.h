@@ -54,10 +54,11 @@ struct object: meta_t {
 	vector_type point;
 };
 
-template<class V, class M>
-auto operator*(const geom::Transformf m, object<V,M> o)
+/// Transforms the point of object @p o by @p m, the meta data is left unchanged.
+template<class matrix_t, class V, class M>
+auto operator*(const matrix_t& m, object<V,M> o)
 {
-	o = m*o;
+	o.point = m*o.point;
 	return o;
 }
 
@@ -0,0 +1,461 @@
+#ifndef GEOM_SRC_PIPELINE_H_
+#define GEOM_SRC_PIPELINE_H_
+
+//This header contains pipeline, which runs a chain of stages on chunks, e.g. geom::collection,
+//such that the stages work on consecutive chunks concurrently instead of one after the other:
+//
+//  pipeline<cloud> p { 8 };
+//  p.then(transform(sensor_to_vehicle) | transform(vehicle_to_world))
+//   .then([](cloud c) { c.erase_if(by_point(too_far)); return c; });
+//  p.start();                  //one worker thread per stage, or p.start(pool) to share a pool
+//  for (auto& chunk : chunks)
+//      p.push(std::move(chunk));  //waits while the first queue is full
+//  p.close();
+//  cloud out;
+//  while (p.pop(out))
+//      consume(out);
+//
+//Chunks are passed between stages through bounded lock-free queues, a full queue stops the stage
+//in front of it until its successor takes a chunk, which bounds the memory held by the pipeline.
+//Every stage processes one chunk at a time, the order of the chunks is preserved.
+
+#include "bounded_queue.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace fc
+{
+namespace geom
+{
+
+/// Counters of one pipeline stage.
+struct stage_statistics {
+	/// chunks processed
+	std::uint64_t chunks = 0;
+	/// time spent in the stage function
+	std::uint64_t busy_nanoseconds = 0;
+	/// number of times the stage was stopped by the full queue of its successor
+	std::uint64_t stalls = 0;
+};
+
+/// Counters of a pipeline, see pipeline::statistics.
+struct pipeline_statistics {
+	/// chunks which passed all stages
+	std::uint64_t chunks = 0;
+	/// latency from push until the last stage finished the chunk
+	std::uint64_t min_latency_nanoseconds = 0;
+	std::uint64_t max_latency_nanoseconds = 0;
+	std::uint64_t total_latency_nanoseconds = 0;
+	/// number of pushes which had to wait for the full input queue
+	std::uint64_t input_stalls = 0;
+	std::vector<stage_statistics> stages;
+
+	std::uint64_t mean_latency_nanoseconds() const noexcept {
+		return chunks ? total_latency_nanoseconds / chunks : 0;
+	}
+};
+
+namespace detail
+{
+
+/// waits by yielding first and sleeping once the wait takes longer
+class backoff {
+public:
+	void wait() {
+		if (++rounds < 64)
+			std::this_thread::yield();
+		else
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+
+private:
+	unsigned rounds = 0;
+};
+
+} // namespace detail
+
+/**
+ * \brief Chain of stages, each transforming chunks of type T, running concurrently.
+ *
+ * Stages are callables T(T), e.g. a transformer or a lambda filtering a collection,
+ * added with then() before start().
+ * Every stage runs as a task which processes the chunks waiting in front of it and stops when
+ * there are none or its successor's queue is full. Tasks are rescheduled when chunks arrive or space frees up,
+ * such that no thread blocks on a queue and a shared pool with fewer workers than stages can't deadlock.
+ *
+ * push may be called from any number of threads, as may pop.
+ * The first exception thrown by a stage is rethrown by pop once the pipeline is drained,
+ * the stages skip all chunks after the exception.
+ */
+template<class T>
+class pipeline {
+public:
+	using value_type = T;
+	using stage_function = std::function<T(T)>;
+
+	/// Pipeline whose queues hold up to @p capacity chunks each, rounded up to a power of two.
+	explicit pipeline(std::size_t capacity = 16) :
+			queue_size { capacity }, input(capacity), output(capacity) {
+	}
+
+	pipeline(const pipeline&) = delete;
+	pipeline& operator=(const pipeline&) = delete;
+
+	/// Discards chunks not yet popped and waits for the stages to finish.
+	~pipeline() {
+		if (!started)
+			return;
+		cancelled = true;
+		close();
+		item discarded;
+		detail::backoff idle;
+		while (!finished.load(std::memory_order_acquire) || active_tasks.load(std::memory_order_acquire) != 0) {
+			if (!try_pop_item(discarded))
+				idle.wait();
+		}
+	}
+
+	/// Appends stage @p f, which is called with every chunk and returns the chunk passed on.
+	template<class F>
+	pipeline& then(F f) {
+		assert(!started);
+		stages.emplace_back(new stage { stage_function(std::move(f)), queue_size });
+		return *this;
+	}
+
+	/// Starts the pipeline with one worker thread per stage.
+	void start() {
+		for (std::size_t i = 0; i < stages.size(); ++i)
+			own_pools.emplace_back(new thread_pool(1));
+		for (std::size_t i = 0; i < stages.size(); ++i)
+			stages[i]->executor = own_pools[i].get();
+		begin();
+	}
+
+	/// Starts the pipeline with all stages running as tasks of @p pool, which has to outlive the pipeline.
+	void start(thread_pool& pool) {
+		for (auto& s : stages)
+			s->executor = &pool;
+		begin();
+	}
+
+	/// Moves @p chunk into the pipeline, returns false if the input queue is full.
+	bool try_push(T& chunk) {
+		assert(!closed_input.load(std::memory_order_relaxed));
+		item i { std::move(chunk), std::chrono::steady_clock::now() };
+		if (!input.try_push(std::move(i))) {
+			chunk = std::move(i.value);
+			return false;
+		}
+		schedule(0);
+		return true;
+	}
+
+	/// Moves @p chunk into the pipeline, waits while the input queue is full.
+	void push(T chunk) {
+		if (try_push(chunk))
+			return;
+		input_stalls.fetch_add(1, std::memory_order_relaxed);
+		detail::backoff full;
+		while (!try_push(chunk))
+			full.wait();
+	}
+
+	/// Signals that no more chunks will be pushed, all pushes have to be completed before.
+	void close() {
+		if (closed_input.exchange(true, std::memory_order_acq_rel))
+			return;
+		schedule(0);
+	}
+
+	/// Moves the next chunk which passed all stages to @p chunk, returns false if there is none yet.
+	bool try_pop(T& chunk) {
+		item i;
+		if (!try_pop_item(i))
+			return false;
+		chunk = std::move(i.value);
+		return true;
+	}
+
+	/**
+	 * \brief Moves the next chunk which passed all stages to @p chunk, waits until there is one.
+	 *
+	 * \returns false once the pipeline is closed and all chunks have been popped.
+	 * \throws the first exception thrown by a stage instead of returning false.
+	 */
+	bool pop(T& chunk) {
+		detail::backoff empty;
+		while (true) {
+			if (try_pop(chunk))
+				return true;
+			if (finished.load(std::memory_order_acquire)) {
+				if (try_pop(chunk))
+					return true;
+				if (error)
+					std::rethrow_exception(error);
+				return false;
+			}
+			empty.wait();
+		}
+	}
+
+	/// Counters of the pipeline, may be called at any time.
+	pipeline_statistics statistics() const {
+		pipeline_statistics result;
+		result.chunks = completed.load(std::memory_order_relaxed);
+		result.min_latency_nanoseconds = result.chunks ? min_latency.load(std::memory_order_relaxed) : 0;
+		result.max_latency_nanoseconds = max_latency.load(std::memory_order_relaxed);
+		result.total_latency_nanoseconds = total_latency.load(std::memory_order_relaxed);
+		result.input_stalls = input_stalls.load(std::memory_order_relaxed);
+		for (const auto& s : stages) {
+			stage_statistics counters;
+			counters.chunks = s->chunks.load(std::memory_order_relaxed);
+			counters.busy_nanoseconds = s->busy.load(std::memory_order_relaxed);
+			counters.stalls = s->stalls.load(std::memory_order_relaxed);
+			result.stages.push_back(counters);
+		}
+		return result;
+	}
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	struct item {
+		T value;
+		clock::time_point pushed;
+	};
+
+	struct stage {
+		stage(stage_function f, std::size_t capacity) :
+				f(std::move(f)), input(capacity) {
+		}
+
+		stage_function f;
+		/// chunks waiting in front of the stage, unused by the first stage which reads pipeline::input
+		spsc_queue<item> input;
+		thread_pool* executor = nullptr;
+
+		/// a task of the stage is submitted or running
+		std::atomic<bool> scheduled { false };
+		/// the predecessor finished, no more chunks arrive
+		std::atomic<bool> closed { false };
+		/// the stage holds a processed chunk its successor's queue had no room for
+		std::atomic<bool> blocked { false };
+		bool has_held = false;
+		bool done = false;
+		item held;
+
+		std::atomic<std::uint64_t> chunks { 0 };
+		std::atomic<std::uint64_t> busy { 0 };
+		std::atomic<std::uint64_t> stalls { 0 };
+	};
+
+	/// Writes @p value to counter @p a owned by a single writer.
+	static void add(std::atomic<std::uint64_t>& a, std::uint64_t value) {
+		a.store(a.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	void begin() {
+		assert(!started);
+		if (stages.empty())
+			then([](T chunk) { return chunk; });
+		started = true;
+		for (std::size_t i = 0; i < stages.size(); ++i)
+			schedule(i);
+	}
+
+	bool try_pop_item(item& i) {
+		if (!output.try_pop(i))
+			return false;
+		notify_predecessor(stages.size());
+		return true;
+	}
+
+	/// Reschedules the stage before @p index if it waits for room in the queue a chunk was just taken from.
+	void notify_predecessor(std::size_t index) {
+		if (index == 0 || index > stages.size())
+			return;
+		//orders the chunk just taken before the check of blocked, see run_stage
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (stages[index - 1]->blocked.load(std::memory_order_relaxed))
+			schedule(index - 1);
+	}
+
+	bool pop_input(std::size_t index, item& i) {
+		if (!(index == 0 ? input.try_pop(i) : stages[index]->input.try_pop(i)))
+			return false;
+		notify_predecessor(index);
+		return true;
+	}
+
+	bool push_output(std::size_t index, item& i) {
+		if (index + 1 == stages.size())
+			return output.try_push(std::move(i));
+		if (!stages[index + 1]->input.try_push(std::move(i)))
+			return false;
+		schedule(index + 1);
+		return true;
+	}
+
+	bool input_closed(std::size_t index) const {
+		return index == 0 ? closed_input.load(std::memory_order_acquire) :
+				stages[index]->closed.load(std::memory_order_acquire);
+	}
+
+	bool input_empty(std::size_t index) const {
+		return index == 0 ? input.empty() : stages[index]->input.empty();
+	}
+
+	bool output_full(std::size_t index) const {
+		return index + 1 == stages.size() ? output.full() : stages[index + 1]->input.full();
+	}
+
+	/// true if a task of stage @p index would make progress
+	bool runnable(std::size_t index) const {
+		const auto& s = *stages[index];
+		if (s.done)
+			return false;
+		if (s.has_held)
+			return !output_full(index);
+		return input_closed(index) || !input_empty(index);
+	}
+
+	/// Submits a task of stage @p index unless one is pending.
+	void schedule(std::size_t index) {
+		auto& s = *stages[index];
+		if (!s.executor)
+			return;
+		//orders the chunk just queued before the check of scheduled, see run_stage
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (s.scheduled.load(std::memory_order_relaxed) || s.scheduled.exchange(true, std::memory_order_acq_rel))
+			return;
+		active_tasks.fetch_add(1, std::memory_order_relaxed);
+		s.executor->submit([this, index]() {
+			run_stage(index);
+			active_tasks.fetch_sub(1, std::memory_order_release);
+		});
+	}
+
+	void run_stage(std::size_t index) {
+		auto& s = *stages[index];
+		while (true) {
+			drain(index);
+			s.scheduled.store(false, std::memory_order_release);
+			//a chunk queued or taken after drain returned either sees scheduled or blocked or is seen by runnable
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!runnable(index) || s.scheduled.exchange(true, std::memory_order_acq_rel))
+				return;
+		}
+	}
+
+	/// processes chunks of stage @p index until its input is empty or the successor's queue is full
+	void drain(std::size_t index) {
+		auto& s = *stages[index];
+		const bool last = index + 1 == stages.size();
+		while (!s.done) {
+			if (s.has_held) {
+				if (!push_output(index, s.held)) {
+					if (!s.blocked.load(std::memory_order_relaxed)) {
+						add(s.stalls, 1);
+						s.blocked.store(true, std::memory_order_relaxed);
+					}
+					return;
+				}
+				s.has_held = false;
+				s.blocked.store(false, std::memory_order_relaxed);
+			}
+
+			//closed is read before the queue, chunks pushed before close are thus not missed
+			const bool closed = input_closed(index);
+			if (!pop_input(index, s.held)) {
+				if (closed)
+					finish(index);
+				return;
+			}
+			if (process(s, s.held)) {
+				if (last)
+					record_latency(s.held);
+				s.has_held = true;
+			}
+		}
+	}
+
+	/// calls the stage function, returns false if the chunk is dropped after a failure
+	bool process(stage& s, item& i) {
+		if (failed.load(std::memory_order_relaxed) || cancelled.load(std::memory_order_relaxed))
+			return false;
+		const auto start = clock::now();
+		try {
+			i.value = s.f(std::move(i.value));
+		} catch (...) {
+			if (!failed.exchange(true))
+				error = std::current_exception();
+			return false;
+		}
+		add(s.busy, std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+		add(s.chunks, 1);
+		return true;
+	}
+
+	void record_latency(const item& i) {
+		const std::uint64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				clock::now() - i.pushed).count();
+		const auto count = completed.load(std::memory_order_relaxed);
+		if (count == 0 || latency < min_latency.load(std::memory_order_relaxed))
+			min_latency.store(latency, std::memory_order_relaxed);
+		if (latency > max_latency.load(std::memory_order_relaxed))
+			max_latency.store(latency, std::memory_order_relaxed);
+		add(total_latency, latency);
+		completed.store(count + 1, std::memory_order_relaxed);
+	}
+
+	void finish(std::size_t index) {
+		stages[index]->done = true;
+		if (index + 1 == stages.size()) {
+			finished.store(true, std::memory_order_release);
+			return;
+		}
+		stages[index + 1]->closed.store(true, std::memory_order_release);
+		schedule(index + 1);
+	}
+
+	std::size_t queue_size;
+	std::vector<std::unique_ptr<stage>> stages;
+	mpmc_queue<item> input;
+	mpmc_queue<item> output;
+	bool started = false;
+
+	std::atomic<bool> closed_input { false };
+	std::atomic<bool> finished { false };
+	std::atomic<bool> cancelled { false };
+	std::atomic<bool> failed { false };
+	std::exception_ptr error;
+	std::atomic<std::size_t> active_tasks { 0 };
+
+	//written by the last stage only
+	std::atomic<std::uint64_t> completed { 0 };
+	std::atomic<std::uint64_t> min_latency { 0 };
+	std::atomic<std::uint64_t> max_latency { 0 };
+	std::atomic<std::uint64_t> total_latency { 0 };
+	std::atomic<std::uint64_t> input_stalls { 0 };
+
+	/// worker threads of start(), destroyed first such that no task outlives the members
+	std::vector<std::unique_ptr<thread_pool>> own_pools;
+};
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_PIPELINE_H_ */
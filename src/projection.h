@@ -0,0 +1,225 @@
+#ifndef GEOM_SRC_PROJECTION_H_
+#define GEOM_SRC_PROJECTION_H_
+
+//This header contains the perspective projection of 3D geom::collection into camera images:
+//
+//  const pinhole_camera<float> camera { intrinsics, world_to_camera, 1920, 1080 };
+//  const auto pixels = project(cloud, camera);   //collection<object<Vector2f, meta>>
+//
+//Points behind the camera or outside of the image are dropped in the same pass,
+//the annotations of the remaining points are copied column by column.
+
+#include "collection.h"
+#include "instrument.h"
+#include "object.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+namespace fc
+{
+namespace geom
+{
+
+/**
+ * \brief Pinhole camera, intrinsics and pose, projecting points onto an image.
+ *
+ * A point p is projected to pixel (u, v) = (x / w, y / w) with (x, y, w) = intrinsics * (world_to_camera * p).
+ * The last row of the intrinsics is (0, 0, 1), w is thus the depth in front of the camera.
+ * Points with depth > near and 0 <= u < width, 0 <= v < height are visible.
+ */
+template<class scalar_t>
+class pinhole_camera {
+public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+	using scalar_type = scalar_t;
+	using intrinsics_type = Eigen::Matrix<scalar_t, 3, 3>;
+	using pose_type = Eigen::Transform<scalar_t, 3, Eigen::Affine>;
+	using projection_type = Eigen::Matrix<scalar_t, 3, 4>;
+
+	pinhole_camera(const intrinsics_type& intrinsics, const pose_type& world_to_camera,
+			scalar_t width, scalar_t height, scalar_t near = 0) :
+			matrix { intrinsics * world_to_camera.matrix().template topRows<3>() },
+			image_width { width }, image_height { height }, near_depth { near } {
+	}
+
+	/// Camera with focal lengths @p fx, @p fy and principal point @p cx, @p cy in pixels.
+	static pinhole_camera from_focal(scalar_t fx, scalar_t fy, scalar_t cx, scalar_t cy,
+			const pose_type& world_to_camera, scalar_t width, scalar_t height, scalar_t near = 0) {
+		intrinsics_type k;
+		k << fx, 0, cx, 0, fy, cy, 0, 0, 1;
+		return pinhole_camera { k, world_to_camera, width, height, near };
+	}
+
+	/// intrinsics * world_to_camera, mapping homogeneous world points to homogeneous pixels.
+	const projection_type& projection() const noexcept {
+		return matrix;
+	}
+	scalar_t width() const noexcept {
+		return image_width;
+	}
+	scalar_t height() const noexcept {
+		return image_height;
+	}
+	scalar_t near() const noexcept {
+		return near_depth;
+	}
+
+	/// Pixel of @p p, meaningful only if visible(p).
+	Eigen::Matrix<scalar_t, 2, 1> project(const Eigen::Matrix<scalar_t, 3, 1>& p) const {
+		const Eigen::Matrix<scalar_t, 3, 1> h = matrix * p.homogeneous();
+		return h.template head<2>() / h[2];
+	}
+	bool visible(const Eigen::Matrix<scalar_t, 3, 1>& p) const {
+		const Eigen::Matrix<scalar_t, 3, 1> h = matrix * p.homogeneous();
+		const Eigen::Matrix<scalar_t, 2, 1> pixel = h.template head<2>() / h[2];
+		return h[2] > near_depth && pixel.x() >= 0 && pixel.x() < image_width
+				&& pixel.y() >= 0 && pixel.y() < image_height;
+	}
+
+private:
+	projection_type matrix;
+	scalar_t image_width;
+	scalar_t image_height;
+	scalar_t near_depth;
+};
+
+/// Collection of the 2D projections of the objects of 3D collection_t, see project.
+template<class collection_t>
+using projected_collection = collection<
+		object<Eigen::Matrix<typename collection_t::scalar_type, 2, 1>, typename collection_t::annotation>,
+		typename default_layout<Eigen::Matrix<typename collection_t::scalar_type, 2, 1>>::type,
+		typename std::allocator_traits<typename collection_t::allocator_type>::template rebind_alloc<
+				object<Eigen::Matrix<typename collection_t::scalar_type, 2, 1>, typename collection_t::annotation>>>;
+
+namespace detail
+{
+
+/// number of points projected at once by the projection kernel
+constexpr std::size_t projection_tile = 256;
+
+/// projection of a pinhole_camera with its coefficients in scalars, such that they stay in registers.
+template<class scalar_t>
+struct projection_kernel {
+	explicit projection_kernel(const pinhole_camera<scalar_t>& camera) :
+			width { camera.width() }, height { camera.height() }, near { camera.near() } {
+		for (int r = 0; r < 3; ++r)
+			for (int c = 0; c < 4; ++c)
+				p[r][c] = camera.projection()(r, c);
+	}
+
+	/**
+	 * \brief Projects the points of @p block (one point per column) to @p u, @p v.
+	 *
+	 * Sets flags[i] to 1 if point i is visible, to 0 otherwise.
+	 * Written without branches, such that the compiler vectorizes the loop including the divide.
+	 * \returns number of visible points.
+	 */
+	template<class block_t>
+	std::size_t project(const block_t& block, scalar_t* u, scalar_t* v, std::uint8_t* flags) const {
+		const auto n = block.cols();
+		std::size_t visible = 0;
+		for (Eigen::Index i = 0; i < n; ++i) {
+			const scalar_t x = block.coeff(0, i), y = block.coeff(1, i), z = block.coeff(2, i);
+			const scalar_t w = p[2][0] * x + p[2][1] * y + p[2][2] * z + p[2][3];
+			const scalar_t inverse = scalar_t(1) / w;
+			const scalar_t pu = (p[0][0] * x + p[0][1] * y + p[0][2] * z + p[0][3]) * inverse;
+			const scalar_t pv = (p[1][0] * x + p[1][1] * y + p[1][2] * z + p[1][3]) * inverse;
+			u[i] = pu;
+			v[i] = pv;
+			const auto in = std::uint8_t(w > near) & std::uint8_t(pu >= 0) & std::uint8_t(pu < width)
+					& std::uint8_t(pv >= 0) & std::uint8_t(pv < height);
+			flags[i] = in;
+			visible += in;
+		}
+		return visible;
+	}
+
+	scalar_t p[3][4];
+	scalar_t width, height, near;
+};
+
+} // namespace detail
+
+/**
+ * \brief Pixels of the points of 3D collection @p c visible by @p camera, with their annotations.
+ *
+ * The relative order of the visible objects is preserved.
+ * Points are projected tile by tile, once to count the visible points of every block
+ * and once more to write them to their place in the result,
+ * which reads the points twice instead of writing and reading back intermediate pixels.
+ * The annotations of the visible objects are gathered column by column.
+ *
+ * \param positions if not null, set to the positions in @p c of the projected objects.
+ * \param policy sequential by default, blocks of points are projected concurrently with parallel_policy.
+ */
+template<class collection_t, class policy_t = sequential_policy>
+projected_collection<collection_t> project(const collection_t& c, const pinhole_camera<typename collection_t::scalar_type>& camera,
+		policy_t policy = sequential, std::vector<typename collection_t::size_type>* positions = nullptr) {
+	using scalar_type = typename collection_t::scalar_type;
+	using size_type = typename collection_t::size_type;
+	using pixel_type = Eigen::Matrix<scalar_type, 2, 1>;
+	static_assert(collection_t::dimension == 3, "projection needs 3D points");
+	GEOM_PROBE(transform, c.size(), c.size() * 2 * detail::stored_point_bytes<std::decay_t<decltype(c.points())>>::value);
+
+	const detail::projection_kernel<scalar_type> kernel { camera };
+	const auto grain = detail::block_grain<collection_t>(policy);
+	const auto blocks = (c.size() + grain - 1) / grain;
+	std::vector<size_type> offsets(blocks + 1);
+	parallel_for_each_block(c.size(), grain, [&](size_type first, size_type last) {
+		alignas(64) scalar_type u[detail::projection_tile], v[detail::projection_tile];
+		std::uint8_t flags[detail::projection_tile];
+		size_type count = 0;
+		for (auto tile = first; tile < last; tile += detail::projection_tile) {
+			const auto n = std::min(detail::projection_tile, last - tile);
+			count += kernel.project(c.points().block(tile, n), u, v, flags);
+		}
+		offsets[first / grain + 1] = count;
+	}, policy);
+	std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+	const auto total = offsets.back();
+	projected_collection<collection_t> result(total, uninitialized,
+			typename projected_collection<collection_t>::allocator_type(c.get_allocator()));
+	std::vector<size_type> visible(total);
+	parallel_for_each_block(c.size(), grain, [&](size_type first, size_type last) {
+		alignas(64) scalar_type u[detail::projection_tile], v[detail::projection_tile];
+		std::uint8_t flags[detail::projection_tile];
+		size_type selected[detail::projection_tile];
+		auto out = offsets[first / grain];
+		for (auto tile = first; tile < last; tile += detail::projection_tile) {
+			const auto n = std::min(detail::projection_tile, last - tile);
+			if (kernel.project(c.points().block(tile, n), u, v, flags) == 0)
+				continue;
+			//branch free compaction of the visible points of the tile
+			size_type count = 0;
+			for (size_type i = 0; i < n; ++i) {
+				selected[count] = i;
+				count += flags[i];
+			}
+			for (size_type k = 0; k < count; ++k) {
+				const auto i = selected[k];
+				result.points()[out + k] = pixel_type { u[i], v[i] };
+				visible[out + k] = tile + i;
+			}
+			out += count;
+		}
+	}, policy);
+
+	c.meta().gather(visible.data(), total, result.meta());
+	if (positions)
+		*positions = std::move(visible);
+	return result;
+}
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_PROJECTION_H_ */
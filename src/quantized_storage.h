@@ -0,0 +1,453 @@
+#ifndef GEOM_SRC_QUANTIZED_STORAGE_H_
+#define GEOM_SRC_QUANTIZED_STORAGE_H_
+
+//This header contains the quantized layout of geom::collection,
+//which stores points as fixed point integer codes with a common step and offset.
+//Points are decoded on the fly by element access, transform kernels and block views,
+//and encoded again when they are written.
+
+#include "storage.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+namespace fc
+{
+namespace geom
+{
+
+/**
+ * \brief Layout policy storing every coordinate as integer code in its own aligned array.
+ *
+ * Coordinate r of a point is offset[r] + step * code, see quantization.
+ * The representable coordinates are offset + step * [lowest code, highest code] along every axis, see quantization::bounds.
+ * The default int32_t codes cover +-2147 km at the default millimetre step
+ * and store a Vector3d in 12 instead of 24 bytes.
+ * int16_t codes take 6 bytes but cover only 65536 steps per axis, +-32.7 m at millimetre resolution,
+ * the step has to be chosen for the extent of the data then.
+ * Writing a coordinate outside that range or not finite fails an assertion in debug builds
+ * and saturates to the nearest representable value otherwise.
+ *
+ * \tparam code_t signed integer type of the codes.
+ */
+template<class code_t = std::int32_t>
+struct quantized_layout {
+	static_assert(std::is_integral<code_t>::value && std::is_signed<code_t>::value,
+			"quantized_layout requires signed integer codes");
+	using code_type = code_t;
+};
+
+namespace detail
+{
+
+/// lowest code of @p code_t as @p scalar, a power of two and thus exact.
+template<class code_t, class scalar>
+constexpr scalar lowest_code() noexcept {
+	return scalar(std::numeric_limits<code_t>::lowest());
+}
+
+/// highest code of @p code_t which is exactly representable in @p scalar, e.g. 2^31 - 128 for int32_t and float.
+template<class code_t, class scalar>
+constexpr scalar highest_code() noexcept {
+	using code_limits = std::numeric_limits<code_t>;
+	using scalar_limits = std::numeric_limits<scalar>;
+	return code_limits::digits <= scalar_limits::digits ? scalar(code_limits::max())
+			: scalar(code_limits::max() - ((code_t(1) << (code_limits::digits - scalar_limits::digits)) - 1));
+}
+
+} // namespace detail
+
+/**
+ * \brief Step and offset of the fixed point codes of quantized_layout.
+ *
+ * Precision guarantee: every coordinate within bounds() is stored with an error of at most max_error(),
+ * half a step, plus the rounding error of computing offset + step * code in scalar.
+ * Coordinates outside bounds() are rejected by an assertion in debug builds and saturate in release builds.
+ * Transformations decode, transform and encode the points again,
+ * thus every transformation adds at most max_error().
+ */
+template<class scalar, int dim>
+struct quantization {
+	using vector_type = Eigen::Matrix<scalar, dim, 1, Eigen::DontAlign>;
+
+	quantization() = default;
+	/// Codes of step @p step centred at @p offset.
+	explicit quantization(scalar step, const vector_type& offset = vector_type::Zero()) :
+			step { step }, offset { offset } {
+	}
+
+	/// distance between two consecutive codes, millimetres for coordinates in metres by default
+	scalar step = scalar(1) / 1000;
+	/// coordinates of code zero
+	vector_type offset = vector_type::Zero();
+
+	/// Largest error of a stored coordinate within bounds().
+	scalar max_error() const noexcept {
+		return step / 2;
+	}
+
+	/// Box of coordinates representable with codes of @p code_t.
+	template<class code_t>
+	Eigen::AlignedBox<scalar, dim> bounds() const {
+		const scalar lowest = detail::lowest_code<code_t, scalar>();
+		const scalar highest = detail::highest_code<code_t, scalar>();
+		return Eigen::AlignedBox<scalar, dim> { offset.array() + step * lowest, offset.array() + step * highest };
+	}
+};
+
+namespace detail
+{
+
+/**
+ * \brief rounds @p v to the nearest code.
+ *
+ * Values beyond the range of @p code_t and values not finite fail an assertion in debug builds.
+ * Release builds saturate them at the range, NaN at the highest code, instead of an undefined conversion.
+ */
+template<class code_t, class scalar>
+code_t quantize(scalar v) {
+	constexpr scalar lowest = lowest_code<code_t, scalar>();
+	constexpr scalar highest = highest_code<code_t, scalar>();
+	assert(std::isfinite(v) && v >= lowest - scalar(0.5) && v <= highest + scalar(0.5)
+			&& "coordinate outside the range of the quantization");
+	//rounding before clamping vectorizes to a single round, min and max, unlike std::lround,
+	//the comparisons of min and max are false for NaN which thus ends up as highest
+	return code_t(std::max(lowest, std::min(highest, std::rint(v))));
+}
+
+/**
+ * \brief applies point kernel @p k to the quantized points at @p src and writes them to @p dst.
+ *
+ * Points are decoded with quantization @p src_q and encoded with @p dst_q, see apply_quantized.
+ * @p dst may be @p src, every tile is decoded before it is written.
+ */
+template<class code_t, class scalar, int dim, class kernel_t>
+void apply_quantized(const code_t* src, std::size_t src_stride, const quantization<scalar, dim>& src_q,
+		code_t* dst, std::size_t dst_stride, const quantization<scalar, dim>& dst_q,
+		std::size_t count, const kernel_t& k) {
+	constexpr std::size_t tile = 256;
+	alignas(64) scalar buffer[dim * tile];
+	const scalar step = src_q.step;
+	const scalar inverse = scalar(1) / dst_q.step;
+	for (std::size_t first = 0; first < count; first += tile) {
+		const auto n = std::min(tile, count - first);
+		for (int r = 0; r < dim; ++r) {
+			const code_t* __restrict in = src + r * src_stride + first;
+			scalar* __restrict out = buffer + r * tile;
+			const scalar offset = src_q.offset[r];
+			for (std::size_t i = 0; i < n; ++i)
+				out[i] = offset + step * scalar(in[i]);
+		}
+		apply_rows(buffer, n, tile, k, std::integral_constant<int, dim> { });
+		for (int r = 0; r < dim; ++r) {
+			const scalar* __restrict in = buffer + r * tile;
+			code_t* __restrict out = dst + r * dst_stride + first;
+			const scalar offset = dst_q.offset[r];
+			for (std::size_t i = 0; i < n; ++i)
+				out[i] = quantize<code_t>((in[i] - offset) * inverse);
+		}
+	}
+}
+
+/**
+ * \brief applies point kernel @p k to quantized points stored as one code array per coordinate.
+ *
+ * Code of coordinate r of point i is found at data[r * row_stride + i].
+ * Points are decoded tile by tile into a buffer on the stack, transformed there with apply_rows
+ * and encoded again, only the codes are read from and written to memory.
+ * Each of the three loops is a simple stream, which the compiler vectorizes.
+ */
+template<class code_t, class scalar, int dim, class kernel_t>
+void apply_quantized(code_t* data, std::size_t count, std::size_t row_stride, const kernel_t& k,
+		const quantization<scalar, dim>& q) {
+	apply_quantized(data, row_stride, q, data, row_stride, q, count, k);
+}
+
+} // namespace detail
+
+/**
+ * \brief point block stored as one aligned array of integer codes per coordinate.
+ *
+ * Element access returns decoded copies, the reference proxy of the non const access
+ * encodes assigned points.
+ * Block views decode on the fly, reductions thus read only the codes.
+ * The quantization is set with requantize(), which re-encodes the stored points.
+ */
+template<class code_t, class vector_t, class allocator_t>
+class point_storage<quantized_layout<code_t>, vector_t, allocator_t> {
+public:
+	using vector_type = vector_t;
+	using scalar_type = typename vector_type::Scalar;
+	static constexpr int dimension = vector_type::RowsAtCompileTime;
+	using size_type = std::size_t;
+	using allocator_type = allocator_t;
+	using code_type = code_t;
+	using quantization_type = quantization<scalar_type, dimension>;
+
+	/// Proxy of a stored point, converts to vector_type and encodes assigned points.
+	class reference {
+	public:
+		reference(point_storage* storage, size_type index) :
+				storage { storage }, index { index } {
+		}
+		reference(const reference&) = default;
+
+		operator vector_type() const {
+			return static_cast<const point_storage&>(*storage)[index];
+		}
+		/// decoded point
+		vector_type eval() const {
+			return *this;
+		}
+
+		reference& operator=(const vector_type& v) {
+			storage->store(index, v);
+			return *this;
+		}
+		template<class derived>
+		reference& operator=(const Eigen::MatrixBase<derived>& v) {
+			return *this = vector_type(v);
+		}
+		/// assigns the point referred to by @p o, not the reference itself
+		reference& operator=(const reference& o) {
+			return *this = o.eval();
+		}
+
+	private:
+		point_storage* storage;
+		size_type index;
+	};
+	using const_reference = vector_type;
+	using iterator = detail::proxy_iterator<point_storage, reference>;
+	using const_iterator = detail::proxy_iterator<const point_storage, const_reference>;
+
+	point_storage() = default;
+	explicit point_storage(const allocator_type& alloc) :
+			codes(alloc) {
+	}
+	/// Creates @p size points with all coordinates zero.
+	explicit point_storage(size_type size, const allocator_type& alloc = allocator_type()) :
+			point_storage(size, uninitialized, alloc) {
+		set_zero(0, size);
+	}
+	point_storage(size_type size, uninitialized_t, const allocator_type& alloc = allocator_type()) :
+			count { size },
+			stride { detail::aligned_row_size<code_t>(size) },
+			codes(stride * dimension, alloc) {
+	}
+
+	allocator_type get_allocator() const {
+		return codes.get_allocator();
+	}
+
+	size_type size() const noexcept {
+		return count;
+	}
+	bool empty() const noexcept {
+		return count == 0;
+	}
+	/// Resizes to @p size points, added points are zero.
+	void resize(size_type size) {
+		const auto old_count = count;
+		resize(size, uninitialized);
+		if (size > old_count)
+			set_zero(old_count, size);
+	}
+	/// Resizes to @p size points, the code arrays grow geometrically and never shrink.
+	void resize(size_type size, uninitialized_t) {
+		if (size > stride)
+			reallocate(std::max(detail::aligned_row_size<code_t>(size), std::min(2 * stride, max_size())));
+		count = size;
+	}
+	void reserve(size_type capacity) {
+		if (capacity > stride)
+			reallocate(detail::aligned_row_size<code_t>(capacity));
+	}
+
+	/// Largest number of points, such that the aligned code arrays fit into one allocation.
+	size_type max_size() const noexcept {
+		return detail::max_row_size<code_t>(codes.max_size(), dimension);
+	}
+
+	/**
+	 * \brief Appends the @p count points at @p values, encoded with the quantization of this storage.
+	 * \throws std::length_error if the result would exceed max_size().
+	 */
+	void append(const vector_type* values, size_type n) {
+		const auto first = count;
+		resize(detail::grown_size(first, n, max_size()), uninitialized);
+		for (size_type j = 0; j < n; ++j)
+			store(first + j, values[j]);
+	}
+	/**
+	 * \brief Appends all points of @p o, which may be this storage.
+	 *
+	 * Codes are copied as one block per coordinate if the quantizations are equal,
+	 * otherwise the points are decoded and encoded again.
+	 */
+	void append(const point_storage& o) {
+		const auto n = o.count;
+		const auto first = count;
+		const bool same = o.q.step == q.step && o.q.offset == q.offset;
+		resize(detail::grown_size(first, n, max_size()), uninitialized);
+		if (same) {
+			for (int r = 0; r < dimension; ++r)
+				std::copy_n(o.row(r), n, row(r) + first);
+		} else {
+			for (size_type j = 0; j < n; ++j)
+				store(first + j, o[j]);
+		}
+	}
+
+	reference operator[](size_type i) {
+		return reference { this, i };
+	}
+	const_reference operator[](size_type i) const {
+		vector_type v;
+		for (int r = 0; r < dimension; ++r)
+			v[r] = q.offset[r] + q.step * scalar_type(codes[r * stride + i]);
+		return v;
+	}
+
+	iterator begin() noexcept {
+		return iterator { this, 0 };
+	}
+	iterator end() noexcept {
+		return iterator { this, count };
+	}
+	const_iterator begin() const noexcept {
+		return const_iterator { this, 0 };
+	}
+	const_iterator end() const noexcept {
+		return const_iterator { this, count };
+	}
+
+	/// Quantization of the stored codes.
+	const quantization_type& get_quantization() const noexcept {
+		return q;
+	}
+	/// Changes the quantization to @p next and re-encodes all stored points.
+	void requantize(const quantization_type& next) {
+		for (size_type i = 0; i < count; ++i) {
+			const vector_type v = (*this)[i];
+			for (int r = 0; r < dimension; ++r)
+				codes[r * stride + i] = detail::quantize<code_t>((v[r] - next.offset[r]) / next.step);
+		}
+		q = next;
+	}
+	/// Box of coordinates representable with the current quantization.
+	Eigen::AlignedBox<scalar_type, dimension> bounds() const {
+		return q.template bounds<code_t>();
+	}
+
+	/// Stores point @p v at position @p i, rounded to the nearest code.
+	void store(size_type i, const vector_type& v) {
+		for (int r = 0; r < dimension; ++r)
+			codes[r * stride + i] = detail::quantize<code_t>((v[r] - q.offset[r]) / q.step);
+	}
+
+	/// Pointer to the aligned code array of coordinate @p r.
+	code_t* row(int r) noexcept {
+		return codes.data() + r * stride;
+	}
+	const code_t* row(int r) const noexcept {
+		return codes.data() + r * stride;
+	}
+
+	/// Applies point kernel @p k to @p n points starting at @p first.
+	template<class kernel_t>
+	void apply(const kernel_t& k, size_type first, size_type n) {
+		detail::apply_quantized(codes.data() + first, n, stride, k, q);
+	}
+	/**
+	 * \brief Writes the @p n points of @p src starting at @p first transformed by @p k to the same positions.
+	 *
+	 * Points are decoded with the quantization of @p src and encoded with the one of this storage.
+	 */
+	template<class kernel_t>
+	void apply(const kernel_t& k, size_type first, size_type n, const point_storage& src) {
+		detail::apply_quantized(src.codes.data() + first, src.stride, src.q, codes.data() + first, stride, q, n, k);
+	}
+
+	/// Read only Eigen expression decoding @p n points starting at @p first, one point per column.
+	auto block(size_type first, size_type n) const {
+		using matrix_t = Eigen::Matrix<code_t, dimension, Eigen::Dynamic, Eigen::RowMajor>;
+		const Eigen::Map<const matrix_t, Eigen::Unaligned, Eigen::OuterStride<>> block_codes {
+				codes.data() + first, dimension, Eigen::Index(n), Eigen::OuterStride<>(stride) };
+		return (block_codes.template cast<scalar_type>() * q.step).colwise() + q.offset;
+	}
+
+	/**
+	 * \brief Keeps only the @p n points at the increasing positions @p indices, in that order.
+	 *
+	 * The code arrays are compacted in place, the allocation is kept.
+	 */
+	void select(const size_type* indices, size_type n) {
+		for (int r = 0; r < dimension; ++r)
+			detail::gather_points<1>(row(r), indices, n, row(r));
+		count = n;
+	}
+
+	/**
+	 * \brief Copies the codes of the @p n points of @p src at positions @p indices to the positions [out, out + n).
+	 *
+	 * This storage takes over the quantization of @p src, codes stored before with another quantization change their meaning.
+	 * @p src may be this storage if the indices increase and indices[j] >= out + j, which compacts in place.
+	 */
+	void copy_selected(const point_storage& src, const size_type* indices, size_type n, size_type out) {
+		q = src.q;
+		for (int r = 0; r < dimension; ++r)
+			detail::gather_points<1>(src.row(r), indices, n, row(r) + out);
+	}
+
+	/// Copies the @p n points at positions @p indices into @p out, which takes over the quantization.
+	void gather(const size_type* indices, size_type n, point_storage& out) const {
+		out = point_storage(n, uninitialized, out.get_allocator());
+		out.q = q;
+		for (int r = 0; r < dimension; ++r)
+			detail::gather_points<1>(row(r), indices, n, out.row(r));
+	}
+
+private:
+	using buffer_t = detail::storage_vector<code_t, allocator_t>;
+
+	/// moves the code arrays to arrays of @p new_stride codes.
+	void reallocate(size_type new_stride) {
+		buffer_t resized(new_stride * dimension, codes.get_allocator());
+		for (int r = 0; r < dimension; ++r)
+			std::copy_n(row(r), count, resized.data() + r * new_stride);
+		codes.swap(resized);
+		stride = new_stride;
+	}
+
+	void set_zero(size_type first, size_type last) {
+		for (int r = 0; r < dimension; ++r)
+			std::fill(row(r) + first, row(r) + last, detail::quantize<code_t>(-q.offset[r] / q.step));
+	}
+
+	size_type count = 0;
+	/// distance in codes between the start of two code arrays.
+	size_type stride = 0;
+	buffer_t codes;
+	quantization_type q;
+};
+
+namespace detail
+{
+
+template<class code_t, class vector_t, class allocator_t>
+struct stored_point_bytes<point_storage<quantized_layout<code_t>, vector_t, allocator_t>> : std::integral_constant<
+		std::size_t, sizeof(code_t) * vector_t::RowsAtCompileTime> {
+};
+
+} // namespace detail
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_QUANTIZED_STORAGE_H_ */
@@ -0,0 +1,145 @@
+#ifndef GEOM_SRC_REDUCTION_H_
+#define GEOM_SRC_REDUCTION_H_
+
+//This header contains the fused point reductions of geom::collection.
+//Bounding box, centroid and covariance are computed in a single pass over the point block.
+
+#include "config.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+
+namespace fc
+{
+namespace geom
+{
+
+/**
+ * \brief Bounding box, centroid and covariance of a set of points.
+ *
+ * Partial statistics of disjoint sets of points are merged with operator+=,
+ * which allows computing them blockwise in parallel.
+ */
+template<class scalar, int dim>
+struct point_statistics {
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+	using vector_type = Eigen::Matrix<scalar, dim, 1>;
+	using matrix_type = Eigen::Matrix<scalar, dim, dim>;
+	using box_type = Eigen::AlignedBox<scalar, dim>;
+
+	/// number of points
+	std::size_t count = 0;
+	/// axis aligned bounding box, empty if count == 0
+	box_type bounds { };
+	/// centroid of the points
+	vector_type mean = vector_type::Zero();
+	/// sum of outer products of the deviations from the mean
+	matrix_type scatter = matrix_type::Zero();
+
+	const vector_type& centroid() const noexcept {
+		return mean;
+	}
+
+	/// Population covariance of the points, zero for an empty set.
+	matrix_type covariance() const {
+		return count == 0 ? matrix_type(matrix_type::Zero()) : matrix_type(scatter / scalar(count));
+	}
+
+	/// Merges statistics of a disjoint set of points @p o into this.
+	point_statistics& operator+=(const point_statistics& o) {
+		if (o.count == 0)
+			return *this;
+		if (count == 0)
+			return *this = o;
+		const scalar n = scalar(count + o.count);
+		const vector_type delta = o.mean - mean;
+		scatter += o.scatter + delta * delta.transpose() * (scalar(count) * scalar(o.count) / n);
+		mean += delta * (scalar(o.count) / n);
+		bounds.extend(o.bounds);
+		count += o.count;
+		return *this;
+	}
+};
+
+namespace detail
+{
+
+/// Number of independent accumulators per statistic in block_statistics.
+constexpr int reduction_lanes = 8;
+
+/**
+ * \brief point_statistics of the points in @p block, one point per column.
+ *
+ * Every statistic is accumulated in reduction_lanes independent partial sums,
+ * point i contributing to lane i % reduction_lanes.
+ * This breaks the dependency chain of the sums and lets the compiler vectorize across points.
+ * Deviations are accumulated relative to the first point of the block,
+ * which avoids cancellation for points far from the origin.
+ */
+template<class block_t>
+auto block_statistics(const block_t& block) {
+	using scalar = typename block_t::Scalar;
+	constexpr int dim = block_t::RowsAtCompileTime;
+	constexpr int lanes = reduction_lanes;
+
+	point_statistics<scalar, dim> s { };
+	s.count = block.cols();
+	if (s.count == 0)
+		return s;
+
+	scalar shift[dim], lower[dim][lanes], upper[dim][lanes], sum[dim][lanes];
+	scalar cross[dim][dim][lanes];
+	for (int r = 0; r < dim; ++r) {
+		shift[r] = block.coeff(r, 0);
+		for (int l = 0; l < lanes; ++l) {
+			lower[r][l] = upper[r][l] = shift[r];
+			sum[r][l] = 0;
+			for (int c = 0; c < dim; ++c)
+				cross[r][c][l] = 0;
+		}
+	}
+
+	const auto accumulate = [&](Eigen::Index first, int count) {
+		scalar deviation[dim][lanes];
+		for (int r = 0; r < dim; ++r)
+			for (int l = 0; l < count; ++l) {
+				const scalar v = block.coeff(r, first + l);
+				lower[r][l] = v < lower[r][l] ? v : lower[r][l];
+				upper[r][l] = v > upper[r][l] ? v : upper[r][l];
+				deviation[r][l] = v - shift[r];
+				sum[r][l] += deviation[r][l];
+			}
+		for (int r = 0; r < dim; ++r)
+			for (int c = r; c < dim; ++c)
+				for (int l = 0; l < count; ++l)
+					cross[r][c][l] += deviation[r][l] * deviation[c][l];
+	};
+
+	const Eigen::Index full = block.cols() - block.cols() % lanes;
+	for (Eigen::Index i = 0; i < full; i += lanes)
+		accumulate(i, lanes);
+	accumulate(full, int(block.cols() - full));
+
+	using vector_type = typename point_statistics<scalar, dim>::vector_type;
+	vector_type total;
+	for (int r = 0; r < dim; ++r) {
+		s.bounds.min()[r] = *std::min_element(lower[r], lower[r] + lanes);
+		s.bounds.max()[r] = *std::max_element(upper[r], upper[r] + lanes);
+		total[r] = std::accumulate(sum[r], sum[r] + lanes, scalar(0));
+		for (int c = r; c < dim; ++c)
+			s.scatter(r, c) = s.scatter(c, r) = std::accumulate(cross[r][c], cross[r][c] + lanes, scalar(0));
+	}
+	const scalar n = scalar(s.count);
+	s.mean = Eigen::Map<const vector_type>(shift) + total / n;
+	s.scatter -= total * total.transpose() / n;
+	return s;
+}
+
+} // namespace detail
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_REDUCTION_H_ */
@@ -0,0 +1,881 @@
+#ifndef GEOM_SRC_STORAGE_H_
+#define GEOM_SRC_STORAGE_H_
+
+//This header contains the storage policies for the point block of geom::collection.
+//A layout policy is a tag type, point_storage is specialized for every layout
+//and provides element access, iteration, read only views of point blocks
+//and the loops applying point kernels (see transform_kinds.h) to that layout.
+
+#include "allocator.h"
+#include "config.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+namespace fc
+{
+namespace geom
+{
+
+/// Layout policy storing points as contiguous array of vector_type (array of structs).
+struct packed_layout {};
+
+/**
+ * \brief Layout policy storing every coordinate in its own aligned array.
+ *
+ * All x coordinates are stored contiguously, followed by all y coordinates etc.
+ * Kernels can thus operate on full SIMD vectors of a single coordinate.
+ */
+struct soa_layout {};
+
+/**
+ * \brief Layout policy storing every point padded to four lanes.
+ *
+ * The fourth lane holds the homogeneous coordinate w = 1.
+ * Points start at 16 byte boundaries, which allows aligned vector loads per point
+ * at the cost of one third more memory for 3D points.
+ */
+struct padded_layout {};
+
+template<class layout, class vector_t,
+		class allocator_t = Eigen::aligned_allocator<typename vector_t::Scalar>>
+class point_storage;
+
+/**
+ * \brief Placement of the scalars of a point block.
+ *
+ * Coordinate r of point i is at i * point_stride + r * coordinate_stride,
+ * the block spans size scalars including padding.
+ */
+struct block_geometry {
+	std::size_t point_stride;
+	std::size_t coordinate_stride;
+	std::size_t size;
+};
+
+/**
+ * \brief Layout used by geom::collection if no layout is given.
+ *
+ * packed_layout unless configured otherwise, see GEOM_PAD_VECTOR3F in config.h.
+ */
+template<class vector_t>
+struct default_layout {
+	using type = packed_layout;
+};
+
+#ifdef GEOM_PAD_VECTOR3F
+template<>
+struct default_layout<Vector3f> {
+	using type = padded_layout;
+};
+#endif
+
+namespace detail
+{
+
+/**
+ * \brief applies point kernel @p k to a contiguous block of points.
+ *
+ * Points are expected as @p count groups of dim scalars, each group starting
+ * stride scalars after the previous one.
+ * \tparam stride distance in scalars between two consecutive points.
+ * The kernel is copied into the function, such that its coefficients stay in registers,
+ * and works on plain scalars, which allows the compiler to vectorize across points
+ * instead of issuing one small matrix product per point.
+ *
+ * \param k transform kind with member apply(const scalar (&in)[dim], scalar (&out)[dim]).
+ */
+template<int stride, class scalar, class kernel_t>
+void apply_points(scalar* __restrict data, std::size_t count, const kernel_t k) {
+	constexpr int dim = kernel_t::dimension;
+	static_assert(dim <= stride, "kernel dimension exceeds point stride");
+
+	for (std::size_t i = 0; i < count; ++i) {
+		scalar* p = data + i * stride;
+		scalar in[dim];
+		scalar out[dim];
+		for (int r = 0; r < dim; ++r)
+			in[r] = p[r];
+		k.apply(in, out);
+		for (int r = 0; r < dim; ++r)
+			p[r] = out[r];
+	}
+}
+
+/// applies point kernel @p k to @p count points at @p src and writes them to @p dst, see apply_points.
+template<int stride, class scalar, class kernel_t>
+void apply_points(const scalar* __restrict src, scalar* __restrict dst, std::size_t count, const kernel_t k) {
+	constexpr int dim = kernel_t::dimension;
+	static_assert(dim <= stride, "kernel dimension exceeds point stride");
+
+	for (std::size_t i = 0; i < count; ++i) {
+		scalar in[dim];
+		scalar out[dim];
+		for (int r = 0; r < dim; ++r)
+			in[r] = src[i * stride + r];
+		k.apply(in, out);
+		for (int r = 0; r < dim; ++r)
+			dst[i * stride + r] = out[r];
+	}
+}
+
+/**
+ * \brief applies point kernel @p k to 3D points stored as one array per coordinate.
+ *
+ * Coordinate r of point i is found at data[r * row_stride + i].
+ * Every output coordinate becomes a stream of multiply adds over the input rows.
+ */
+template<class scalar, class kernel_t>
+void apply_rows(scalar* data, std::size_t count, std::size_t row_stride, const kernel_t k,
+		std::integral_constant<int, 3>) {
+	scalar* __restrict x = data;
+	scalar* __restrict y = data + row_stride;
+	scalar* __restrict z = data + 2 * row_stride;
+	for (std::size_t i = 0; i < count; ++i) {
+		const scalar in[3] { x[i], y[i], z[i] };
+		scalar out[3];
+		k.apply(in, out);
+		x[i] = out[0];
+		y[i] = out[1];
+		z[i] = out[2];
+	}
+}
+
+/// applies point kernel @p k to 2D points stored as one array per coordinate.
+template<class scalar, class kernel_t>
+void apply_rows(scalar* data, std::size_t count, std::size_t row_stride, const kernel_t k,
+		std::integral_constant<int, 2>) {
+	scalar* __restrict x = data;
+	scalar* __restrict y = data + row_stride;
+	for (std::size_t i = 0; i < count; ++i) {
+		const scalar in[2] { x[i], y[i] };
+		scalar out[2];
+		k.apply(in, out);
+		x[i] = out[0];
+		y[i] = out[1];
+	}
+}
+
+/**
+ * \brief applies point kernel @p k to points stored as one array per coordinate at @p src
+ * and writes them to the coordinate arrays at @p dst.
+ */
+template<class scalar, int dim, class kernel_t>
+void apply_rows(const scalar* __restrict src, std::size_t src_stride, scalar* __restrict dst,
+		std::size_t dst_stride, std::size_t count, const kernel_t k, std::integral_constant<int, dim>) {
+	for (std::size_t i = 0; i < count; ++i) {
+		scalar in[dim];
+		scalar out[dim];
+		for (int r = 0; r < dim; ++r)
+			in[r] = src[r * src_stride + i];
+		k.apply(in, out);
+		for (int r = 0; r < dim; ++r)
+			dst[r * dst_stride + i] = out[r];
+	}
+}
+
+/**
+ * \brief copies the points at @p indices of @p src to the first @p count points of @p dst.
+ *
+ * Points are stored as in apply_points.
+ * @p dst may be @p src if @p indices are increasing,
+ * as every point is then read before it is overwritten.
+ */
+template<int stride, class scalar, class index_t>
+void gather_points(const scalar* src, const index_t* indices, std::size_t count, scalar* dst) {
+	for (std::size_t j = 0; j < count; ++j) {
+		const scalar* p = src + indices[j] * stride;
+		for (int r = 0; r < stride; ++r)
+			dst[j * stride + r] = p[r];
+	}
+}
+
+/**
+ * \brief random access iterator over a storage yielding proxies by value.
+ *
+ * Used by layouts where points are not stored as vector_type objects
+ * and element access returns an Eigen::Map instead of a reference.
+ */
+template<class storage_t, class reference_t,
+		class value_t = typename std::remove_const<storage_t>::type::vector_type>
+class proxy_iterator {
+public:
+	using difference_type = std::ptrdiff_t;
+	using value_type = value_t;
+	using reference = reference_t;
+	using pointer = void;
+	using iterator_category = std::random_access_iterator_tag;
+
+	proxy_iterator() = default;
+	proxy_iterator(storage_t* storage, std::size_t index) :
+			storage { storage }, index { index } {
+	}
+
+	reference operator*() const {
+		return (*storage)[index];
+	}
+	reference operator[](difference_type n) const {
+		return (*storage)[index + n];
+	}
+
+	proxy_iterator& operator++() {
+		++index;
+		return *this;
+	}
+	proxy_iterator operator++(int) {
+		return proxy_iterator { storage, index++ };
+	}
+	proxy_iterator& operator--() {
+		--index;
+		return *this;
+	}
+	proxy_iterator operator--(int) {
+		return proxy_iterator { storage, index-- };
+	}
+	proxy_iterator& operator+=(difference_type n) {
+		index += n;
+		return *this;
+	}
+	proxy_iterator& operator-=(difference_type n) {
+		index -= n;
+		return *this;
+	}
+	proxy_iterator operator+(difference_type n) const {
+		return proxy_iterator { storage, index + n };
+	}
+	proxy_iterator operator-(difference_type n) const {
+		return proxy_iterator { storage, index - n };
+	}
+	difference_type operator-(const proxy_iterator& o) const {
+		return static_cast<difference_type>(index) - static_cast<difference_type>(o.index);
+	}
+
+	bool operator==(const proxy_iterator& o) const {
+		return index == o.index && storage == o.storage;
+	}
+	bool operator!=(const proxy_iterator& o) const {
+		return !(*this == o);
+	}
+	bool operator<(const proxy_iterator& o) const {
+		assert(storage == o.storage);
+		return index < o.index;
+	}
+	bool operator>(const proxy_iterator& o) const {
+		return o < *this;
+	}
+	bool operator<=(const proxy_iterator& o) const {
+		return !(o < *this);
+	}
+	bool operator>=(const proxy_iterator& o) const {
+		return !(*this < o);
+	}
+
+private:
+	storage_t* storage = nullptr;
+	std::size_t index = 0;
+};
+
+/// number of scalars in one alignment unit of a row layout.
+template<class scalar>
+constexpr std::size_t row_lanes() {
+	return EIGEN_MAX_ALIGN_BYTES > sizeof(scalar) ? EIGEN_MAX_ALIGN_BYTES / sizeof(scalar) : 1;
+}
+
+/// rounds @p size up, such that every coordinate array of a row layout starts aligned.
+template<class scalar>
+std::size_t aligned_row_size(std::size_t size) {
+	return (size + row_lanes<scalar>() - 1) / row_lanes<scalar>() * row_lanes<scalar>();
+}
+
+/// largest aligned row size, such that @p rows rows fit into @p max_elements scalars.
+template<class scalar>
+std::size_t max_row_size(std::size_t max_elements, std::size_t rows) {
+	return max_elements / rows / row_lanes<scalar>() * row_lanes<scalar>();
+}
+
+} // namespace detail
+
+/**
+ * \brief point block stored as contiguous array of vector_type.
+ *
+ * This is the default layout of geom::collection,
+ * element access returns plain references to vector_type.
+ */
+template<class vector_t, class allocator_t>
+class point_storage<packed_layout, vector_t, allocator_t> {
+	using buffer_t = detail::storage_vector<vector_t, allocator_t>;
+
+public:
+	using vector_type = vector_t;
+	using scalar_type = typename vector_type::Scalar;
+	static constexpr int dimension = vector_type::RowsAtCompileTime;
+	using size_type = std::size_t;
+	using allocator_type = allocator_t;
+	using reference = vector_type&;
+	using const_reference = const vector_type&;
+	using iterator = typename buffer_t::iterator;
+	using const_iterator = typename buffer_t::const_iterator;
+
+	point_storage() = default;
+	explicit point_storage(const allocator_type& alloc) :
+			points(alloc) {
+	}
+	/// Eigen vectors are not initialized on construction, the points are thus left uninitialized.
+	explicit point_storage(size_type size, const allocator_type& alloc = allocator_type()) :
+			points(size, alloc) {
+	}
+	point_storage(size_type size, uninitialized_t, const allocator_type& alloc = allocator_type()) :
+			points(size, alloc) {
+	}
+
+	allocator_type get_allocator() const {
+		return points.get_allocator();
+	}
+
+	size_type size() const noexcept {
+		return points.size();
+	}
+	bool empty() const noexcept {
+		return points.empty();
+	}
+	void resize(size_type size) {
+		points.resize(size);
+	}
+	void resize(size_type size, uninitialized_t) {
+		points.resize(size);
+	}
+	void reserve(size_type capacity) {
+		points.reserve(capacity);
+	}
+
+	size_type max_size() const noexcept {
+		return points.max_size();
+	}
+
+	/**
+	 * \brief Appends the @p count points at @p values as one block copy, @p values must not point into this storage.
+	 * \throws std::length_error if the result would exceed max_size().
+	 */
+	void append(const vector_type* values, size_type count) {
+		static_assert(sizeof(vector_type) == dimension * sizeof(scalar_type),
+				"append requires densely packed vector_type");
+		const auto first = size();
+		resize(detail::grown_size(first, count, max_size()), uninitialized);
+		std::copy_n(reinterpret_cast<const scalar_type*>(values), count * dimension, data() + first * dimension);
+	}
+	/// Appends all points of @p o as one block copy, @p o may be this storage.
+	void append(const point_storage& o) {
+		const auto count = o.size();
+		const auto first = size();
+		resize(detail::grown_size(first, count, max_size()), uninitialized);
+		std::copy_n(o.data(), count * dimension, data() + first * dimension);
+	}
+
+	reference operator[](size_type i) {
+		return points[i];
+	}
+	const_reference operator[](size_type i) const {
+		return points[i];
+	}
+
+	iterator begin() noexcept {
+		return points.begin();
+	}
+	iterator end() noexcept {
+		return points.end();
+	}
+	const_iterator begin() const noexcept {
+		return points.begin();
+	}
+	const_iterator end() const noexcept {
+		return points.end();
+	}
+
+	/// Scalars of the point block, coordinate r of point i is at i * point_stride() + r * coordinate_stride().
+	const scalar_type* data() const noexcept {
+		return reinterpret_cast<const scalar_type*>(points.data());
+	}
+	scalar_type* data() noexcept {
+		return reinterpret_cast<scalar_type*>(points.data());
+	}
+	/// Geometry of the point block of a storage of @p count points.
+	static constexpr block_geometry geometry(size_type count) noexcept {
+		return { dimension, 1, count * dimension };
+	}
+	/// Number of scalars of the point block including padding.
+	size_type data_size() const noexcept {
+		return points.size() * dimension;
+	}
+	static constexpr size_type point_stride() noexcept {
+		return dimension;
+	}
+	static constexpr size_type coordinate_stride() noexcept {
+		return 1;
+	}
+
+	/// Applies point kernel @p k to @p count points starting at @p first.
+	template<class kernel_t>
+	void apply(const kernel_t& k, size_type first, size_type count) {
+		static_assert(sizeof(vector_type) == dimension * sizeof(scalar_type),
+				"apply requires densely packed vector_type");
+		if (count == 0)
+			return;
+		detail::apply_points<dimension>(points[first].data(), count, k);
+	}
+	/**
+	 * \brief Writes the @p count points of @p src starting at @p first transformed by @p k to the same positions.
+	 *
+	 * This storage has to hold at least first + count points and must not be @p src.
+	 */
+	template<class kernel_t>
+	void apply(const kernel_t& k, size_type first, size_type count, const point_storage& src) {
+		if (count == 0)
+			return;
+		detail::apply_points<dimension>(src.points[first].data(), points[first].data(), count, k);
+	}
+
+	/// Read only Eigen view of @p count points starting at @p first, one point per column.
+	auto block(size_type first, size_type count) const {
+		using matrix_t = Eigen::Matrix<scalar_type, dimension, Eigen::Dynamic>;
+		return Eigen::Map<const matrix_t> { points.data()->data() + first * dimension,
+				dimension, Eigen::Index(count) };
+	}
+
+	/// Keeps only the @p count points at the increasing positions @p indices, in that order.
+	void select(const size_type* indices, size_type count) {
+		for (size_type j = 0; j < count; ++j)
+			points[j] = points[indices[j]];
+		points.resize(count);
+	}
+
+	/**
+	 * \brief Writes the @p count points of @p src at positions @p indices to the positions [out, out + count).
+	 *
+	 * @p src may be this storage if the indices increase and indices[j] >= out + j, which compacts in place.
+	 */
+	void copy_selected(const point_storage& src, const size_type* indices, size_type count, size_type out) {
+		for (size_type j = 0; j < count; ++j)
+			points[out + j] = src.points[indices[j]];
+	}
+
+	/// Copies the @p count points at positions @p indices into @p out.
+	void gather(const size_type* indices, size_type count, point_storage& out) const {
+		out.points.resize(count);
+		for (size_type j = 0; j < count; ++j)
+			out.points[j] = points[indices[j]];
+	}
+
+private:
+	buffer_t points;
+};
+
+/**
+ * \brief point block stored as one aligned array per coordinate.
+ *
+ * Element access returns an Eigen::Map with an inner stride,
+ * which behaves like a reference to vector_type.
+ * Every coordinate array starts at an address aligned to EIGEN_MAX_ALIGN_BYTES.
+ */
+template<class vector_t, class allocator_t>
+class point_storage<soa_layout, vector_t, allocator_t> {
+public:
+	using vector_type = vector_t;
+	using scalar_type = typename vector_type::Scalar;
+	static constexpr int dimension = vector_type::RowsAtCompileTime;
+	using size_type = std::size_t;
+	using allocator_type = allocator_t;
+	using reference = Eigen::Map<vector_type, Eigen::Unaligned, Eigen::InnerStride<>>;
+	using const_reference = Eigen::Map<const vector_type, Eigen::Unaligned, Eigen::InnerStride<>>;
+	using iterator = detail::proxy_iterator<point_storage, reference>;
+	using const_iterator = detail::proxy_iterator<const point_storage, const_reference>;
+
+	point_storage() = default;
+	explicit point_storage(const allocator_type& alloc) :
+			coordinates(alloc) {
+	}
+	/// Creates @p size points with all coordinates zero.
+	explicit point_storage(size_type size, const allocator_type& alloc = allocator_type()) :
+			count { size },
+			stride { detail::aligned_row_size<scalar_type>(size) },
+			coordinates(stride * dimension, scalar_type(), alloc) {
+	}
+	point_storage(size_type size, uninitialized_t, const allocator_type& alloc = allocator_type()) :
+			count { size },
+			stride { detail::aligned_row_size<scalar_type>(size) },
+			coordinates(stride * dimension, alloc) {
+	}
+
+	allocator_type get_allocator() const {
+		return coordinates.get_allocator();
+	}
+
+	size_type size() const noexcept {
+		return count;
+	}
+	bool empty() const noexcept {
+		return count == 0;
+	}
+	/// Resizes to @p size points, added points are zero.
+	void resize(size_type size) {
+		const auto old_count = count;
+		resize(size, uninitialized);
+		for (int r = 0; r < dimension && size > old_count; ++r)
+			std::fill(row(r) + old_count, row(r) + size, scalar_type(0));
+	}
+	/// Resizes to @p size points, the coordinate arrays grow geometrically and never shrink.
+	void resize(size_type size, uninitialized_t) {
+		if (size > stride)
+			reallocate(std::max(detail::aligned_row_size<scalar_type>(size), std::min(2 * stride, max_size())));
+		count = size;
+	}
+	void reserve(size_type capacity) {
+		if (capacity > stride)
+			reallocate(detail::aligned_row_size<scalar_type>(capacity));
+	}
+
+	/// Largest number of points, such that the aligned coordinate arrays fit into one allocation.
+	size_type max_size() const noexcept {
+		return detail::max_row_size<scalar_type>(coordinates.max_size(), dimension);
+	}
+
+	/**
+	 * \brief Appends the @p count points at @p values, which are scattered to the coordinate arrays.
+	 * \throws std::length_error if the result would exceed max_size().
+	 */
+	void append(const vector_type* values, size_type n) {
+		const auto first = count;
+		resize(detail::grown_size(first, n, max_size()), uninitialized);
+		for (int r = 0; r < dimension; ++r) {
+			scalar_type* out = row(r) + first;
+			for (size_type j = 0; j < n; ++j)
+				out[j] = values[j][r];
+		}
+	}
+	/// Appends all points of @p o as one block copy per coordinate, @p o may be this storage.
+	void append(const point_storage& o) {
+		const auto n = o.count;
+		const auto first = count;
+		resize(detail::grown_size(first, n, max_size()), uninitialized);
+		for (int r = 0; r < dimension; ++r)
+			std::copy_n(o.row(r), n, row(r) + first);
+	}
+
+	reference operator[](size_type i) {
+		return reference { coordinates.data() + i, Eigen::InnerStride<>(stride) };
+	}
+	const_reference operator[](size_type i) const {
+		return const_reference { coordinates.data() + i, Eigen::InnerStride<>(stride) };
+	}
+
+	iterator begin() noexcept {
+		return iterator { this, 0 };
+	}
+	iterator end() noexcept {
+		return iterator { this, count };
+	}
+	const_iterator begin() const noexcept {
+		return const_iterator { this, 0 };
+	}
+	const_iterator end() const noexcept {
+		return const_iterator { this, count };
+	}
+
+	/// Scalars of the point block, coordinate r of point i is at i * point_stride() + r * coordinate_stride().
+	const scalar_type* data() const noexcept {
+		return coordinates.data();
+	}
+	scalar_type* data() noexcept {
+		return coordinates.data();
+	}
+	/// Geometry of the point block of a storage of @p count points.
+	static block_geometry geometry(size_type count) noexcept {
+		const auto rows = detail::aligned_row_size<scalar_type>(count);
+		return { 1, rows, rows * dimension };
+	}
+	/// Number of scalars of the point block including padding and unused capacity, see geometry(size()) for the used part.
+	size_type data_size() const noexcept {
+		return coordinates.size();
+	}
+	static constexpr size_type point_stride() noexcept {
+		return 1;
+	}
+	size_type coordinate_stride() const noexcept {
+		return stride;
+	}
+
+	/// Pointer to the aligned array of coordinate @p r.
+	scalar_type* row(int r) noexcept {
+		return coordinates.data() + r * stride;
+	}
+	const scalar_type* row(int r) const noexcept {
+		return coordinates.data() + r * stride;
+	}
+
+	/// Applies point kernel @p k to @p n points starting at @p first.
+	template<class kernel_t>
+	void apply(const kernel_t& k, size_type first, size_type n) {
+		detail::apply_rows(coordinates.data() + first, n, stride, k,
+				std::integral_constant<int, dimension> { });
+	}
+	/// Writes the @p n points of @p src starting at @p first transformed by @p k to the same positions.
+	template<class kernel_t>
+	void apply(const kernel_t& k, size_type first, size_type n, const point_storage& src) {
+		detail::apply_rows(src.coordinates.data() + first, src.stride, coordinates.data() + first, stride, n, k,
+				std::integral_constant<int, dimension> { });
+	}
+
+	/// Read only Eigen view of @p n points starting at @p first, one point per column.
+	auto block(size_type first, size_type n) const {
+		using matrix_t = Eigen::Matrix<scalar_type, dimension, Eigen::Dynamic, Eigen::RowMajor>;
+		return Eigen::Map<const matrix_t, Eigen::Unaligned, Eigen::OuterStride<>> {
+				coordinates.data() + first, dimension, Eigen::Index(n),
+				Eigen::OuterStride<>(stride) };
+	}
+
+	/**
+	 * \brief Keeps only the @p n points at the increasing positions @p indices, in that order.
+	 *
+	 * The coordinate arrays are compacted in place, the allocation is kept.
+	 */
+	void select(const size_type* indices, size_type n) {
+		for (int r = 0; r < dimension; ++r)
+			detail::gather_points<1>(row(r), indices, n, row(r));
+		count = n;
+	}
+
+	/**
+	 * \brief Writes the @p n points of @p src at positions @p indices to the positions [out, out + n).
+	 *
+	 * @p src may be this storage if the indices increase and indices[j] >= out + j, which compacts in place.
+	 */
+	void copy_selected(const point_storage& src, const size_type* indices, size_type n, size_type out) {
+		for (int r = 0; r < dimension; ++r)
+			detail::gather_points<1>(src.row(r), indices, n, row(r) + out);
+	}
+
+	/// Copies the @p n points at positions @p indices into @p out.
+	void gather(const size_type* indices, size_type n, point_storage& out) const {
+		out = point_storage(n, uninitialized, out.get_allocator());
+		for (int r = 0; r < dimension; ++r)
+			detail::gather_points<1>(row(r), indices, n, out.row(r));
+	}
+
+private:
+	using buffer_t = detail::storage_vector<scalar_type, allocator_t>;
+
+	/// moves the coordinate arrays to arrays of @p new_stride scalars.
+	void reallocate(size_type new_stride) {
+		buffer_t resized(new_stride * dimension, coordinates.get_allocator());
+		for (int r = 0; r < dimension; ++r)
+			std::copy_n(row(r), count, resized.data() + r * new_stride);
+		coordinates.swap(resized);
+		stride = new_stride;
+	}
+
+	size_type count = 0;
+	/// distance in scalars between the start of two coordinate arrays.
+	size_type stride = 0;
+	buffer_t coordinates;
+};
+
+/**
+ * \brief point block stored as array of points padded to four lanes.
+ *
+ * Element access returns an aligned Eigen::Map to the first three lanes,
+ * which behaves like a reference to vector_type.
+ */
+template<class vector_t, class allocator_t>
+class point_storage<padded_layout, vector_t, allocator_t> {
+public:
+	using vector_type = vector_t;
+	using scalar_type = typename vector_type::Scalar;
+	static constexpr int dimension = vector_type::RowsAtCompileTime;
+	static_assert(dimension == 3, "padded_layout is only available for 3D points");
+	using size_type = std::size_t;
+	using allocator_type = allocator_t;
+	using reference = Eigen::Map<vector_type, Eigen::Aligned16>;
+	using const_reference = Eigen::Map<const vector_type, Eigen::Aligned16>;
+	using iterator = detail::proxy_iterator<point_storage, reference>;
+	using const_iterator = detail::proxy_iterator<const point_storage, const_reference>;
+
+	/// Number of scalars per point including padding.
+	static constexpr int lanes = 4;
+
+	point_storage() = default;
+	explicit point_storage(const allocator_type& alloc) :
+			lanes_data(alloc) {
+	}
+	/// Creates @p size points with all coordinates zero.
+	explicit point_storage(size_type size, const allocator_type& alloc = allocator_type()) :
+			lanes_data(size * lanes, scalar_type(), alloc) {
+		set_homogeneous(0, size);
+	}
+	/// Creates @p size points with uninitialized coordinates, the homogeneous lane is still set.
+	point_storage(size_type size, uninitialized_t, const allocator_type& alloc = allocator_type()) :
+			lanes_data(size * lanes, alloc) {
+		set_homogeneous(0, size);
+	}
+
+	allocator_type get_allocator() const {
+		return lanes_data.get_allocator();
+	}
+
+	size_type size() const noexcept {
+		return lanes_data.size() / lanes;
+	}
+	bool empty() const noexcept {
+		return lanes_data.empty();
+	}
+	void resize(size_type size) {
+		const auto old_size = this->size();
+		lanes_data.resize(size * lanes, scalar_type());
+		if (size > old_size)
+			set_homogeneous(old_size, size);
+	}
+	void resize(size_type size, uninitialized_t) {
+		const auto old_size = this->size();
+		lanes_data.resize(size * lanes);
+		if (size > old_size)
+			set_homogeneous(old_size, size);
+	}
+	void reserve(size_type capacity) {
+		lanes_data.reserve(capacity * lanes);
+	}
+
+	size_type max_size() const noexcept {
+		return lanes_data.max_size() / lanes;
+	}
+
+	/**
+	 * \brief Appends the @p count points at @p values.
+	 * \throws std::length_error if the result would exceed max_size().
+	 */
+	void append(const vector_type* values, size_type count) {
+		const auto first = size();
+		resize(detail::grown_size(first, count, max_size()), uninitialized);
+		for (size_type j = 0; j < count; ++j)
+			for (int r = 0; r < dimension; ++r)
+				lanes_data[(first + j) * lanes + r] = values[j][r];
+	}
+	/// Appends all points of @p o as one block copy, @p o may be this storage.
+	void append(const point_storage& o) {
+		const auto count = o.size();
+		const auto first = size();
+		lanes_data.resize(detail::grown_size(first, count, max_size()) * lanes);
+		std::copy_n(o.lanes_data.data(), count * lanes, lanes_data.data() + first * lanes);
+	}
+
+	reference operator[](size_type i) {
+		return reference { lanes_data.data() + i * lanes };
+	}
+	const_reference operator[](size_type i) const {
+		return const_reference { lanes_data.data() + i * lanes };
+	}
+
+	iterator begin() noexcept {
+		return iterator { this, 0 };
+	}
+	iterator end() noexcept {
+		return iterator { this, size() };
+	}
+	const_iterator begin() const noexcept {
+		return const_iterator { this, 0 };
+	}
+	const_iterator end() const noexcept {
+		return const_iterator { this, size() };
+	}
+
+	/// Scalars of the point block, coordinate r of point i is at i * point_stride() + r * coordinate_stride().
+	const scalar_type* data() const noexcept {
+		return lanes_data.data();
+	}
+	scalar_type* data() noexcept {
+		return lanes_data.data();
+	}
+	/// Geometry of the point block of a storage of @p count points.
+	static constexpr block_geometry geometry(size_type count) noexcept {
+		return { lanes, 1, count * lanes };
+	}
+	/// Number of scalars of the point block including padding.
+	size_type data_size() const noexcept {
+		return lanes_data.size();
+	}
+	static constexpr size_type point_stride() noexcept {
+		return lanes;
+	}
+	static constexpr size_type coordinate_stride() noexcept {
+		return 1;
+	}
+
+	/// Applies point kernel @p k to @p count points starting at @p first.
+	template<class kernel_t>
+	void apply(const kernel_t& k, size_type first, size_type count) {
+		detail::apply_points<lanes>(lanes_data.data() + first * lanes, count, k);
+	}
+	/// Writes the @p count points of @p src starting at @p first transformed by @p k to the same positions.
+	template<class kernel_t>
+	void apply(const kernel_t& k, size_type first, size_type count, const point_storage& src) {
+		detail::apply_points<lanes>(src.lanes_data.data() + first * lanes, lanes_data.data() + first * lanes, count, k);
+	}
+
+	/// Read only Eigen view of @p count points starting at @p first, one point per column.
+	auto block(size_type first, size_type count) const {
+		using matrix_t = Eigen::Matrix<scalar_type, dimension, Eigen::Dynamic>;
+		return Eigen::Map<const matrix_t, Eigen::Aligned16, Eigen::OuterStride<lanes>> {
+				lanes_data.data() + first * lanes, dimension, Eigen::Index(count) };
+	}
+
+	/// Keeps only the @p count points at the increasing positions @p indices, in that order.
+	void select(const size_type* indices, size_type count) {
+		detail::gather_points<lanes>(lanes_data.data(), indices, count, lanes_data.data());
+		lanes_data.resize(count * lanes);
+	}
+
+	/**
+	 * \brief Writes the @p count points of @p src at positions @p indices to the positions [out, out + count).
+	 *
+	 * @p src may be this storage if the indices increase and indices[j] >= out + j, which compacts in place.
+	 */
+	void copy_selected(const point_storage& src, const size_type* indices, size_type count, size_type out) {
+		detail::gather_points<lanes>(src.lanes_data.data(), indices, count, lanes_data.data() + out * lanes);
+	}
+
+	/// Copies the @p count points at positions @p indices into @p out.
+	void gather(const size_type* indices, size_type count, point_storage& out) const {
+		out.lanes_data.resize(count * lanes);
+		detail::gather_points<lanes>(lanes_data.data(), indices, count, out.lanes_data.data());
+	}
+
+private:
+	void set_homogeneous(size_type first, size_type last) {
+		for (auto i = first; i < last; ++i)
+			lanes_data[i * lanes + dimension] = scalar_type(1);
+	}
+
+	detail::storage_vector<scalar_type, allocator_t> lanes_data;
+};
+
+namespace detail
+{
+
+/// Bytes of point memory per point of point storage @p storage_t, used to account memory traffic.
+template<class storage_t>
+struct stored_point_bytes: std::integral_constant<std::size_t,
+		sizeof(typename storage_t::scalar_type) * storage_t::dimension> {
+};
+
+template<class vector_t, class allocator_t>
+struct stored_point_bytes<point_storage<padded_layout, vector_t, allocator_t>> : std::integral_constant<std::size_t,
+		sizeof(typename vector_t::Scalar) * point_storage<padded_layout, vector_t, allocator_t>::point_stride()> {
+};
+
+} // namespace detail
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_STORAGE_H_ */
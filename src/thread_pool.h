@@ -0,0 +1,269 @@
+#ifndef GEOM_SRC_THREAD_POOL_H_
+#define GEOM_SRC_THREAD_POOL_H_
+
+//This header contains the thread pool and execution policies used by the parallel
+//algorithms of geom.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace fc
+{
+namespace geom
+{
+
+/**
+ * \brief work stealing thread pool.
+ *
+ * Every worker owns a task queue. Workers take tasks from the back of their own queue
+ * and steal from the front of other queues when their own queue runs dry.
+ * Tasks submitted from outside the pool are distributed round robin.
+ */
+class thread_pool {
+public:
+	using task = std::function<void()>;
+
+	/// Creates pool with @p threads workers, at least one worker is always created.
+	explicit thread_pool(std::size_t threads = std::thread::hardware_concurrency()) {
+		threads = std::max<std::size_t>(threads, 1);
+		for (std::size_t i = 0; i < threads; ++i)
+			queues.emplace_back(new queue);
+		for (std::size_t i = 0; i < threads; ++i)
+			workers.emplace_back([this, i]() { run(i); });
+	}
+
+	~thread_pool() {
+		{
+			std::lock_guard<std::mutex> lock { sleep_mutex };
+			stopped = true;
+		}
+		wake_up.notify_all();
+		for (auto&& w : workers)
+			w.join();
+	}
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	/// Number of worker threads.
+	std::size_t size() const noexcept {
+		return workers.size();
+	}
+
+	/// Enqueues @p t for execution by one of the workers.
+	void submit(task t) {
+		const auto self = current_worker();
+		const auto target = self.first == this ?
+				self.second : next_queue++ % queues.size();
+		{
+			std::lock_guard<std::mutex> lock { queues[target]->mutex };
+			queues[target]->tasks.push_back(std::move(t));
+		}
+		{
+			std::lock_guard<std::mutex> lock { sleep_mutex };
+			++pending;
+		}
+		wake_up.notify_one();
+	}
+
+	/**
+	 * \brief Executes one pending task on the calling thread if there is one.
+	 *
+	 * Allows threads waiting for tasks to help instead of blocking.
+	 * \returns true if a task was executed.
+	 */
+	bool run_pending_task() {
+		const auto self = current_worker();
+		task t;
+		if (!take(self.first == this ? self.second : 0, t))
+			return false;
+		t();
+		return true;
+	}
+
+private:
+	struct queue {
+		std::mutex mutex;
+		std::deque<task> tasks;
+	};
+
+	/// pool and queue index of the calling thread, null if it is not a worker
+	static std::pair<thread_pool*, std::size_t>& current_worker() {
+		static thread_local std::pair<thread_pool*, std::size_t> worker { nullptr, 0 };
+		return worker;
+	}
+
+	bool take(std::size_t home, task& t) {
+		{
+			auto& own = *queues[home];
+			std::lock_guard<std::mutex> lock { own.mutex };
+			if (!own.tasks.empty()) {
+				t = std::move(own.tasks.back());
+				own.tasks.pop_back();
+				--pending;
+				return true;
+			}
+		}
+		for (std::size_t i = 1; i < queues.size(); ++i) {
+			auto& victim = *queues[(home + i) % queues.size()];
+			std::lock_guard<std::mutex> lock { victim.mutex };
+			if (!victim.tasks.empty()) {
+				t = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				--pending;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void run(std::size_t index) {
+		current_worker() = { this, index };
+		task t;
+		while (true) {
+			if (take(index, t)) {
+				t();
+				t = nullptr;
+				continue;
+			}
+			std::unique_lock<std::mutex> lock { sleep_mutex };
+			wake_up.wait(lock, [this]() { return stopped || pending > 0; });
+			if (stopped && pending == 0)
+				return;
+		}
+	}
+
+	std::vector<std::unique_ptr<queue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<std::size_t> next_queue { 0 };
+	/// number of tasks enqueued but not yet taken by any thread,
+	/// signed as a task can be taken before the submitter increments the count.
+	std::atomic<std::ptrdiff_t> pending { 0 };
+	std::mutex sleep_mutex;
+	std::condition_variable wake_up;
+	bool stopped = false;
+};
+
+/**
+ * \brief Number of workers used by default_thread_pool.
+ *
+ * Zero selects std::thread::hardware_concurrency.
+ * Has to be set before the first call to default_thread_pool.
+ */
+inline std::size_t& default_pool_size() {
+	static std::size_t size = 0;
+	return size;
+}
+
+/// Thread pool used by parallel algorithms when no pool is given explicitly.
+inline thread_pool& default_thread_pool() {
+	static thread_pool pool { default_pool_size() != 0 ?
+			default_pool_size() : std::thread::hardware_concurrency() };
+	return pool;
+}
+
+/// Execution policy tag for sequential execution on the calling thread.
+struct sequential_policy {
+};
+
+/**
+ * \brief Execution policy for parallel execution on a thread pool.
+ *
+ * A null pool selects default_thread_pool,
+ * a grain of zero lets the algorithm choose a cache sized block.
+ */
+struct parallel_policy {
+	thread_pool* pool;
+	std::size_t grain;
+
+	constexpr parallel_policy on(thread_pool& p) const {
+		return parallel_policy { &p, grain };
+	}
+	constexpr parallel_policy with_grain(std::size_t g) const {
+		return parallel_policy { pool, g };
+	}
+};
+
+constexpr sequential_policy sequential { };
+constexpr parallel_policy parallel { nullptr, 0 };
+
+/**
+ * \brief Calls @p f(first, last) for blocks of at most @p grain indices covering [0, size).
+ *
+ * Blocks are handed out dynamically to the workers of the pool and the calling thread,
+ * the call returns when all blocks have been processed.
+ * A single block runs on the calling thread without starting the default pool.
+ * The first exception thrown by @p f is rethrown on the calling thread.
+ */
+template<class F>
+void parallel_for_each_block(std::size_t size, std::size_t grain, F f,
+		parallel_policy policy = parallel) {
+	if (size == 0)
+		return;
+	grain = std::max<std::size_t>(grain, 1);
+	const std::size_t blocks = (size + grain - 1) / grain;
+	if (blocks == 1) {
+		f(std::size_t(0), size);
+		return;
+	}
+	auto& pool = policy.pool ? *policy.pool : default_thread_pool();
+
+	struct shared_state {
+		std::atomic<std::size_t> next_block { 0 };
+		std::atomic<std::size_t> running { 0 };
+		std::atomic<bool> failed { false };
+		std::exception_ptr error;
+	};
+	auto state = std::make_shared<shared_state>();
+
+	auto work = [state, blocks, grain, size, &f]() {
+		for (auto b = state->next_block++; b < blocks; b = state->next_block++) {
+			if (state->failed)
+				continue;
+			try {
+				const auto first = b * grain;
+				f(first, std::min(first + grain, size));
+			} catch (...) {
+				if (!state->failed.exchange(true))
+					state->error = std::current_exception();
+			}
+		}
+		--state->running;
+	};
+
+	const auto helpers = std::min(blocks - 1, pool.size());
+	state->running = helpers + 1;
+	for (std::size_t i = 0; i < helpers; ++i)
+		pool.submit(work);
+	work();
+
+	while (state->running != 0) {
+		if (!pool.run_pending_task())
+			std::this_thread::yield();
+	}
+	if (state->error)
+		std::rethrow_exception(state->error);
+}
+
+/// Sequential overload of parallel_for_each_block, calls @p f on the calling thread.
+template<class F>
+void parallel_for_each_block(std::size_t size, std::size_t grain, F f, sequential_policy) {
+	grain = std::max<std::size_t>(grain, 1);
+	for (std::size_t first = 0; first < size; first += grain)
+		f(first, std::min(first + grain, size));
+}
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_THREAD_POOL_H_ */
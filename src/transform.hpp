@@ -8,23 +8,66 @@
 #ifndef GEOM_SRC_TRANSFORM_HPP_
 #define GEOM_SRC_TRANSFORM_HPP_
 
+#include "collection.h"
+
+#include <type_traits>
+#include <utility>
+
 namespace fc
 {
 namespace geom
 {
 
+namespace detail
+{
+/// Evaluates lazy Eigen expressions such as products, which refer to their operands, to their plain type.
+template<class T>
+auto evaluated(const T& m, int) -> std::decay_t<decltype(m.eval())>
+{
+	return m.eval();
+}
+
+template<class T>
+T evaluated(const T& m, long)
+{
+	return m;
+}
+
+template<class T>
+auto evaluated(const T& m)
+{
+	return evaluated(m, 0);
+}
+} //namespace detail
+
 /**
  * \brief FlexCore Connectable which performs geometric transformations.
  *
+ * \tparam matrix_f nullary functor returning the transformation matrix.
  *
+ * Transformers can be chained with operator|,
+ * the chain multiplies each point with a single folded matrix.
  */
 template<class matrix_f>
 struct transformer
 {
 	template<class T>
-	decltype(auto) operator()(T&& v)
+	auto operator()(T&& v)
 	{
-		return m()*v;
+		return detail::evaluated(m()*v);
+	}
+
+	/**
+	 * \brief Transforms all points of collection @p c in a single pass over the point block.
+	 *
+	 * The kernel is chosen at compile time by the kind of the matrix,
+	 * see transform_kinds.h.
+	 */
+	template<class T, class layout, class allocator_t>
+	collection<T, layout, allocator_t> operator()(collection<T, layout, allocator_t> c)
+	{
+		c.transform(m());
+		return c;
 	}
 
 	matrix_f m;
@@ -37,14 +80,37 @@ auto transform_impl(T m)
 {
 	return transformer<T>{m};
 }
+
+/// Functor returning a matrix which is known at construction of the transformer.
+template<class matrix_t>
+struct constant_matrix
+{
+	const matrix_t& operator()() const
+	{
+		return value;
+	}
+
+	matrix_t value;
+};
+
+/// Functor returning the product of two matrix functors, applying @p first before @p second.
+template<class first_f, class second_f>
+struct composed_matrix
+{
+	auto operator()()
+	{
+		return evaluated(second() * first());
+	}
+
+	first_f first;
+	second_f second;
+};
 } //namespace detail
 
 template<class matrix_t>
 auto transform(matrix_t m)
 {
-	return detail::transform_impl(
-			[m](){ return m;}
-	);
+	return detail::transform_impl(detail::constant_matrix<matrix_t>{m});
 }
 
 template<class matrix_f>
@@ -53,6 +119,27 @@ auto transformf(matrix_f m)
 	return detail::transform_impl(m);
 }
 
+/**
+ * \brief Chains transformer @p first and @p second, @p first is applied first.
+ *
+ * Constant matrices are folded into a single constant matrix right away.
+ * If a matrix is provided by a functor, the product is formed once per application,
+ * i.e. once per collection and not once per point.
+ */
+template<class first_f, class second_f>
+auto operator|(transformer<first_f> first, transformer<second_f> second)
+{
+	return detail::transform_impl(detail::composed_matrix<first_f, second_f>{
+			std::move(first.m), std::move(second.m)});
+}
+
+template<class first_t, class second_t>
+auto operator|(transformer<detail::constant_matrix<first_t>> first,
+		transformer<detail::constant_matrix<second_t>> second)
+{
+	return transform(detail::evaluated(second.m() * first.m()));
+}
+
 } //namespace geom
 }// namespace fc
 
@@ -0,0 +1,338 @@
+#ifndef GEOM_SRC_TRANSFORM_KINDS_H_
+#define GEOM_SRC_TRANSFORM_KINDS_H_
+
+//This header contains the specialized transformation types of geom.
+//Every kind stores only the parameters it needs and provides a minimal point kernel
+//(member apply) used by the storage layouts, see storage.h.
+//Composing kinds with operator* yields the most specific kind of the result.
+
+#include "config.h"
+
+#include <type_traits>
+
+namespace fc
+{
+namespace geom
+{
+
+namespace detail {
+
+/// out = linear * in for an orthonormal @p linear, shared by the kernels of rotation and rigid.
+template<class scalar, int dim>
+void rotate(const Eigen::Matrix<scalar, dim, dim>& linear, const scalar (&in)[dim], scalar (&out)[dim]) {
+	for (int r = 0; r < dim; ++r) {
+		scalar acc = linear(r, 0) * in[0];
+		for (int c = 1; c < dim; ++c)
+			acc += linear(r, c) * in[c];
+		out[r] = acc;
+	}
+}
+
+} // namespace detail
+
+/// Pure translation p' = p + offset.
+template<class scalar, int dim>
+struct translation {
+	static constexpr int dimension = dim;
+	using scalar_type = scalar;
+	using vector_type = Eigen::Matrix<scalar, dim, 1>;
+
+	vector_type offset;
+
+	template<class derived>
+	vector_type operator*(const Eigen::MatrixBase<derived>& p) const {
+		return p + offset;
+	}
+
+	Eigen::Transform<scalar, dim, Eigen::Affine> matrix() const {
+		return Eigen::Transform<scalar, dim, Eigen::Affine>(Eigen::Translation<scalar, dim>(offset));
+	}
+
+	translation inverse() const {
+		return translation { -offset };
+	}
+
+	void apply(const scalar (&in)[dim], scalar (&out)[dim]) const {
+		for (int r = 0; r < dim; ++r)
+			out[r] = in[r] + offset[r];
+	}
+};
+
+/// Pure rotation p' = linear * p, linear is expected to be orthonormal.
+template<class scalar, int dim>
+struct rotation {
+	static constexpr int dimension = dim;
+	using scalar_type = scalar;
+	using vector_type = Eigen::Matrix<scalar, dim, 1>;
+	using linear_type = Eigen::Matrix<scalar, dim, dim>;
+
+	linear_type linear;
+
+	template<class derived>
+	vector_type operator*(const Eigen::MatrixBase<derived>& p) const {
+		return linear * p;
+	}
+
+	/// Isometry, inverted by Eigen without matrix inversion as well.
+	Eigen::Transform<scalar, dim, Eigen::Isometry> matrix() const {
+		Eigen::Transform<scalar, dim, Eigen::Isometry> m = Eigen::Transform<scalar, dim, Eigen::Isometry>::Identity();
+		m.linear() = linear;
+		return m;
+	}
+
+	rotation inverse() const {
+		return rotation { linear.transpose() };
+	}
+
+	void apply(const scalar (&in)[dim], scalar (&out)[dim]) const {
+		detail::rotate(linear, in, out);
+	}
+};
+
+/**
+ * \brief Rotation followed by translation p' = linear * p + offset, linear is expected to be orthonormal.
+ *
+ * Eigen isometries map to this kind. Other than affine it is inverted by transposition
+ * and points are rotated by the rotation kernel before the offset is added.
+ */
+template<class scalar, int dim>
+struct rigid {
+	static constexpr int dimension = dim;
+	using scalar_type = scalar;
+	using vector_type = Eigen::Matrix<scalar, dim, 1>;
+	using linear_type = Eigen::Matrix<scalar, dim, dim>;
+
+	linear_type linear;
+	vector_type offset;
+
+	template<class derived>
+	vector_type operator*(const Eigen::MatrixBase<derived>& p) const {
+		return linear * p + offset;
+	}
+
+	Eigen::Transform<scalar, dim, Eigen::Isometry> matrix() const {
+		Eigen::Transform<scalar, dim, Eigen::Isometry> m = Eigen::Transform<scalar, dim, Eigen::Isometry>::Identity();
+		m.linear() = linear;
+		m.translation() = offset;
+		return m;
+	}
+
+	/// Inverse by transposition, no matrix inversion required.
+	rigid inverse() const {
+		return rigid { linear.transpose(), -(linear.transpose() * offset) };
+	}
+
+	void apply(const scalar (&in)[dim], scalar (&out)[dim]) const {
+		detail::rotate(linear, in, out);
+		for (int r = 0; r < dim; ++r)
+			out[r] += offset[r];
+	}
+};
+
+/// Scaling by the same factor along all axes p' = factor * p.
+template<class scalar, int dim>
+struct uniform_scale {
+	static constexpr int dimension = dim;
+	using scalar_type = scalar;
+	using vector_type = Eigen::Matrix<scalar, dim, 1>;
+
+	scalar factor;
+
+	template<class derived>
+	vector_type operator*(const Eigen::MatrixBase<derived>& p) const {
+		return factor * p;
+	}
+
+	Eigen::Transform<scalar, dim, Eigen::Affine> matrix() const {
+		return Eigen::Transform<scalar, dim, Eigen::Affine>(Eigen::UniformScaling<scalar>(factor));
+	}
+
+	uniform_scale inverse() const {
+		return uniform_scale { scalar(1) / factor };
+	}
+
+	void apply(const scalar (&in)[dim], scalar (&out)[dim]) const {
+		for (int r = 0; r < dim; ++r)
+			out[r] = factor * in[r];
+	}
+};
+
+/// General affine transformation p' = linear * p + offset.
+template<class scalar, int dim>
+struct affine {
+	static constexpr int dimension = dim;
+	using scalar_type = scalar;
+	using vector_type = Eigen::Matrix<scalar, dim, 1>;
+	using linear_type = Eigen::Matrix<scalar, dim, dim>;
+
+	linear_type linear;
+	vector_type offset;
+
+	template<class derived>
+	vector_type operator*(const Eigen::MatrixBase<derived>& p) const {
+		return linear * p + offset;
+	}
+
+	Eigen::Transform<scalar, dim, Eigen::Affine> matrix() const {
+		Eigen::Transform<scalar, dim, Eigen::Affine> m = Eigen::Transform<scalar, dim, Eigen::Affine>::Identity();
+		m.linear() = linear;
+		m.translation() = offset;
+		return m;
+	}
+
+	affine inverse() const {
+		const linear_type inv = linear.inverse();
+		return affine { inv, -(inv * offset) };
+	}
+
+	void apply(const scalar (&in)[dim], scalar (&out)[dim]) const {
+		for (int r = 0; r < dim; ++r) {
+			scalar acc = offset[r];
+			for (int c = 0; c < dim; ++c)
+				acc += linear(r, c) * in[c];
+			out[r] = acc;
+		}
+	}
+};
+
+template<class T>
+struct is_transform_kind : std::false_type {
+};
+template<class S, int d>
+struct is_transform_kind<translation<S, d>> : std::true_type {
+};
+template<class S, int d>
+struct is_transform_kind<rotation<S, d>> : std::true_type {
+};
+template<class S, int d>
+struct is_transform_kind<rigid<S, d>> : std::true_type {
+};
+template<class S, int d>
+struct is_transform_kind<uniform_scale<S, d>> : std::true_type {
+};
+template<class S, int d>
+struct is_transform_kind<affine<S, d>> : std::true_type {
+};
+
+// Composition of transform kinds, l * r applies r first, as for matrices.
+
+template<class S, int d>
+translation<S, d> operator*(const translation<S, d>& l, const translation<S, d>& r) {
+	return { l.offset + r.offset };
+}
+
+template<class S, int d>
+rotation<S, d> operator*(const rotation<S, d>& l, const rotation<S, d>& r) {
+	return { l.linear * r.linear };
+}
+
+template<class S, int d>
+uniform_scale<S, d> operator*(const uniform_scale<S, d>& l, const uniform_scale<S, d>& r) {
+	return { l.factor * r.factor };
+}
+
+template<class S, int d>
+rigid<S, d> operator*(const rotation<S, d>& l, const translation<S, d>& r) {
+	return { l.linear, l.linear * r.offset };
+}
+
+template<class S, int d>
+rigid<S, d> operator*(const translation<S, d>& l, const rotation<S, d>& r) {
+	return { r.linear, l.offset };
+}
+
+template<class S, int d>
+rigid<S, d> operator*(const rigid<S, d>& l, const rigid<S, d>& r) {
+	return { l.linear * r.linear, l.linear * r.offset + l.offset };
+}
+
+template<class S, int d>
+rigid<S, d> operator*(const rigid<S, d>& l, const rotation<S, d>& r) {
+	return { l.linear * r.linear, l.offset };
+}
+
+template<class S, int d>
+rigid<S, d> operator*(const rotation<S, d>& l, const rigid<S, d>& r) {
+	return { l.linear * r.linear, l.linear * r.offset };
+}
+
+template<class S, int d>
+rigid<S, d> operator*(const rigid<S, d>& l, const translation<S, d>& r) {
+	return { l.linear, l.linear * r.offset + l.offset };
+}
+
+template<class S, int d>
+rigid<S, d> operator*(const translation<S, d>& l, const rigid<S, d>& r) {
+	return { r.linear, r.offset + l.offset };
+}
+
+/// Any other combination of kinds results in a general affine transformation.
+template<template<class, int> class L, template<class, int> class R, class S, int d>
+std::enable_if_t<is_transform_kind<L<S, d>>::value && is_transform_kind<R<S, d>>::value, affine<S, d>>
+operator*(const L<S, d>& l, const R<S, d>& r) {
+	const auto m = l.matrix() * r.matrix();
+	return { m.linear(), m.translation() };
+}
+
+/// Conversion of transform kinds and Eigen transformations to the matching transform kind.
+template<class kind_t>
+std::enable_if_t<is_transform_kind<kind_t>::value, const kind_t&>
+as_transform_kind(const kind_t& k) {
+	return k;
+}
+
+template<class S, int d>
+translation<S, d> as_transform_kind(const Eigen::Translation<S, d>& t) {
+	return { t.vector() };
+}
+
+template<class S>
+rotation<S, 3> as_transform_kind(const Eigen::AngleAxis<S>& r) {
+	return { r.toRotationMatrix() };
+}
+
+template<class S, int options>
+rotation<S, 3> as_transform_kind(const Eigen::Quaternion<S, options>& r) {
+	return { r.toRotationMatrix() };
+}
+
+template<class S>
+rotation<S, 2> as_transform_kind(const Eigen::Rotation2D<S>& r) {
+	return { r.toRotationMatrix() };
+}
+
+/// Isometries are rigid, the linear part is trusted to be orthonormal as Eigen does.
+template<class S, int d, int options>
+rigid<S, d> as_transform_kind(const Eigen::Transform<S, d, Eigen::Isometry, options>& m) {
+	return { m.linear(), m.translation() };
+}
+
+template<class S, int d, int mode, int options>
+std::enable_if_t<mode != Eigen::Isometry, affine<S, d>>
+as_transform_kind(const Eigen::Transform<S, d, mode, options>& m) {
+	static_assert(mode != Eigen::Projective,
+			"projective transformations are not supported as transform kind");
+	return { m.linear(), m.translation() };
+}
+
+/// Eigen::UniformScaling has no dimension, it has to be given as as_transform_kind<dim>(s).
+template<int dim, class S>
+uniform_scale<S, dim> as_transform_kind(const Eigen::UniformScaling<S>& s) {
+	return { s.factor() };
+}
+
+/**
+ * \brief Conversion to the transform kind acting on points of dimension @p dim.
+ *
+ * Same as as_transform_kind(m) except for Eigen::UniformScaling, which takes the dimension from @p dim.
+ * Used by the algorithms, which know the dimension of their points.
+ */
+template<int dim, class matrix_t>
+auto as_transform_kind(const matrix_t& m) -> decltype(as_transform_kind(m)) {
+	return as_transform_kind(m);
+}
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_TRANSFORM_KINDS_H_ */
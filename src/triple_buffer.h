@@ -0,0 +1,112 @@
+#ifndef GEOM_SRC_TRIPLE_BUFFER_H_
+#define GEOM_SRC_TRIPLE_BUFFER_H_
+
+//This header contains triple_buffer, three instances of e.g. a geom::transformed_collection
+//shared by a producer thread, which fills the back buffer, and a consumer thread, which reads the front buffer:
+//
+//  triple_buffer<transformed_collection<cloud>> frames { transformed_collection<cloud>(points, uninitialized) };
+//  //producer
+//  transform_into(scan, sensor_to_world, frames.back());
+//  frames.publish();
+//  //consumer
+//  const auto frame = frames.acquire();
+//  if (frame.fresh())
+//      render(*frame);
+//
+//The third buffer holds the latest published frame between the two threads.
+//Publishing and acquiring exchange a buffer index with it in a single atomic operation,
+//neither thread ever waits for the other and no objects are copied or allocated.
+
+#include <atomic>
+
+namespace fc
+{
+namespace geom
+{
+
+/**
+ * \brief Three buffers of type T handed from one producer to one consumer thread without waiting.
+ *
+ * The producer writes to back() and calls publish(), which offers the back buffer as latest frame
+ * and continues with the buffer offered before, unless that was taken by the consumer.
+ * The consumer calls acquire(), which takes the latest frame if one was published since,
+ * and reads it through the returned handle until its next acquire.
+ * Frames published faster than they are acquired are skipped.
+ */
+template<class T>
+class triple_buffer {
+public:
+	using value_type = T;
+
+	/// Read access to the front buffer, valid until the next acquire.
+	class read_handle {
+	public:
+		const T& operator*() const noexcept {
+			return *buffer;
+		}
+		const T* operator->() const noexcept {
+			return buffer;
+		}
+		/// true if the buffer was published since the previous acquire.
+		bool fresh() const noexcept {
+			return is_fresh;
+		}
+
+	private:
+		friend class triple_buffer;
+		read_handle(const T* buffer, bool fresh) noexcept :
+				buffer { buffer }, is_fresh { fresh } {
+		}
+
+		const T* buffer;
+		bool is_fresh;
+	};
+
+	triple_buffer() = default;
+	/// All buffers are copies of @p initial, e.g. to allocate their memory up front.
+	explicit triple_buffer(const T& initial) :
+			buffers { initial, initial, initial } {
+	}
+
+	triple_buffer(const triple_buffer&) = delete;
+	triple_buffer& operator=(const triple_buffer&) = delete;
+
+	/// Buffer written by the producer, owned by the producer until publish.
+	T& back() noexcept {
+		return buffers[back_index];
+	}
+
+	/// Offers the back buffer to the consumer, the producer continues with the previously offered buffer.
+	void publish() noexcept {
+		back_index = latest.exchange(back_index | fresh, std::memory_order_acq_rel) & index;
+	}
+
+	/// Read access to the latest published buffer, which the producer won't write before the next acquire.
+	read_handle acquire() noexcept {
+		const bool is_fresh = (latest.load(std::memory_order_relaxed) & fresh) != 0;
+		if (is_fresh)
+			front_index = latest.exchange(front_index, std::memory_order_acq_rel) & index;
+		return read_handle { &buffers[front_index], is_fresh };
+	}
+
+private:
+	/// bits of latest: index of the buffer between the threads, buffer published and not yet acquired
+	static constexpr unsigned index = 3, fresh = 4;
+
+	T buffers[3];
+	/// owned by the producer
+	unsigned back_index = 0;
+	/// owned by the consumer
+	unsigned front_index = 1;
+	std::atomic<unsigned> latest { 2 };
+};
+
+template<class T>
+constexpr unsigned triple_buffer<T>::index;
+template<class T>
+constexpr unsigned triple_buffer<T>::fresh;
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_TRIPLE_BUFFER_H_ */
@@ -0,0 +1,439 @@
+#ifndef GEOM_SRC_VOXEL_GRID_H_
+#define GEOM_SRC_VOXEL_GRID_H_
+
+//This header contains voxel grid downsampling of geom::collection:
+//every voxel of a regular grid containing points is replaced by one object at the centroid of its points,
+//whose annotation is reduced from the annotations of the points by a reduction policy:
+//
+//  const auto sparse = voxel_downsample(cloud, 0.1);                      //annotation of the first point
+//  const auto latest = voxel_downsample(cloud, 0.1, keep_max(&stamp::t)); //annotation with the latest t
+//  const auto mixed = voxel_downsample(cloud, 0.1,
+//          reduce_fields(max_of(&stamp::t), mean_of(&stamp::x), mean_of(&stamp::y)));
+//
+//Points are grouped by a hash table of voxels in a single pass, without allocations per point or voxel.
+//
+//A reduction policy provides
+//  void merge(annotation& result, const annotation& next) const;   //for the 2nd to last object of a voxel
+//  void finish(annotation& result, std::size_t count) const;       //once per voxel of count objects
+//result starts as the annotation of the first object, objects are merged in the order of the collection.
+//With parallel_policy next may also be the unfinished result of a later part of the collection,
+//merge thus has to be associative, as all policies of this header are.
+
+#include "collection.h"
+#include "instrument.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace fc
+{
+namespace geom
+{
+
+namespace detail
+{
+
+/// number of points read at once by voxel_downsample
+constexpr std::size_t voxel_tile = 256;
+
+} // namespace detail
+
+/// Reduction policy keeping the annotation of the first object of every voxel.
+struct keep_first {
+	template<class meta_t>
+	void merge(meta_t&, const meta_t&) const {
+	}
+	template<class meta_t>
+	void finish(meta_t&, std::size_t) const {
+	}
+};
+
+/// Reduction policy keeping the annotation of the last object of every voxel.
+struct keep_last {
+	template<class meta_t>
+	void merge(meta_t& result, const meta_t& next) const {
+		result = next;
+	}
+	template<class meta_t>
+	void finish(meta_t&, std::size_t) const {
+	}
+};
+
+/// Reduction policy keeping the annotation with the largest @p member, the first one of equal values.
+template<class meta_t, class value_t>
+struct keep_max_of {
+	value_t meta_t::*member;
+
+	void merge(meta_t& result, const meta_t& next) const {
+		if (next.*member > result.*member)
+			result = next;
+	}
+	void finish(meta_t&, std::size_t) const {
+	}
+};
+
+/// Keeps the annotation with the largest @p member of every voxel, e.g. keep_max(&stamp::t) for the latest.
+template<class meta_t, class value_t>
+keep_max_of<meta_t, value_t> keep_max(value_t meta_t::*member) {
+	return keep_max_of<meta_t, value_t> { member };
+}
+
+/// Field reductions of reduce_fields.
+template<class meta_t, class value_t>
+struct field_max {
+	value_t meta_t::*member;
+
+	void merge(meta_t& result, const meta_t& next) const {
+		result.*member = std::max(result.*member, next.*member);
+	}
+	void finish(meta_t&, std::size_t) const {
+	}
+};
+
+template<class meta_t, class value_t>
+struct field_min {
+	value_t meta_t::*member;
+
+	void merge(meta_t& result, const meta_t& next) const {
+		result.*member = std::min(result.*member, next.*member);
+	}
+	void finish(meta_t&, std::size_t) const {
+	}
+};
+
+/// Sum of the field, accumulated in the type of the field.
+template<class meta_t, class value_t>
+struct field_sum {
+	value_t meta_t::*member;
+
+	void merge(meta_t& result, const meta_t& next) const {
+		result.*member += next.*member;
+	}
+	void finish(meta_t&, std::size_t) const {
+	}
+};
+
+/// Mean of the field, the sum is accumulated in the type of the field.
+template<class meta_t, class value_t>
+struct field_mean {
+	value_t meta_t::*member;
+
+	void merge(meta_t& result, const meta_t& next) const {
+		result.*member += next.*member;
+	}
+	void finish(meta_t& result, std::size_t count) const {
+		result.*member /= value_t(count);
+	}
+};
+
+template<class meta_t, class value_t>
+field_max<meta_t, value_t> max_of(value_t meta_t::*member) {
+	return field_max<meta_t, value_t> { member };
+}
+template<class meta_t, class value_t>
+field_min<meta_t, value_t> min_of(value_t meta_t::*member) {
+	return field_min<meta_t, value_t> { member };
+}
+template<class meta_t, class value_t>
+field_sum<meta_t, value_t> sum_of(value_t meta_t::*member) {
+	return field_sum<meta_t, value_t> { member };
+}
+template<class meta_t, class value_t>
+field_mean<meta_t, value_t> mean_of(value_t meta_t::*member) {
+	return field_mean<meta_t, value_t> { member };
+}
+
+/// Reduction policy applying a field reduction per field, fields without one keep the value of the first object.
+template<class... fields>
+struct field_reduction {
+	std::tuple<fields...> reductions;
+
+	template<class meta_t>
+	void merge(meta_t& result, const meta_t& next) const {
+		merge_impl(result, next, std::index_sequence_for<fields...> { });
+	}
+	template<class meta_t>
+	void finish(meta_t& result, std::size_t count) const {
+		finish_impl(result, count, std::index_sequence_for<fields...> { });
+	}
+
+private:
+	template<class meta_t, std::size_t... I>
+	void merge_impl(meta_t& result, const meta_t& next, std::index_sequence<I...>) const {
+		(void) detail::swallow { 0, (std::get<I>(reductions).merge(result, next), 0)... };
+	}
+	template<class meta_t, std::size_t... I>
+	void finish_impl(meta_t& result, std::size_t count, std::index_sequence<I...>) const {
+		(void) detail::swallow { 0, (std::get<I>(reductions).finish(result, count), 0)... };
+	}
+};
+
+/// Combines field reductions, e.g. reduce_fields(max_of(&stamp::t), mean_of(&stamp::x)).
+template<class... fields>
+field_reduction<fields...> reduce_fields(fields... f) {
+	return field_reduction<fields...> { std::make_tuple(f...) };
+}
+
+namespace detail
+{
+
+/// running centroid and annotation of the objects of one voxel
+template<class scalar_t, int dim, class meta_t>
+struct voxel_sum {
+	/// first point, deviations are summed relative to it to avoid cancellation far from the origin
+	scalar_t origin[dim];
+	scalar_t deviation[dim];
+	std::size_t count;
+	meta_t meta;
+};
+
+/**
+ * \brief Voxels of a contiguous part of a collection, in the order their first objects appear.
+ *
+ * Voxel keys are mapped to positions in sums by an open addressing hash table with linear probing,
+ * which grows by doubling, so there are no allocations per point or voxel.
+ * Key and position share a slot, a lookup touches one cache line of the table and one of sums.
+ */
+template<class scalar_t, int dim, class meta_t>
+class voxel_table {
+public:
+	using sum_type = voxel_sum<scalar_t, dim, meta_t>;
+
+	explicit voxel_table(std::size_t expected) {
+		std::size_t capacity = 16;
+		while (capacity < 2 * expected)
+			capacity *= 2;
+		rehash(capacity);
+		sums.reserve(expected);
+		key_of.reserve(expected);
+	}
+
+	/// adds point @p p with annotation @p meta to the voxel of @p key, which is created if it doesn't exist.
+	template<class reduction_t>
+	void add(std::uint64_t key, const scalar_t (&p)[dim], const meta_t& meta, const reduction_t& reduction) {
+		//consecutive points of scans mostly share voxels
+		if (key == last_key) {
+			accumulate(sums[last_position], p, meta, reduction);
+			return;
+		}
+		const auto slot = find(key);
+		last_key = key;
+		if (slots[slot].key != key) {
+			last_position = sums.size();
+			sum_type s;
+			for (int r = 0; r < dim; ++r) {
+				s.origin[r] = p[r];
+				s.deviation[r] = 0;
+			}
+			s.count = 1;
+			s.meta = meta;
+			sums.push_back(std::move(s));
+			insert(slot, key);
+			return;
+		}
+		last_position = slots[slot].position;
+		accumulate(sums[last_position], p, meta, reduction);
+	}
+
+	/// merges the voxels of @p o, which covers objects after the ones of this table.
+	template<class reduction_t>
+	void merge(voxel_table&& o, const reduction_t& reduction) {
+		for (std::size_t v = 0; v < o.sums.size(); ++v) {
+			auto& b = o.sums[v];
+			const auto key = o.key_of[v];
+			const auto slot = find(key);
+			if (slots[slot].key != key) {
+				sums.push_back(std::move(b));
+				insert(slot, key);
+				continue;
+			}
+			auto& a = sums[slots[slot].position];
+			for (int r = 0; r < dim; ++r)
+				a.deviation[r] += b.deviation[r] + scalar_t(b.count) * (b.origin[r] - a.origin[r]);
+			a.count += b.count;
+			reduction.merge(a.meta, b.meta);
+		}
+	}
+
+	std::vector<sum_type> sums;
+
+private:
+	static constexpr std::uint64_t empty = ~std::uint64_t { 0 };
+
+	struct slot_type {
+		std::uint64_t key;
+		std::size_t position;
+	};
+
+	template<class reduction_t>
+	static void accumulate(sum_type& s, const scalar_t (&p)[dim], const meta_t& meta, const reduction_t& reduction) {
+		for (int r = 0; r < dim; ++r)
+			s.deviation[r] += p[r] - s.origin[r];
+		++s.count;
+		reduction.merge(s.meta, meta);
+	}
+
+	std::size_t home(std::uint64_t key) const {
+		return std::size_t((key * 0x9e3779b97f4a7c15ull) >> shift);
+	}
+
+	/// slot of @p key or the empty slot to insert it into
+	std::size_t find(std::uint64_t key) const {
+		auto slot = home(key);
+		while (slots[slot].key != key && slots[slot].key != empty)
+			slot = (slot + 1) & mask;
+		return slot;
+	}
+
+	/// inserts the voxel of @p key, whose sum was appended to sums, into empty @p slot
+	void insert(std::size_t slot, std::uint64_t key) {
+		slots[slot] = slot_type { key, key_of.size() };
+		key_of.push_back(key);
+		if (2 * key_of.size() > slots.size())
+			rehash(2 * slots.size());
+	}
+
+	void rehash(std::size_t capacity) {
+		slots.assign(capacity, slot_type { empty, 0 });
+		mask = capacity - 1;
+		shift = 64;
+		for (auto c = capacity; c > 1; c /= 2)
+			--shift;
+		for (std::size_t v = 0; v < key_of.size(); ++v)
+			slots[find(key_of[v])] = slot_type { key_of[v], v };
+	}
+
+	std::vector<slot_type> slots;
+	/// key of every voxel in sums
+	std::vector<std::uint64_t> key_of;
+	std::size_t mask = 0;
+	int shift = 64;
+	std::uint64_t last_key = empty;
+	std::size_t last_position = 0;
+};
+
+template<class scalar_t, int dim, class meta_t>
+constexpr std::uint64_t voxel_table<scalar_t, dim, meta_t>::empty;
+
+/// bits of the index along one axis in the key of a voxel, such that no key is voxel_table's empty key
+template<int dim>
+struct voxel_key_bits : std::integral_constant<int, (dim < 2 ? 62 : 64 / dim - (64 % dim == 0))> {
+};
+
+/// number of voxels on either side of the origin along every axis of a voxel grid of dimension @p dim
+template<int dim>
+constexpr std::uint64_t voxel_range() {
+	return std::uint64_t { 1 } << (voxel_key_bits<dim>::value - 1);
+}
+
+/// number of parts collections are split into for voxel_downsample
+inline std::size_t voxel_parts(sequential_policy) {
+	return 1;
+}
+inline std::size_t voxel_parts(parallel_policy policy) {
+	return (policy.pool ? policy.pool->size() : default_thread_pool().size()) + 1;
+}
+
+} // namespace detail
+
+/**
+ * \brief One object per voxel of edge length @p voxel_size containing points of @p c.
+ *
+ * The point of every object is the centroid of the points in its voxel,
+ * the annotation is reduced from theirs by @p reduction, see the top of this header.
+ * Voxel i covers [i, i + 1) * voxel_size along every axis, the grid is anchored at the origin
+ * such that clouds of the same scene share voxels. Objects are ordered by the first object of their voxel in @p c.
+ *
+ * Points are read once, voxels are looked up in a hash table which stays in cache
+ * as long as the voxels are much fewer than the points.
+ * Runs on the calling thread by default. With parallel_policy every thread groups a contiguous part of @p c,
+ * the parts are merged in order, the result is thus independent of the policy.
+ *
+ * \throws std::invalid_argument if a point is further than detail::voxel_range<dim>() voxels from the origin
+ * along an axis, 2^20 in 3D, or not finite.
+ */
+template<class collection_t, class reduction_t = keep_first, class policy_t = sequential_policy>
+collection_t voxel_downsample(const collection_t& c, typename collection_t::scalar_type voxel_size,
+		const reduction_t& reduction = reduction_t { }, policy_t policy = sequential) {
+	using size_type = typename collection_t::size_type;
+	using scalar_type = typename collection_t::scalar_type;
+	using vector_type = typename collection_t::vector_type;
+	using annotation = typename collection_t::annotation;
+	using table_type = detail::voxel_table<scalar_type, collection_t::dimension, annotation>;
+	constexpr int dim = collection_t::dimension;
+	assert(voxel_size > 0);
+	GEOM_PROBE(filter, c.size(), c.size() * (detail::stored_point_bytes<std::decay_t<decltype(c.points())>>::value
+			+ sizeof(annotation)));
+	if (c.empty())
+		return collection_t { c.get_allocator() };
+
+	//voxel indices are computed in double, the largest ones are not representable as float,
+	//they are offset by the range to make them positive, such that converting them rounds down
+	const double scale = 1 / double(voxel_size);
+	constexpr int bits = detail::voxel_key_bits<dim>::value;
+	const double offset = double(detail::voxel_range<dim>());
+	const double limit = 2 * offset;
+	const auto parts = std::min<size_type>(detail::voxel_parts(policy), c.size());
+	const auto part_size = (c.size() + parts - 1) / parts;
+	std::vector<table_type> tables;
+	tables.reserve(parts);
+	for (size_type p = 0; p < parts; ++p)
+		tables.emplace_back(std::min<size_type>(part_size, 1024));
+	parallel_for_each_block(c.size(), part_size, [&](size_type first, size_type last) {
+		auto& table = tables[first / part_size];
+		std::uint64_t keys[detail::voxel_tile];
+		for (auto tile = first; tile < last; tile += detail::voxel_tile) {
+			const auto count = std::min(detail::voxel_tile, last - tile);
+			const auto block = c.points().block(tile, count);
+			//counted without branches, such that the loop vectorizes, NaN counts as outside
+			std::uint32_t outside = 0;
+			for (size_type i = 0; i < count; ++i) {
+				std::uint64_t key = 0;
+				for (int r = 0; r < dim; ++r) {
+					const double cell = double(block.coeff(r, i)) * scale + offset;
+					outside += std::uint32_t(!(cell >= 0)) | std::uint32_t(!(cell < limit));
+					key |= std::uint64_t(std::min(limit, std::max(0.0, cell))) << (r * bits);
+				}
+				keys[i] = key;
+			}
+			if (outside)
+				throw std::invalid_argument { "voxel_downsample: point outside of the voxel grid" };
+			for (size_type i = 0; i < count; ++i) {
+				scalar_type p[dim];
+				for (int r = 0; r < dim; ++r)
+					p[r] = block.coeff(r, i);
+				table.add(keys[i], p, c.meta().load(tile + i), reduction);
+			}
+		}
+	}, policy);
+	for (size_type p = 1; p < parts; ++p)
+		tables[0].merge(std::move(tables[p]), reduction);
+
+	auto& sums = tables[0].sums;
+	collection_t result(sums.size(), uninitialized, c.get_allocator());
+	parallel_for_each_block(sums.size(), detail::block_grain<collection_t>(policy), [&](size_type first, size_type last) {
+		for (auto v = first; v < last; ++v) {
+			auto& s = sums[v];
+			vector_type point;
+			for (int r = 0; r < dim; ++r)
+				point[r] = s.origin[r] + s.deviation[r] / scalar_type(s.count);
+			reduction.finish(s.meta, s.count);
+			result.points()[v] = point;
+			result.meta().store(v, s.meta);
+		}
+	}, policy);
+	return result;
+}
+
+} // namespace geom
+} // namespace fc
+
+#endif /* GEOM_SRC_VOXEL_GRID_H_ */